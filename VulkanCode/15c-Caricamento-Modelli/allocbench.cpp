@@ -0,0 +1,166 @@
+// programma da riga di comando che mette alla prova BuddyAllocator senza bisogno di un dispositivo Vulkan
+// uso: allocbench.exe [operazioni] [seme]
+// fa allocazioni e liberazioni casuali (dimensioni e allineamenti diversi) e dopo ognuna controlla che:
+// le porzioni occupate non si sovrappongano, gli offset rispettino l'allineamento e getUsedBytes sia uguale alla somma delle porzioni;
+// alla fine libera tutto e controlla che il blocco sia tornato un'unica porzione libera
+// esce con codice 1 al primo errore trovato
+#include "buddyAllocator.h"
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <map>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+static const uint64_t BLOCK_SIZE = 64ull * 1024 * 1024; // come un blocco di DeviceAllocator
+static const uint64_t MIN_SIZE = 256;                   // porzione più piccola
+static const uint64_t MAX_REQUEST = 4ull * 1024 * 1024; // richiesta più grande fatta dal test
+
+struct Allocation
+{
+    uint64_t size;      // dimensione della porzione, dopo l'arrotondamento alla potenza di 2
+    uint64_t alignment; // allineamento richiesto
+};
+
+// la dimensione della porzione che l'allocatore deve usare per una richiesta
+static uint64_t roundedSize(uint64_t request, uint64_t alignment)
+{
+    uint64_t needed = std::max(request, alignment);
+    uint64_t s = MIN_SIZE;
+    while (s < needed)
+    {
+        s *= 2;
+    }
+    return s;
+}
+
+static bool fail(const std::string &message, size_t operation)
+{
+    std::cerr << "errore all'operazione " << operation << ": " << message << std::endl;
+    return false;
+}
+
+// controlla lo stato dell'allocatore rispetto alle porzioni che il test sa di aver preso
+static bool check(const BuddyAllocator &allocator, const std::map<uint64_t, Allocation> &live, size_t operation)
+{
+    uint64_t expectedUsed = 0;
+    uint64_t previousEnd = 0;
+    for (const auto &entry : live)
+    {
+        uint64_t offset = entry.first;
+        const Allocation &allocation = entry.second;
+        if (offset % allocation.alignment != 0)
+        {
+            return fail("offset " + std::to_string(offset) + " non allineato a " + std::to_string(allocation.alignment), operation);
+        }
+        if (offset % allocation.size != 0)
+        {
+            return fail("offset " + std::to_string(offset) + " non multiplo della sua porzione", operation);
+        }
+        if (offset < previousEnd)
+        {
+            return fail("la porzione a " + std::to_string(offset) + " si sovrappone alla precedente", operation);
+        }
+        if (offset + allocation.size > allocator.getSize())
+        {
+            return fail("la porzione a " + std::to_string(offset) + " esce dal blocco", operation);
+        }
+        previousEnd = offset + allocation.size;
+        expectedUsed += allocation.size;
+    }
+    if (allocator.getUsedBytes() != expectedUsed)
+    {
+        return fail("getUsedBytes = " + std::to_string(allocator.getUsedBytes()) + ", atteso " + std::to_string(expectedUsed), operation);
+    }
+    if (allocator.isEmpty() != live.empty())
+    {
+        return fail("isEmpty non corrisponde alle porzioni occupate", operation);
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    size_t operations = argc > 1 ? std::stoul(argv[1]) : 200000;
+    uint32_t seed = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 12345;
+
+    BuddyAllocator allocator(BLOCK_SIZE, MIN_SIZE);
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<uint64_t> sizeExponent(0, 22);     // richieste da 1 B a 4 MB, distribuite sulle potenze di 2
+    std::uniform_int_distribution<uint64_t> alignmentExponent(0, 16); // allineamenti da 1 B a 64 KB
+    std::uniform_int_distribution<int> coin(0, 99);
+
+    std::map<uint64_t, Allocation> live; // porzioni occupate, ordinate per offset
+    std::vector<uint64_t> offsets;       // gli stessi offset, per sceglierne uno a caso da liberare
+    size_t allocations = 0, frees = 0, failures = 0;
+    uint64_t peakUsed = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t op = 0; op < operations; op++)
+    {
+        // allocazioni un po' più probabili delle liberazioni, così il blocco si riempie e si arriva anche alle richieste che falliscono
+        if (offsets.empty() || coin(rng) < 55)
+        {
+            uint64_t limit = 1ull << sizeExponent(rng);
+            uint64_t request = std::uniform_int_distribution<uint64_t>(1, std::min(limit, MAX_REQUEST))(rng);
+            uint64_t alignment = 1ull << alignmentExponent(rng);
+            uint64_t offset;
+            if (!allocator.allocate(request, alignment, offset))
+            {
+                failures++;
+                continue;
+            }
+            if (live.count(offset) != 0)
+            {
+                fail("offset " + std::to_string(offset) + " restituito due volte", op);
+                return 1;
+            }
+            live[offset] = {roundedSize(request, alignment), alignment};
+            offsets.push_back(offset);
+            allocations++;
+        }
+        else
+        {
+            size_t pick = std::uniform_int_distribution<size_t>(0, offsets.size() - 1)(rng);
+            uint64_t offset = offsets[pick];
+            offsets[pick] = offsets.back();
+            offsets.pop_back();
+            allocator.free(offset);
+            live.erase(offset);
+            frees++;
+        }
+        peakUsed = std::max(peakUsed, allocator.getUsedBytes());
+        if (!check(allocator, live, op))
+        {
+            return 1;
+        }
+    }
+
+    // liberiamo tutto: se le porzioni gemelle vengono riunite correttamente il blocco torna intero
+    for (uint64_t offset : offsets)
+    {
+        allocator.free(offset);
+    }
+    live.clear();
+    if (!check(allocator, live, operations))
+    {
+        return 1;
+    }
+    uint64_t whole;
+    if (!allocator.allocate(BLOCK_SIZE, 1, whole) || whole != 0)
+    {
+        fail("dopo aver liberato tutto il blocco non è tornato un'unica porzione", operations);
+        return 1;
+    }
+    allocator.free(whole);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    std::cout << "operazioni: " << operations << " (seme " << seed << ")" << std::endl;
+    std::cout << "allocazioni: " << allocations << ", liberazioni: " << frees + offsets.size() << ", richieste rifiutate (blocco pieno): " << failures << std::endl;
+    std::cout << "picco occupato: " << peakUsed / (1024 * 1024) << " MB su " << BLOCK_SIZE / (1024 * 1024) << " MB" << std::endl;
+    std::cout << "tempo: " << ms << " ms (compresi i controlli)" << std::endl;
+    std::cout << "nessun errore" << std::endl;
+    return 0;
+}
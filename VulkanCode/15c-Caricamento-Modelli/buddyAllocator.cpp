@@ -0,0 +1,100 @@
+#include "buddyAllocator.h"
+#include <stdexcept>
+#include <algorithm>
+
+BuddyAllocator::BuddyAllocator(uint64_t size, uint64_t minSize) : size(size)
+{
+    if (size == 0 || (size & (size - 1)) != 0 || minSize == 0 || (minSize & (minSize - 1)) != 0 || minSize > size)
+    {
+        throw std::invalid_argument("buddy allocator sizes must be powers of two!");
+    }
+    levelCount = 1;
+    while ((size >> (levelCount - 1)) > minSize)
+    {
+        levelCount++;
+    }
+    freeLists.resize(levelCount);
+    freeLists[0].insert(0); // all'inizio c'è una sola porzione libera: tutto il blocco
+}
+
+uint64_t BuddyAllocator::nodeSize(uint32_t level) const
+{
+    return size >> level;
+}
+
+bool BuddyAllocator::allocate(uint64_t request, uint64_t alignment, uint64_t &offset)
+{
+    uint64_t needed = std::max(request, alignment);
+    if (needed == 0 || needed > size)
+    {
+        return false;
+    }
+    // il livello più profondo (porzioni più piccole) che contiene ancora la richiesta
+    uint32_t level = levelCount - 1;
+    while (nodeSize(level) < needed)
+    {
+        level--;
+    }
+    // cerchiamo una porzione libera a quel livello o, se non c'è, una più grande da dividere
+    int32_t found = static_cast<int32_t>(level);
+    while (found >= 0 && freeLists[found].empty())
+    {
+        found--;
+    }
+    if (found < 0)
+    {
+        return false;
+    }
+    // prendiamo l'offset più basso, così le porzioni occupate restano compatte all'inizio del blocco
+    offset = *freeLists[found].begin();
+    freeLists[found].erase(freeLists[found].begin());
+    // dividiamo a metà finché non arriviamo al livello giusto, la seconda metà di ogni divisione resta libera
+    for (uint32_t l = static_cast<uint32_t>(found); l < level; l++)
+    {
+        freeLists[l + 1].insert(offset + nodeSize(l + 1));
+    }
+    allocated[offset] = level;
+    usedBytes += nodeSize(level);
+    return true;
+}
+
+void BuddyAllocator::free(uint64_t offset)
+{
+    auto it = allocated.find(offset);
+    if (it == allocated.end())
+    {
+        throw std::invalid_argument("buddy allocator: freeing an offset that was not allocated!");
+    }
+    uint32_t level = it->second;
+    allocated.erase(it);
+    usedBytes -= nodeSize(level);
+    // finché anche la gemella è libera, le riuniamo e saliamo di un livello
+    while (level > 0)
+    {
+        uint64_t buddy = offset ^ nodeSize(level);
+        auto buddyIt = freeLists[level].find(buddy);
+        if (buddyIt == freeLists[level].end())
+        {
+            break;
+        }
+        freeLists[level].erase(buddyIt);
+        offset = std::min(offset, buddy);
+        level--;
+    }
+    freeLists[level].insert(offset);
+}
+
+uint64_t BuddyAllocator::getUsedBytes() const
+{
+    return usedBytes;
+}
+
+uint64_t BuddyAllocator::getSize() const
+{
+    return size;
+}
+
+bool BuddyAllocator::isEmpty() const
+{
+    return allocated.empty();
+}
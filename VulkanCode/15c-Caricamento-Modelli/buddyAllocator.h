@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <set>
+#include <unordered_map>
+
+/**
+ * @brief Allocatore buddy: gestisce gli offset dentro un blocco di memoria, senza toccare la memoria vera e propria.
+ *
+ * Il blocco (di dimensione potenza di 2) viene diviso a metà finché non si arriva alla dimensione più piccola che contiene la richiesta.
+ * Quando una porzione viene liberata, se anche la sua metà gemella (il "buddy") è libera le due vengono riunite.
+ * Ogni porzione di dimensione s inizia a un offset multiplo di s, quindi qualunque allineamento potenza di 2 fino a s è rispettato gratis.
+ * La parte di bookkeeping è solo CPU, così si può provare anche senza un dispositivo Vulkan.
+ */
+class BuddyAllocator
+{
+public:
+    /**
+     * @brief Costruttore della classe BuddyAllocator.
+     *
+     * @param size La dimensione del blocco, deve essere una potenza di 2.
+     * @param minSize La dimensione minima di una porzione, deve essere una potenza di 2 non più grande di size.
+     */
+    BuddyAllocator(uint64_t size, uint64_t minSize);
+
+    /**
+     * @brief Prende una porzione libera del blocco.
+     *
+     * @param size La dimensione richiesta.
+     * @param alignment L'allineamento richiesto, una potenza di 2.
+     * @param offset L'offset della porzione nel blocco, se la funzione ritorna true.
+     * @return false se nel blocco non c'è una porzione libera abbastanza grande.
+     */
+    bool allocate(uint64_t size, uint64_t alignment, uint64_t &offset);
+
+    /**
+     * @brief Libera una porzione presa con allocate.
+     * @param offset L'offset restituito da allocate.
+     */
+    void free(uint64_t offset);
+
+    /**
+     * @brief Restituisce i byte occupati, compreso lo spazio perso per arrotondare le richieste alla potenza di 2.
+     * @return I byte occupati.
+     */
+    uint64_t getUsedBytes() const;
+
+    /**
+     * @brief Restituisce la dimensione del blocco.
+     * @return La dimensione in byte.
+     */
+    uint64_t getSize() const;
+
+    /**
+     * @brief Indica se nel blocco non c'è nessuna porzione occupata.
+     * @return true se il blocco è vuoto.
+     */
+    bool isEmpty() const;
+
+private:
+    // dimensione di una porzione al livello indicato: il livello 0 è l'intero blocco
+    uint64_t nodeSize(uint32_t level) const;
+
+    uint64_t size;
+    uint32_t levelCount;
+    uint64_t usedBytes = 0;
+    std::vector<std::set<uint64_t>> freeLists;        // per ogni livello, gli offset delle porzioni libere
+    std::unordered_map<uint64_t, uint32_t> allocated; // per ogni porzione occupata, il suo livello
+};
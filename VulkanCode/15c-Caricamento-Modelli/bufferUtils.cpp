@@ -1,6 +1,26 @@
 #include "bufferUtils.h"
 #include <stdexcept> // For std::runtime_error
 #include <iostream>
+#include <algorithm>
+
+// allocatore usato da createBuffer e createImage, creato da createDeviceAllocator
+static DeviceAllocator *deviceAllocator = nullptr;
+
+void createDeviceAllocator(VkDevice device, VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2)
+{
+    deviceAllocator = new DeviceAllocator(device, physicalDevice, getMemoryProperties2);
+}
+
+void destroyDeviceAllocator()
+{
+    delete deviceAllocator;
+    deviceAllocator = nullptr;
+}
+
+DeviceAllocator *getDeviceAllocator()
+{
+    return deviceAllocator;
+}
 
 // vulkan ha bisogno di sapere come interpretare i dati che gli passiamo, quindi dobbiamo specificare il formato dei dati
 VkVertexInputBindingDescription Vertex::getBindingDescription()
@@ -42,8 +62,8 @@ std::array<VkVertexInputAttributeDescription, 3> Vertex::getAttributeDescription
 
 void createBuffer(VkDevice device, VkPhysicalDevice physicalDevice,
                   VkDeviceSize size, VkBufferUsageFlags usage,
-                  VkMemoryPropertyFlags properties,
-                  VkBuffer &buffer, VkDeviceMemory &bufferMemory)
+                  VkMemoryPropertyFlags properties, MemoryCategory category,
+                  VkBuffer &buffer, DeviceAllocation &bufferMemory)
 {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -60,20 +80,43 @@ void createBuffer(VkDevice device, VkPhysicalDevice physicalDevice,
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
+    // non chiamiamo vkAllocateMemory per ogni buffer: il driver ha un limite al numero di allocazioni e ognuna è lenta
+    // la memoria viene presa da blocchi grandi divisi con un allocatore (vedi deviceAllocator.h), quindi il buffer usa un offset dentro il blocco
+    bufferMemory = deviceAllocator->allocate(memRequirements, properties, true, category);
+    // se non ci sono errori, possiamo finalmente collegare il buffer alla memoria
+    vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset);
+}
+
+bool supportsDirectUploads(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
 
-    // in teoria non è di norma chiamare direttamente vkAllocateMemory, perché se ci fossero molti più oggetti, occuperebbe molta memoria
-    // ma per ora essendo solo un triangolo, non ci sono problemi, ma se ci fossero più oggetti, meglio creare un uallocatore personalizzato che gestisca la memoria in modo più efficiente
-    //  dividendo la memoria in parti più piccole e allocando solo la memoria necessaria per ogni oggetto usando un offset
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+    VkDeviceSize largestDeviceHeap = 0;
+    for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++)
     {
-        throw std::runtime_error("failed to allocate buffer memory!");
+        if (memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+        {
+            largestDeviceHeap = std::max(largestDeviceHeap, memProperties.memoryHeaps[i].size);
+        }
     }
-    // se non ci sono errori, possiamo finalmente collegare il buffer alla memoria
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    const VkMemoryPropertyFlags direct = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+    {
+        // con il resizable BAR l'heap host visible è tutta la memoria video, senza è una piccola finestra: basta confrontare le dimensioni
+        if ((memProperties.memoryTypes[i].propertyFlags & direct) == direct &&
+            memProperties.memoryHeaps[memProperties.memoryTypes[i].heapIndex].size >= largestDeviceHeap / 2)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void destroyBuffer(VkDevice device, VkBuffer buffer, const DeviceAllocation &bufferMemory)
+{
+    vkDestroyBuffer(device, buffer, nullptr);
+    deviceAllocator->free(bufferMemory);
 }
 
 uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties)
@@ -105,10 +148,10 @@ void copyBuffer(VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueu
 }
 
 void createImage(VkDevice device, VkPhysicalDevice physicalDevice,
-                 uint32_t width, uint32_t height, VkFormat format,
+                 uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format,
                  VkImageTiling tiling, VkImageUsageFlags usage,
-                 VkMemoryPropertyFlags properties,
-                 VkImage &image, VkDeviceMemory &imageMemory)
+                 VkMemoryPropertyFlags properties, MemoryCategory category,
+                 VkImage &image, DeviceAllocation &imageMemory)
 {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -116,7 +159,7 @@ void createImage(VkDevice device, VkPhysicalDevice physicalDevice,
     imageInfo.extent.width = static_cast<uint32_t>(width);
     imageInfo.extent.height = static_cast<uint32_t>(height);
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = mipLevels; // ogni livello è grande la metà del precedente, la GPU sceglie quello adatto alla distanza
     imageInfo.arrayLayers = 1;
     imageInfo.format = format;
     /* Il campo "tiling" può avere uno dei seguenti valori:
@@ -153,25 +196,33 @@ void createImage(VkDevice device, VkPhysicalDevice physicalDevice,
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(device, image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
+    // le immagini con tiling ottimale non possono stare nella stessa pagina di bufferImageGranularity dei buffer,
+    // quindi l'allocatore le mette in blocchi separati
+    imageMemory = deviceAllocator->allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_LINEAR, category);
 
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to allocate image memory!");
-    }
+    vkBindImageMemory(device, image, imageMemory.memory, imageMemory.offset);
+}
 
-    vkBindImageMemory(device, image, imageMemory, 0);
+void destroyImage(VkDevice device, VkImage image, const DeviceAllocation &imageMemory)
+{
+    vkDestroyImage(device, image, nullptr);
+    deviceAllocator->free(imageMemory);
 }
 
 void transitionImageLayout(VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueue,
                            VkImage image, VkFormat format,
-                           VkImageLayout oldLayout, VkImageLayout newLayout)
+                           VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
 {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
 
+    recordTransitionImageLayout(commandBuffer, image, oldLayout, newLayout, mipLevels);
+
+    endSingleTimeCommands(device, commandPool, graphicsQueue, commandBuffer);
+}
+
+void recordTransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image,
+                                 VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
+{
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.oldLayout = oldLayout;
@@ -182,7 +233,7 @@ void transitionImageLayout(VkDevice device, VkCommandPool commandPool, VkQueue g
     barrier.image = image;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT; // l'immagine è un'immagine di colore
     barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.levelCount = mipLevels;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
 
@@ -226,8 +277,6 @@ void transitionImageLayout(VkDevice device, VkCommandPool commandPool, VkQueue g
         0, nullptr,
         0, nullptr,
         1, &barrier);
-
-    endSingleTimeCommands(device, commandPool, graphicsQueue, commandBuffer);
 }
 
 // funzione per copiare i dati da un buffer ad un image
@@ -236,13 +285,21 @@ void copyBufferToImage(VkDevice device, VkCommandPool commandPool, VkQueue graph
 {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
 
+    recordCopyBufferToImage(commandBuffer, buffer, 0, image, width, height, 0);
+
+    endSingleTimeCommands(device, commandPool, graphicsQueue, commandBuffer);
+}
+
+void recordCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset,
+                             VkImage image, uint32_t width, uint32_t height, uint32_t mipLevel)
+{
     VkBufferImageCopy region{};
-    region.bufferOffset = 0;
+    region.bufferOffset = bufferOffset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
 
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.mipLevel = mipLevel;
     region.imageSubresource.baseArrayLayer = 0;
     region.imageSubresource.layerCount = 1;
 
@@ -259,8 +316,76 @@ void copyBufferToImage(VkDevice device, VkCommandPool commandPool, VkQueue graph
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
         1,
         &region);
+}
 
-    endSingleTimeCommands(device, commandPool, graphicsQueue, commandBuffer);
+bool supportsLinearBlit(VkPhysicalDevice physicalDevice, VkFormat format)
+{
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+    return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+}
+
+void recordGenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    int32_t mipWidth = static_cast<int32_t>(width);
+    int32_t mipHeight = static_cast<int32_t>(height);
+    for (uint32_t level = 1; level < mipLevels; level++)
+    {
+        // il livello precedente, appena scritto dalla copia o dal blit, diventa la sorgente del blit
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkImageBlit blit{};
+        blit.srcOffsets[0] = {0, 0, 0};
+        blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = 1;
+        blit.dstOffsets[0] = {0, 0, 0};
+        blit.dstOffsets[1] = {mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1};
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = 1;
+        vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1, &blit, VK_FILTER_LINEAR);
+
+        // il livello precedente non serve più come sorgente, quindi può già essere letto dagli shader
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+
+        mipWidth = mipWidth > 1 ? mipWidth / 2 : 1;
+        mipHeight = mipHeight > 1 ? mipHeight / 2 : 1;
+    }
+
+    // l'ultimo livello è stato solo scritto, quindi passa direttamente da destinazione a lettura
+    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
 }
 
 VkCommandBuffer beginSingleTimeCommands(VkDevice device, VkCommandPool commandPool)
@@ -298,7 +423,7 @@ void endSingleTimeCommands(VkDevice device, VkCommandPool commandPool, VkQueue g
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
-VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels)
 {
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -307,7 +432,7 @@ VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkI
     viewInfo.format = format;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
@@ -2,6 +2,7 @@
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
 #include <array>
+#include "deviceAllocator.h"
 
 /**
  * @brief Struttura per i vertici del modello.
@@ -26,6 +27,28 @@ struct Vertex
     static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions();
 };
 
+/**
+ * @brief Crea l'allocatore della memoria del dispositivo usato da createBuffer e createImage.
+ *
+ * Va chiamato dopo la creazione del dispositivo logico e prima di creare buffer e immagini.
+ *
+ * @param device Il dispositivo Vulkan.
+ * @param physicalDevice Il dispositivo fisico Vulkan.
+ * @param getMemoryProperties2 vkGetPhysicalDeviceMemoryProperties2KHR se VK_EXT_memory_budget è attiva, altrimenti nullptr.
+ */
+void createDeviceAllocator(VkDevice device, VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr);
+
+/**
+ * @brief Distrugge l'allocatore della memoria del dispositivo, dopo che tutti i buffer e le immagini sono stati distrutti.
+ */
+void destroyDeviceAllocator();
+
+/**
+ * @brief Restituisce l'allocatore della memoria del dispositivo.
+ * @return L'allocatore creato con createDeviceAllocator.
+ */
+DeviceAllocator *getDeviceAllocator();
+
 /**
  * @brief Crea un buffer e alloca memoria per esso.
  *
@@ -35,13 +58,23 @@ struct Vertex
  * @param size La dimensione del buffer da creare.
  * @param usage Le flag di utilizzo del buffer
  * @param properties Le proprietà della memoria del buffer.
+ * @param category A cosa serve il buffer, per la contabilità della memoria (vedi memoryBudget.h).
  * @param buffer Il buffer creato.
- * @param bufferMemory La memoria allocata per il buffer.
+ * @param bufferMemory La porzione di memoria allocata per il buffer, con il puntatore ai dati se la memoria è host visible.
  */
 void createBuffer(VkDevice device, VkPhysicalDevice physicalDevice,
                   VkDeviceSize size, VkBufferUsageFlags usage,
-                  VkMemoryPropertyFlags properties,
-                  VkBuffer &buffer, VkDeviceMemory &bufferMemory);
+                  VkMemoryPropertyFlags properties, MemoryCategory category,
+                  VkBuffer &buffer, DeviceAllocation &bufferMemory);
+
+/**
+ * @brief Distrugge un buffer creato con createBuffer e libera la sua memoria.
+ *
+ * @param device Il dispositivo Vulkan.
+ * @param buffer Il buffer da distruggere.
+ * @param bufferMemory La memoria del buffer.
+ */
+void destroyBuffer(VkDevice device, VkBuffer buffer, const DeviceAllocation &bufferMemory);
 
 /**
  * @brief Trova il tipo di memoria adatto per un buffer.
@@ -55,6 +88,18 @@ void createBuffer(VkDevice device, VkPhysicalDevice physicalDevice,
 uint32_t findMemoryType(VkPhysicalDevice physicalDevice,
                         uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
+/**
+ * @brief Controlla se conviene scrivere i buffer direttamente nella memoria device local, senza passare dal buffer di staging.
+ *
+ * Serve un tipo di memoria device local, host visible e host coherent il cui heap sia grande quanto la memoria device local:
+ * succede sulle GPU integrate (UMA), sui rasterizzatori software come lavapipe e sulle GPU dedicate con resizable BAR.
+ * Senza resizable BAR la parte host visible della memoria video è di solito solo 256 MB, troppo poca per tutti i modelli.
+ *
+ * @param physicalDevice Il dispositivo fisico Vulkan.
+ * @return true se i buffer possono essere scritti direttamente.
+ */
+bool supportsDirectUploads(VkPhysicalDevice physicalDevice);
+
 /**
  * @brief Copia i dati da un buffer ad un altro.
  *
@@ -79,18 +124,29 @@ void copyBuffer(VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueu
  * @param physicalDevice Il dispositivo fisico Vulkan.
  * @param width La larghezza dell'immagine.
  * @param height L'altezza dell'immagine.
+ * @param mipLevels Il numero di livelli di mipmap (vedi mipLevelCount in mipmap.h), 1 per le immagini senza mipmap.
  * @param format Il formato dell'immagine.
  * @param tiling Il tipo di tiling dell'immagine
  * @param usage Le flag di utilizzo dell'immagine
  * @param properties Le proprietà della memoria dell'immagine.
+ * @param category A cosa serve l'immagine, per la contabilità della memoria (vedi memoryBudget.h).
  * @param image L'immagine creata.
- * @param imageMemory La memoria allocata per l'immagine.
+ * @param imageMemory La porzione di memoria allocata per l'immagine.
  */
 void createImage(VkDevice device, VkPhysicalDevice physicalDevice,
-                 uint32_t width, uint32_t height, VkFormat format,
+                 uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format,
                  VkImageTiling tiling, VkImageUsageFlags usage,
-                 VkMemoryPropertyFlags properties,
-                 VkImage &image, VkDeviceMemory &imageMemory);
+                 VkMemoryPropertyFlags properties, MemoryCategory category,
+                 VkImage &image, DeviceAllocation &imageMemory);
+
+/**
+ * @brief Distrugge un'immagine creata con createImage e libera la sua memoria.
+ *
+ * @param device Il dispositivo Vulkan.
+ * @param image L'immagine da distruggere.
+ * @param imageMemory La memoria dell'immagine.
+ */
+void destroyImage(VkDevice device, VkImage image, const DeviceAllocation &imageMemory);
 
 /**
  * @brief Transizione del layout di un'immagine.
@@ -104,10 +160,26 @@ void createImage(VkDevice device, VkPhysicalDevice physicalDevice,
  * @param format Il formato dell'immagine.
  * @param oldLayout Il layout precedente dell'immagine.
  * @param newLayout Il nuovo layout dell'immagine.
+ * @param mipLevels Il numero di livelli di mipmap dell'immagine, la transizione vale per tutti.
  */
 void transitionImageLayout(VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueue,
                            VkImage image, VkFormat format,
-                           VkImageLayout oldLayout, VkImageLayout newLayout);
+                           VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
+
+/**
+ * @brief Registra la transizione del layout di un'immagine in un command buffer già iniziato.
+ *
+ * È la parte di transitionImageLayout che non invia i comandi, così più operazioni possono stare nello stesso command buffer.
+ *
+ * @param commandBuffer Il command buffer in cui registrare la barriera.
+ * @param image L'immagine di cui cambiare il layout.
+ * @param oldLayout Il layout precedente dell'immagine.
+ * @param newLayout Il nuovo layout dell'immagine.
+ * @param mipLevels Il numero di livelli di mipmap dell'immagine, la transizione vale per tutti.
+ * @throws std::invalid_argument Se la transizione non è supportata.
+ */
+void recordTransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image,
+                                 VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
 
 /**
  * @brief Copia i dati da un buffer a un'immagine.
@@ -125,6 +197,44 @@ void transitionImageLayout(VkDevice device, VkCommandPool commandPool, VkQueue g
 void copyBufferToImage(VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueue,
                        VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 
+/**
+ * @brief Registra la copia da un buffer a un'immagine in un command buffer già iniziato.
+ *
+ * @param commandBuffer Il command buffer in cui registrare la copia.
+ * @param buffer Il buffer da cui copiare i dati.
+ * @param bufferOffset La posizione dei dati nel buffer.
+ * @param image L'immagine in cui copiare i dati, nel layout VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
+ * @param width La larghezza del livello di mipmap.
+ * @param height L'altezza del livello di mipmap.
+ * @param mipLevel Il livello di mipmap in cui copiare i dati.
+ */
+void recordCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize bufferOffset,
+                             VkImage image, uint32_t width, uint32_t height, uint32_t mipLevel);
+
+/**
+ * @brief Controlla se un formato supporta il filtro lineare in vkCmdBlitImage, necessario per generare le mipmap sulla GPU.
+ *
+ * @param physicalDevice Il dispositivo fisico Vulkan.
+ * @param format Il formato dell'immagine, con tiling ottimale.
+ * @return true se le mipmap possono essere generate con recordGenerateMipmaps.
+ */
+bool supportsLinearBlit(VkPhysicalDevice physicalDevice, VkFormat format);
+
+/**
+ * @brief Registra la generazione delle mipmap di un'immagine con vkCmdBlitImage, in un command buffer della coda grafica.
+ *
+ * Ogni livello viene ottenuto dimezzando il precedente con il filtro lineare.
+ * Il livello 0 deve essere già stato copiato e tutti i livelli devono essere nel layout VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+ * alla fine tutti i livelli sono nel layout VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+ *
+ * @param commandBuffer Il command buffer in cui registrare i comandi, di una coda con supporto grafico.
+ * @param image L'immagine, creata con VK_IMAGE_USAGE_TRANSFER_SRC_BIT e VK_IMAGE_USAGE_TRANSFER_DST_BIT.
+ * @param width La larghezza dell'immagine.
+ * @param height L'altezza dell'immagine.
+ * @param mipLevels Il numero di livelli di mipmap dell'immagine.
+ */
+void recordGenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels);
+
 /**
  * @brief Inizia un comando di singola transazione.
  *
@@ -156,6 +266,8 @@ void endSingleTimeCommands(VkDevice device, VkCommandPool commandPool, VkQueue g
  * @param device Il dispositivo Vulkan su cui creare la vista immagine.
  * @param image L'immagine per cui creare la vista.
  * @param format Il formato dell'immagine.
+ * @param aspectFlags Le parti dell'immagine visibili dalla vista (colore o profondità).
+ * @param mipLevels Il numero di livelli di mipmap dell'immagine, tutti visibili dalla vista.
  * @return La vista immagine creata.
  */
-VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
\ No newline at end of file
+VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "commandRecorder.h"
+#include <stdexcept>
+#include <chrono>
+#include <algorithm>
+
+CommandRecorder::CommandRecorder(VkDevice device, uint32_t queueFamilyIndex, uint32_t threadCount, uint32_t frameCount)
+    : device(device), threadCount(threadCount), pools(threadCount), buffers(threadCount), frameBuffers(threadCount),
+      threadMs(threadCount, 0.0), errors(threadCount)
+{
+    for (uint32_t thread = 0; thread < threadCount; thread++)
+    {
+        pools[thread].resize(frameCount, VK_NULL_HANDLE);
+        buffers[thread].resize(frameCount, VK_NULL_HANDLE);
+        for (uint32_t frame = 0; frame < frameCount; frame++)
+        {
+            // i command buffer vengono registrati una volta sola e poi resettati insieme al pool
+            VkCommandPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            poolInfo.queueFamilyIndex = queueFamilyIndex;
+            if (vkCreateCommandPool(device, &poolInfo, nullptr, &pools[thread][frame]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create recording command pool!");
+            }
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = pools[thread][frame];
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(device, &allocInfo, &buffers[thread][frame]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to allocate secondary command buffers!");
+            }
+        }
+    }
+
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.subpass = 0;
+    for (uint32_t thread = 0; thread < threadCount; thread++)
+    {
+        workers.emplace_back(&CommandRecorder::workerLoop, this, thread);
+    }
+}
+
+CommandRecorder::~CommandRecorder()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    startCondition.notify_all();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+    // distruggere il pool libera anche i suoi command buffer
+    for (auto &threadPools : pools)
+    {
+        for (VkCommandPool pool : threadPools)
+        {
+            if (pool != VK_NULL_HANDLE)
+            {
+                vkDestroyCommandPool(device, pool, nullptr);
+            }
+        }
+    }
+}
+
+const std::vector<VkCommandBuffer> &CommandRecorder::record(uint32_t frameIndex, VkRenderPass renderPass, VkFramebuffer framebuffer, const RecordChunk &recordChunk,
+                                                            bool reusable)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->frameIndex = frameIndex;
+        this->recordChunk = &recordChunk;
+        this->job = nullptr;
+        this->reusable = reusable;
+        inheritance.renderPass = renderPass;
+        inheritance.framebuffer = framebuffer; // facoltativo, ma permette al driver di ottimizzare i comandi per il framebuffer
+    }
+    dispatch();
+    for (uint32_t thread = 0; thread < threadCount; thread++)
+    {
+        frameBuffers[thread] = buffers[thread][frameIndex];
+    }
+    return frameBuffers;
+}
+
+void CommandRecorder::run(const Job &job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->job = &job;
+    }
+    dispatch();
+}
+
+void CommandRecorder::dispatch()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = threadCount;
+        generation++;
+    }
+    startCondition.notify_all();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [this]()
+                           { return pending == 0; });
+    }
+    for (uint32_t thread = 0; thread < threadCount; thread++)
+    {
+        if (errors[thread])
+        {
+            std::exception_ptr error = errors[thread];
+            errors[thread] = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+std::vector<VkCommandBuffer> CommandRecorder::getCommandBuffers(uint32_t frameIndex) const
+{
+    std::vector<VkCommandBuffer> frameCommandBuffers(threadCount);
+    for (uint32_t thread = 0; thread < threadCount; thread++)
+    {
+        frameCommandBuffers[thread] = buffers[thread][frameIndex];
+    }
+    return frameCommandBuffers;
+}
+
+void CommandRecorder::workerLoop(uint32_t thread)
+{
+    uint64_t recorded = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            startCondition.wait(lock, [&]()
+                                { return stopping || generation != recorded; });
+            if (stopping)
+            {
+                return;
+            }
+            recorded = generation;
+        }
+        try
+        {
+            if (job != nullptr)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                (*job)(thread);
+                threadMs[thread] += std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+            }
+            else
+            {
+                recordOn(thread);
+            }
+        }
+        catch (...)
+        {
+            errors[thread] = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending--;
+        }
+        doneCondition.notify_one();
+    }
+}
+
+void CommandRecorder::recordOn(uint32_t thread)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    // la GPU ha finito il frame, quindi tutti i comandi del pool si possono buttare insieme
+    vkResetCommandPool(device, pools[thread][frameIndex], 0);
+
+    VkCommandBuffer commandBuffer = buffers[thread][frameIndex];
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    // RENDER_PASS_CONTINUE: i comandi vengono eseguiti dentro il render pass del command buffer primario
+    // ONE_TIME_SUBMIT permette al driver di non conservare i comandi dopo l'esecuzione, quindi si usa solo se non verranno riutilizzati
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | (reusable ? 0 : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    beginInfo.pInheritanceInfo = &inheritance;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to begin recording secondary command buffer!");
+    }
+    (*recordChunk)(commandBuffer, thread);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to record secondary command buffer!");
+    }
+    threadMs[thread] += std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+uint32_t CommandRecorder::getThreadCount() const
+{
+    return threadCount;
+}
+
+const std::vector<double> &CommandRecorder::getThreadMs() const
+{
+    return threadMs;
+}
+
+void CommandRecorder::resetTimings()
+{
+    std::fill(threadMs.begin(), threadMs.end(), 0.0);
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <cstdint>
+
+/**
+ * @brief Pool di thread che registrano i comandi di disegno di un frame in parallelo, in command buffer secondari.
+ *
+ * Ogni thread ha un command pool per ogni frame in volo, perché un command pool e i suoi command buffer
+ * possono essere usati da un solo thread alla volta: così i thread registrano senza nessun lock.
+ * Il command pool di un frame viene resettato tutto insieme all'inizio della registrazione successiva dello stesso frame,
+ * quando la GPU ha finito di usarne i comandi, invece di resettare i command buffer uno per uno.
+ * I command buffer secondari restituiti da record vanno eseguiti nel render pass del command buffer primario con vkCmdExecuteCommands,
+ * nell'ordine del vettore: il pezzo i viene dopo il pezzo i - 1, quindi l'ordine dei disegni (per esempio per la trasparenza) resta quello della lista.
+ * I thread restano in attesa tra un frame e l'altro, quindi non vengono creati a ogni frame.
+ * I command buffer registrati come riutilizzabili restano validi fino alla prossima registrazione dello stesso frame,
+ * quindi possono essere eseguiti di nuovo nei frame successivi (vedi getCommandBuffers) senza registrarli ancora.
+ * Gli stessi thread eseguono anche i lavori senza comandi di run, come la scrittura dei dati degli oggetti prima della registrazione.
+ */
+class CommandRecorder
+{
+public:
+    /**
+     * @brief Funzione che registra un pezzo dei disegni del frame.
+     *
+     * Riceve il command buffer secondario già iniziato, con il render pass ereditato, e l'indice del pezzo (uguale a quello del thread).
+     */
+    using RecordChunk = std::function<void(VkCommandBuffer, uint32_t)>;
+
+    /**
+     * @brief Lavoro senza comandi eseguito da tutti i thread insieme, riceve l'indice del thread.
+     */
+    using Job = std::function<void(uint32_t)>;
+
+    /**
+     * @brief Costruttore della classe CommandRecorder.
+     *
+     * Crea i command pool e i command buffer secondari di ogni thread e avvia i thread.
+     *
+     * @param device Il dispositivo Vulkan su cui operare.
+     * @param queueFamilyIndex La famiglia della coda su cui verrà inviato il command buffer primario.
+     * @param threadCount Il numero di thread, cioè di pezzi in cui viene diviso ogni frame.
+     * @param frameCount Il numero di frame in volo.
+     * @throws std::runtime_error Se non è possibile creare le risorse Vulkan.
+     */
+    CommandRecorder(VkDevice device, uint32_t queueFamilyIndex, uint32_t threadCount, uint32_t frameCount);
+
+    /**
+     * @brief Distruttore della classe CommandRecorder.
+     *
+     * Ferma i thread e distrugge i command pool: la GPU non deve più usare i loro comandi.
+     */
+    ~CommandRecorder();
+
+    /**
+     * @brief Registra i pezzi di un frame, ognuno sul suo thread, e aspetta che siano tutti pronti.
+     *
+     * Va chiamato dopo aver aspettato la fence del frame. Se la registrazione di un pezzo lancia un'eccezione,
+     * viene rilanciata qui dopo che tutti i thread hanno finito.
+     *
+     * @param frameIndex Il frame in volo.
+     * @param renderPass Il render pass in cui verranno eseguiti i comandi.
+     * @param framebuffer Il framebuffer del render pass, VK_NULL_HANDLE se i comandi verranno eseguiti con framebuffer diversi.
+     * @param recordChunk La funzione che registra un pezzo, chiamata una volta per ogni thread in contemporanea.
+     * @param reusable true se i command buffer verranno eseguiti in più frame, false se verranno eseguiti una volta sola.
+     * @return I command buffer secondari, uno per thread, da eseguire nell'ordine con vkCmdExecuteCommands.
+     */
+    const std::vector<VkCommandBuffer> &record(uint32_t frameIndex, VkRenderPass renderPass, VkFramebuffer framebuffer, const RecordChunk &recordChunk,
+                                               bool reusable = false);
+
+    /**
+     * @brief Esegue un lavoro su tutti i thread, per esempio preparare i dati degli oggetti prima di registrare, e aspetta che abbiano finito.
+     *
+     * Se il lavoro lancia un'eccezione su un thread, viene rilanciata qui dopo che tutti i thread hanno finito.
+     *
+     * @param job La funzione da eseguire, chiamata una volta per ogni thread in contemporanea.
+     */
+    void run(const Job &job);
+
+    /**
+     * @brief Restituisce i command buffer secondari registrati per ultimi per un frame, per eseguirli di nuovo.
+     *
+     * Sono validi solo se sono stati registrati come riutilizzabili e se nel frattempo non è cambiato niente di quello che usano.
+     *
+     * @param frameIndex Il frame in volo.
+     * @return I command buffer secondari del frame, uno per thread.
+     */
+    std::vector<VkCommandBuffer> getCommandBuffers(uint32_t frameIndex) const;
+
+    /**
+     * @brief Restituisce il numero di thread.
+     * @return Il numero di pezzi di ogni frame.
+     */
+    uint32_t getThreadCount() const;
+
+    /**
+     * @brief Restituisce il tempo speso da ogni thread a registrare e nei lavori di run, sommato dall'ultima chiamata a resetTimings.
+     * @return I millisecondi di ogni thread.
+     */
+    const std::vector<double> &getThreadMs() const;
+
+    /**
+     * @brief Azzera i tempi dei thread.
+     */
+    void resetTimings();
+
+private:
+    // ciclo di un thread: aspetta un frame o un lavoro, registra il suo pezzo o esegue il lavoro e avvisa quando ha finito
+    void workerLoop(uint32_t thread);
+    // sveglia i thread, aspetta che abbiano finito e rilancia il primo errore
+    void dispatch();
+    // registra il pezzo del frame corrente sul command buffer del thread
+    void recordOn(uint32_t thread);
+
+    VkDevice device;
+    uint32_t threadCount;
+    std::vector<std::vector<VkCommandPool>> pools;     // [thread][frame]
+    std::vector<std::vector<VkCommandBuffer>> buffers; // [thread][frame], un command buffer secondario per ogni pool
+    std::vector<VkCommandBuffer> frameBuffers;         // command buffer secondari dell'ultimo frame registrato, in ordine di pezzo
+    std::vector<double> threadMs;
+    std::vector<std::exception_ptr> errors;
+
+    // dati del frame da registrare, scritti solo mentre i thread aspettano
+    uint32_t frameIndex = 0;
+    VkCommandBufferInheritanceInfo inheritance{};
+    const RecordChunk *recordChunk = nullptr;
+    const Job *job = nullptr; // lavoro di run, nullptr quando i thread devono registrare
+    bool reusable = false;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable startCondition; // avvisa i thread che c'è un frame da registrare
+    std::condition_variable doneCondition;  // avvisa record che tutti i thread hanno finito
+    uint64_t generation = 0;                // numero del frame da registrare, ogni thread registra quando cambia
+    uint32_t pending = 0;                   // thread che non hanno ancora finito il frame corrente
+    bool stopping = false;
+};
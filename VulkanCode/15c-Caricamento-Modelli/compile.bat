@@ -17,4 +17,9 @@ for %%f in (%SRC%\*.frag) do (
     %GLSLC% %%f -o %DST%\%%~nxf.spv
 )
 
+echo Compiling fragment shaders without non-uniform texture indexing...
+for %%f in (%SRC%\*.frag) do (
+    %GLSLC% -DUNIFORM_TEXTURE_INDEX %%f -o %DST%\%%~nxf.uniform.spv
+)
+
 echo Done!
\ No newline at end of file
@@ -0,0 +1,29 @@
+#!/bin/sh
+# come compile.bat, per Linux e macOS: usa glslc del Vulkan SDK se VULKAN_SDK è impostata, altrimenti quello nel PATH
+cd "$(dirname "$0")" || exit 1
+if [ -n "$VULKAN_SDK" ]; then
+    GLSLC="$VULKAN_SDK/bin/glslc"
+else
+    GLSLC=glslc
+fi
+SRC=shaders
+DST=compiled
+
+mkdir -p "$DST"
+
+echo "Compiling vertex shaders..."
+for f in "$SRC"/*.vert; do
+    "$GLSLC" "$f" -o "$DST/$(basename "$f").spv" || exit 1
+done
+
+echo "Compiling fragment shaders..."
+for f in "$SRC"/*.frag; do
+    "$GLSLC" "$f" -o "$DST/$(basename "$f").spv" || exit 1
+done
+
+echo "Compiling fragment shaders without non-uniform texture indexing..."
+for f in "$SRC"/*.frag; do
+    "$GLSLC" -DUNIFORM_TEXTURE_INDEX "$f" -o "$DST/$(basename "$f").uniform.spv" || exit 1
+done
+
+echo "Done!"
@@ -0,0 +1,33 @@
+#include "deletionQueue.h"
+#include <utility>
+
+DeletionQueue::~DeletionQueue()
+{
+    flush();
+}
+
+void DeletionQueue::push(uint64_t frame, std::function<void()> destroy)
+{
+    pending.push_back({frame, std::move(destroy)});
+}
+
+void DeletionQueue::collect(uint64_t completedFrame)
+{
+    while (!pending.empty() && pending.front().frame <= completedFrame)
+    {
+        // togliamo la distruzione dalla coda prima di eseguirla, così può mettere in coda altre distruzioni
+        std::function<void()> destroy = std::move(pending.front().destroy);
+        pending.pop_front();
+        destroy();
+    }
+}
+
+void DeletionQueue::flush()
+{
+    collect(UINT64_MAX);
+}
+
+size_t DeletionQueue::size() const
+{
+    return pending.size();
+}
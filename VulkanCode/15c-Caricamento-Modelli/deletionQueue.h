@@ -0,0 +1,58 @@
+#pragma once
+#include <deque>
+#include <functional>
+#include <cstdint>
+
+/**
+ * @brief Coda di distruzioni rimandate finché la GPU non ha finito di usare le risorse.
+ *
+ * Ogni frame inviato alla coda grafica ha un numero crescente, e la fence del frame dice quando la GPU lo ha finito.
+ * Una risorsa non più usata viene messa nella coda con il numero dell'ultimo frame che può usarla:
+ * la distruzione avviene con collect appena quel frame è finito, senza fermare la GPU con vkDeviceWaitIdle.
+ * Non è thread safe: va usata solo dal thread che disegna i frame.
+ */
+class DeletionQueue
+{
+public:
+    /**
+     * @brief Distruttore della classe DeletionQueue.
+     *
+     * Esegue le distruzioni ancora in coda: a quel punto il dispositivo deve essere già inattivo.
+     */
+    ~DeletionQueue();
+
+    /**
+     * @brief Mette in coda la distruzione di una risorsa.
+     *
+     * @param frame Il numero dell'ultimo frame che può usare la risorsa.
+     * @param destroy La funzione che distrugge la risorsa.
+     */
+    void push(uint64_t frame, std::function<void()> destroy);
+
+    /**
+     * @brief Esegue le distruzioni delle risorse usate solo da frame già finiti.
+     * @param completedFrame Il numero dell'ultimo frame finito dalla GPU.
+     */
+    void collect(uint64_t completedFrame);
+
+    /**
+     * @brief Esegue tutte le distruzioni in coda, da chiamare solo con il dispositivo inattivo (per esempio alla chiusura).
+     */
+    void flush();
+
+    /**
+     * @brief Restituisce il numero di distruzioni ancora in coda.
+     * @return Il numero di distruzioni in attesa.
+     */
+    size_t size() const;
+
+private:
+    struct PendingDeletion
+    {
+        uint64_t frame;
+        std::function<void()> destroy;
+    };
+
+    // in ordine di frame: le distruzioni vengono messe in coda con numeri di frame che non diminuiscono mai
+    std::deque<PendingDeletion> pending;
+};
@@ -0,0 +1,207 @@
+#include "deviceAllocator.h"
+#include <stdexcept>
+#include <algorithm>
+
+// dimensione dei blocchi di memoria: con 64 MB i modelli e le texture attuali stanno in pochi blocchi per tipo di memoria
+const VkDeviceSize DEVICE_MEMORY_BLOCK_SIZE = 64 * 1024 * 1024;
+// porzione più piccola: i buffer uniformi occupano poche centinaia di byte
+const VkDeviceSize DEVICE_MEMORY_MIN_SIZE = 256;
+
+DeviceAllocator::DeviceAllocator(VkDevice device, VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2)
+    : device(device), budget(physicalDevice, getMemoryProperties2)
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    // le porzioni della memoria host visible non coerente vanno allineate a nonCoherentAtomSize per poterle sincronizzare,
+    // lo applichiamo a tutte così le porzioni restano intercambiabili
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    minAlignment = std::max(DEVICE_MEMORY_MIN_SIZE, properties.limits.nonCoherentAtomSize);
+}
+
+DeviceAllocator::~DeviceAllocator()
+{
+    for (MemoryBlock *block : blocks)
+    {
+        if (block != nullptr)
+        {
+            vkFreeMemory(device, block->memory, nullptr);
+            delete block;
+        }
+    }
+}
+
+VkDeviceMemory DeviceAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void *&mapped)
+{
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    // avvisa se l'heap è vicino o oltre il budget, prima che l'allocazione fallisca
+    budget.checkDeviceAllocation(memoryType, size);
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate device memory!");
+    }
+    allocatedBytes += size;
+    peakAllocatedBytes = std::max(peakAllocatedBytes, allocatedBytes);
+    budget.trackDeviceMemory(memoryType, static_cast<int64_t>(size));
+    mapped = nullptr;
+    if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    }
+    return memory;
+}
+
+DeviceAllocation DeviceAllocator::allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear, MemoryCategory category)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // tra i tipi adatti scegliamo quello con l'heap più grande: senza resizable BAR il primo tipo device local e host visible
+    // sta nella finestra da 256 MB, che si riempirebbe subito con i buffer scritti direttamente (vedi supportsDirectUploads)
+    // se la richiesta non chiede memoria device local evitiamo quella, così lo staging resta nella memoria di sistema
+    uint32_t memoryType = UINT32_MAX;
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+        if (!(requirements.memoryTypeBits & (1 << i)) || (memoryProperties.memoryTypes[i].propertyFlags & properties) != properties)
+        {
+            continue;
+        }
+        if (memoryType == UINT32_MAX)
+        {
+            memoryType = i;
+            continue;
+        }
+        bool unwantedLocal = !(properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        bool bestUnwantedLocal = !(properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size;
+        VkDeviceSize bestHeapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+        if (unwantedLocal != bestUnwantedLocal ? bestUnwantedLocal : heapSize > bestHeapSize)
+        {
+            memoryType = i;
+        }
+    }
+    if (memoryType == UINT32_MAX)
+    {
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    DeviceAllocation allocation;
+    allocation.size = requirements.size;
+    allocation.memoryType = memoryType;
+    allocation.category = category;
+    VkDeviceSize alignment = std::max(requirements.alignment, minAlignment);
+
+    // le risorse più grandi di un blocco hanno una memoria tutta loro
+    if (std::max(requirements.size, alignment) > DEVICE_MEMORY_BLOCK_SIZE)
+    {
+        allocation.memory = allocateDeviceMemory(requirements.size, memoryType, allocation.mapped);
+        dedicatedCount++;
+        budget.trackResource(category, static_cast<int64_t>(requirements.size));
+        return allocation;
+    }
+
+    // cerchiamo spazio nei blocchi già allocati dello stesso tipo, altrimenti ne allochiamo uno nuovo
+    for (size_t i = 0; i <= blocks.size(); i++)
+    {
+        if (i == blocks.size())
+        {
+            void *mapped;
+            VkDeviceMemory memory = allocateDeviceMemory(DEVICE_MEMORY_BLOCK_SIZE, memoryType, mapped);
+            MemoryBlock *block = new MemoryBlock{memory, mapped, memoryType, linear, BuddyAllocator(DEVICE_MEMORY_BLOCK_SIZE, DEVICE_MEMORY_MIN_SIZE)};
+            // riusiamo il posto di un blocco liberato, se c'è
+            auto freeSlot = std::find(blocks.begin(), blocks.end(), nullptr);
+            if (freeSlot != blocks.end())
+            {
+                i = static_cast<size_t>(freeSlot - blocks.begin());
+                *freeSlot = block;
+            }
+            else
+            {
+                blocks.push_back(block);
+            }
+        }
+        MemoryBlock *block = blocks[i];
+        if (block == nullptr || block->memoryType != memoryType || block->linear != linear)
+        {
+            continue;
+        }
+        uint64_t offset;
+        if (block->buddy.allocate(requirements.size, alignment, offset))
+        {
+            allocation.memory = block->memory;
+            allocation.offset = offset;
+            allocation.mapped = block->mapped != nullptr ? static_cast<uint8_t *>(block->mapped) + offset : nullptr;
+            allocation.block = static_cast<int32_t>(i);
+            budget.trackResource(category, static_cast<int64_t>(requirements.size));
+            return allocation;
+        }
+    }
+    throw std::runtime_error("failed to allocate device memory!"); // non succede: un blocco nuovo contiene sempre la richiesta
+}
+
+void DeviceAllocator::free(const DeviceAllocation &allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    budget.trackResource(allocation.category, -static_cast<int64_t>(allocation.size));
+    if (allocation.block < 0)
+    {
+        vkFreeMemory(device, allocation.memory, nullptr);
+        dedicatedCount--;
+        allocatedBytes -= allocation.size;
+        budget.trackDeviceMemory(allocation.memoryType, -static_cast<int64_t>(allocation.size));
+        return;
+    }
+    MemoryBlock *block = blocks[allocation.block];
+    block->buddy.free(allocation.offset);
+    if (block->buddy.isEmpty())
+    {
+        // un blocco vuoto torna al driver, così la memoria non resta occupata dopo aver cambiato scena
+        vkFreeMemory(device, block->memory, nullptr);
+        delete block;
+        blocks[allocation.block] = nullptr;
+        allocatedBytes -= DEVICE_MEMORY_BLOCK_SIZE;
+        budget.trackDeviceMemory(allocation.memoryType, -static_cast<int64_t>(DEVICE_MEMORY_BLOCK_SIZE));
+    }
+}
+
+uint32_t DeviceAllocator::getDeviceAllocationCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t count = dedicatedCount;
+    for (MemoryBlock *block : blocks)
+    {
+        count += block != nullptr ? 1 : 0;
+    }
+    return count;
+}
+
+VkDeviceSize DeviceAllocator::getPeakAllocatedBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return peakAllocatedBytes;
+}
+
+void DeviceAllocator::printMemoryReport(std::ostream &out)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    budget.printReport(out);
+}
+
+void DeviceAllocator::writeMemoryReport(std::ostream &out)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    budget.writeJson(out);
+}
+
+VkDeviceSize DeviceAllocator::getCategoryBytes(MemoryCategory category) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return budget.getCategoryBytes(category);
+}
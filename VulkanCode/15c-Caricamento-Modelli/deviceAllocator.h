@@ -0,0 +1,126 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <mutex>
+#include <ostream>
+#include "buddyAllocator.h"
+#include "memoryBudget.h"
+
+/**
+ * @brief Una porzione di memoria del dispositivo, presa da DeviceAllocator.
+ *
+ * Il buffer o l'immagine va collegato a memory con l'offset indicato. Se la memoria è host visible, mapped punta già ai suoi dati.
+ */
+struct DeviceAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void *mapped = nullptr;  // puntatore ai dati se la memoria è host visible, altrimenti nullptr
+    int32_t block = -1;      // blocco da cui è stata presa, -1 se ha un'allocazione dedicata
+    uint32_t memoryType = 0;
+    MemoryCategory category = MemoryCategory::Mesh;
+};
+
+/**
+ * @brief Allocatore della memoria del dispositivo che evita una vkAllocateMemory per ogni buffer e immagine.
+ *
+ * Per ogni tipo di memoria vengono allocati blocchi grandi (DEVICE_MEMORY_BLOCK_SIZE), divisi tra le risorse con un BuddyAllocator.
+ * Le risorse lineari (buffer) e quelle non lineari (immagini con tiling ottimale) stanno in blocchi diversi,
+ * così non possono mai trovarsi nella stessa pagina di bufferImageGranularity.
+ * I blocchi host visible vengono mappati una volta sola, perché la stessa VkDeviceMemory non può essere mappata due volte.
+ * Le richieste più grandi di un blocco ricevono un'allocazione dedicata.
+ * Ogni porzione ha una categoria (mesh, texture...), così MemoryBudget può dire quanta memoria usa ogni parte della scena.
+ * Tra i tipi di memoria adatti a una richiesta viene scelto quello con l'heap più grande (e non device local, se non è richiesto).
+ */
+class DeviceAllocator
+{
+public:
+    /**
+     * @brief Costruttore della classe DeviceAllocator.
+     *
+     * @param device Il dispositivo Vulkan su cui operare.
+     * @param physicalDevice Il dispositivo fisico Vulkan.
+     * @param getMemoryProperties2 vkGetPhysicalDeviceMemoryProperties2KHR se VK_EXT_memory_budget è attiva, altrimenti nullptr.
+     */
+    DeviceAllocator(VkDevice device, VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr);
+
+    /**
+     * @brief Distruttore della classe DeviceAllocator.
+     *
+     * Libera tutti i blocchi: tutte le risorse che li usano devono essere già state distrutte.
+     */
+    ~DeviceAllocator();
+
+    /**
+     * @brief Prende una porzione di memoria adatta a una risorsa.
+     *
+     * @param requirements I requisiti della risorsa, da vkGetBufferMemoryRequirements o vkGetImageMemoryRequirements.
+     * @param properties Le proprietà della memoria desiderate.
+     * @param linear true per i buffer e le immagini lineari, false per le immagini con tiling ottimale.
+     * @param category A cosa serve la risorsa, per la contabilità della memoria.
+     * @return La porzione di memoria.
+     * @throws std::runtime_error Se non c'è un tipo di memoria adatto o se l'allocazione fallisce.
+     */
+    DeviceAllocation allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear, MemoryCategory category);
+
+    /**
+     * @brief Libera una porzione presa con allocate. I blocchi rimasti vuoti vengono restituiti al driver.
+     * @param allocation La porzione da liberare.
+     */
+    void free(const DeviceAllocation &allocation);
+
+    /**
+     * @brief Restituisce il numero di allocazioni di memoria chieste al driver e ancora attive.
+     * @return Il numero di blocchi più le allocazioni dedicate.
+     */
+    uint32_t getDeviceAllocationCount() const;
+
+    /**
+     * @brief Restituisce il massimo di memoria chiesta al driver contemporaneamente, dalla creazione dell'allocatore.
+     * @return I byte di tutti i blocchi e delle allocazioni dedicate nel momento di massimo.
+     */
+    VkDeviceSize getPeakAllocatedBytes() const;
+
+    /**
+     * @brief Stampa l'uso della memoria per categoria e per heap, con il budget di ogni heap.
+     * @param out Lo stream su cui stampare.
+     */
+    void printMemoryReport(std::ostream &out);
+
+    /**
+     * @brief Scrive l'uso della memoria per categoria e per heap in formato JSON.
+     * @param out Lo stream su cui scrivere, per esempio un file.
+     */
+    void writeMemoryReport(std::ostream &out);
+
+    /**
+     * @brief Restituisce i byte delle risorse ancora vive di una categoria.
+     * @param category La categoria.
+     * @return I byte delle risorse.
+     */
+    VkDeviceSize getCategoryBytes(MemoryCategory category) const;
+
+private:
+    struct MemoryBlock
+    {
+        VkDeviceMemory memory;
+        void *mapped;
+        uint32_t memoryType;
+        bool linear;
+        BuddyAllocator buddy;
+    };
+
+    // alloca memoria dal driver e la mappa se è host visible
+    VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void *&mapped);
+
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkDeviceSize minAlignment;                  // granularità minima delle porzioni
+    std::vector<MemoryBlock *> blocks;           // i blocchi liberati lasciano un nullptr, così gli indici delle allocazioni restano validi
+    uint32_t dedicatedCount = 0;
+    VkDeviceSize allocatedBytes = 0;     // memoria chiesta al driver e non ancora liberata
+    VkDeviceSize peakAllocatedBytes = 0;
+    MemoryBudget budget;
+    mutable std::mutex mutex;
+};
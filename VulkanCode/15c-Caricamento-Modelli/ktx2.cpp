@@ -0,0 +1,251 @@
+#include "ktx2.h"
+#include "mipmap.h"
+#include <fstream>
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+
+namespace
+{
+    const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+    const size_t KTX2_HEADER_SIZE = 80;     // identificatore, 9 campi a 32 bit e l'indice di DFD, KVD e SGD
+    const size_t KTX2_LEVEL_INDEX_SIZE = 24; // posizione, dimensione e dimensione non compressa di ogni livello, a 64 bit
+
+    // valori del descrittore del formato (Khronos Data Format Specification)
+    const uint32_t KHR_DF_MODEL_BC1A = 128;
+    const uint32_t KHR_DF_MODEL_BC3 = 130;
+    const uint32_t KHR_DF_MODEL_BC7 = 134;
+    const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+    const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+    const uint32_t KHR_DF_TRANSFER_SRGB = 2;
+    const uint32_t KHR_DF_CHANNEL_COLOR = 0;
+    const uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+    const uint32_t KHR_DF_SAMPLE_DATATYPE_LINEAR = 1 << 4;
+
+    uint32_t read32(const std::vector<uint8_t> &file, size_t offset)
+    {
+        uint32_t value;
+        std::memcpy(&value, file.data() + offset, sizeof(value));
+        return value;
+    }
+
+    uint64_t read64(const std::vector<uint8_t> &file, size_t offset)
+    {
+        uint64_t value;
+        std::memcpy(&value, file.data() + offset, sizeof(value));
+        return value;
+    }
+
+    void write32(std::vector<uint8_t> &file, size_t offset, uint32_t value)
+    {
+        std::memcpy(file.data() + offset, &value, sizeof(value));
+    }
+
+    void write64(std::vector<uint8_t> &file, size_t offset, uint64_t value)
+    {
+        std::memcpy(file.data() + offset, &value, sizeof(value));
+    }
+
+    struct FormatDescription
+    {
+        uint32_t model;
+        uint32_t blockBytes;
+        bool srgb;
+    };
+
+    // false se il formato non è uno di quelli prodotti da texconvert
+    bool findFormat(VkFormat format, FormatDescription &description)
+    {
+        switch (format)
+        {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            description = {KHR_DF_MODEL_BC1A, 8, false};
+            return true;
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            description = {KHR_DF_MODEL_BC1A, 8, true};
+            return true;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+            description = {KHR_DF_MODEL_BC3, 16, false};
+            return true;
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            description = {KHR_DF_MODEL_BC3, 16, true};
+            return true;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+            description = {KHR_DF_MODEL_BC7, 16, false};
+            return true;
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            description = {KHR_DF_MODEL_BC7, 16, true};
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    FormatDescription describeFormat(VkFormat format)
+    {
+        FormatDescription description;
+        if (!findFormat(format, description))
+        {
+            throw std::runtime_error("unsupported KTX2 format!");
+        }
+        return description;
+    }
+
+    // un file che non si può usare: viene segnalato e il chiamante decodifica l'immagine originale
+    bool rejectKtx2(const std::string &path, const char *reason)
+    {
+        std::cerr << path << ": " << reason << ", uso l'immagine originale" << std::endl;
+        return false;
+    }
+
+    // descrittore del formato: un blocco di base con un campione per ogni parte del blocco compresso
+    std::vector<uint8_t> buildDataFormatDescriptor(VkFormat format)
+    {
+        FormatDescription description = describeFormat(format);
+        struct Sample
+        {
+            uint32_t bitOffset;
+            uint32_t bitLength;
+            uint32_t channel;
+        };
+        std::vector<Sample> samples;
+        if (description.model == KHR_DF_MODEL_BC3)
+        {
+            // BC3: 64 bit di alfa e poi 64 bit di colore; l'alfa resta lineare anche nei formati sRGB
+            samples.push_back({0, 64, KHR_DF_CHANNEL_ALPHA | (description.srgb ? KHR_DF_SAMPLE_DATATYPE_LINEAR : 0)});
+            samples.push_back({64, 64, KHR_DF_CHANNEL_COLOR});
+        }
+        else
+        {
+            samples.push_back({0, description.blockBytes * 8, KHR_DF_CHANNEL_COLOR});
+        }
+
+        uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+        std::vector<uint8_t> dfd(4 + blockSize, 0);
+        write32(dfd, 0, static_cast<uint32_t>(dfd.size()));
+        write32(dfd, 4, 0);                     // vendorId e descriptorType: blocco di base di Khronos
+        write32(dfd, 8, 2 | (blockSize << 16)); // versione 2 della specifica e dimensione del blocco
+        write32(dfd, 12, description.model | (KHR_DF_PRIMARIES_BT709 << 8) |
+                             ((description.srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16));
+        write32(dfd, 16, 3 | (3 << 8)); // blocchi di 4x4 pixel, salvati come dimensione meno 1
+        write32(dfd, 20, description.blockBytes);
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            size_t offset = 28 + 16 * i;
+            write32(dfd, offset, samples[i].bitOffset | ((samples[i].bitLength - 1) << 16) | (samples[i].channel << 24));
+            write32(dfd, offset + 4, 0);
+            write32(dfd, offset + 8, 0);
+            write32(dfd, offset + 12, UINT32_MAX);
+        }
+        return dfd;
+    }
+}
+
+bool readKtx2(const std::string &path, Ktx2Image &image)
+{
+    std::ifstream input(path, std::ios::binary);
+    if (!input)
+    {
+        return false;
+    }
+    std::vector<uint8_t> file((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    if (file.size() < KTX2_HEADER_SIZE || std::memcmp(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+    {
+        return rejectKtx2(path, "file KTX2 non valido");
+    }
+
+    image.format = static_cast<VkFormat>(read32(file, 12));
+    image.width = read32(file, 20);
+    image.height = read32(file, 24);
+    uint32_t depth = read32(file, 28);
+    uint32_t layerCount = read32(file, 32);
+    uint32_t faceCount = read32(file, 36);
+    uint32_t levelCount = std::max(1u, read32(file, 40)); // 0 vuol dire che le mipmap vanno generate, ma c'è comunque il livello 0
+    uint32_t supercompression = read32(file, 44);
+    if (depth != 0 || layerCount > 1 || faceCount != 1 || supercompression != 0 || image.width == 0 || image.height == 0)
+    {
+        return rejectKtx2(path, "immagine KTX2 non supportata (solo immagini 2D senza supercompressione)");
+    }
+    // le dimensioni dei livelli vengono controllate con quelle dei blocchi compressi, quindi il formato deve essere uno di quelli conosciuti
+    FormatDescription description;
+    if (!findFormat(image.format, description))
+    {
+        return rejectKtx2(path, "formato KTX2 non supportato");
+    }
+    if (levelCount > mipLevelCount(image.width, image.height))
+    {
+        return rejectKtx2(path, "troppi livelli di mipmap");
+    }
+    if (file.size() < KTX2_HEADER_SIZE + KTX2_LEVEL_INDEX_SIZE * levelCount)
+    {
+        return rejectKtx2(path, "file KTX2 troncato");
+    }
+
+    // nel file i livelli sono salvati dal più piccolo al più grande, noi li teniamo dal livello 0 in poi
+    image.levels.resize(levelCount);
+    image.data.clear();
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        size_t index = KTX2_HEADER_SIZE + KTX2_LEVEL_INDEX_SIZE * level;
+        uint64_t byteOffset = read64(file, index);
+        uint64_t byteLength = read64(file, index + 8);
+        if (byteOffset > file.size() || byteLength > file.size() - byteOffset)
+        {
+            return rejectKtx2(path, "livello fuori dal file");
+        }
+        // vkCmdCopyBufferToImage legge esattamente un blocco per ogni 4x4 pixel del livello, un livello più corto farebbe leggere oltre i suoi dati
+        uint32_t width = std::max(1u, image.width >> level), height = std::max(1u, image.height >> level);
+        uint64_t expectedLength = static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * description.blockBytes;
+        if (byteLength != expectedLength)
+        {
+            return rejectKtx2(path, "dimensione di un livello diversa da quella dei suoi blocchi");
+        }
+        image.levels[level] = {image.data.size(), static_cast<size_t>(byteLength), width, height};
+        image.data.insert(image.data.end(), file.begin() + byteOffset, file.begin() + byteOffset + byteLength);
+    }
+    return true;
+}
+
+void writeKtx2(const std::string &path, const Ktx2Image &image)
+{
+    FormatDescription description = describeFormat(image.format);
+    std::vector<uint8_t> dfd = buildDataFormatDescriptor(image.format);
+    uint32_t levelCount = static_cast<uint32_t>(image.levels.size());
+
+    size_t dfdOffset = KTX2_HEADER_SIZE + KTX2_LEVEL_INDEX_SIZE * levelCount;
+    std::vector<uint8_t> file(dfdOffset, 0);
+    std::memcpy(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    write32(file, 12, static_cast<uint32_t>(image.format));
+    write32(file, 16, 1); // typeSize: 1 per i formati compressi
+    write32(file, 20, image.width);
+    write32(file, 24, image.height);
+    write32(file, 28, 0); // pixelDepth: immagine 2D
+    write32(file, 32, 0); // layerCount: non è un array
+    write32(file, 36, 1); // faceCount: non è una cube map
+    write32(file, 40, levelCount);
+    write32(file, 44, 0); // nessuna supercompressione
+    write32(file, 48, static_cast<uint32_t>(dfdOffset));
+    write32(file, 52, static_cast<uint32_t>(dfd.size()));
+    // nessun dato chiave/valore e nessun dato globale di supercompressione: posizioni e dimensioni restano a 0
+    file.insert(file.end(), dfd.begin(), dfd.end());
+
+    // i livelli vanno dal più piccolo al più grande, ognuno allineato alla dimensione di un blocco
+    for (uint32_t level = levelCount; level-- > 0;)
+    {
+        file.resize((file.size() + description.blockBytes - 1) / description.blockBytes * description.blockBytes, 0);
+        const Ktx2Level &data = image.levels[level];
+        size_t index = KTX2_HEADER_SIZE + KTX2_LEVEL_INDEX_SIZE * level;
+        write64(file, index, file.size());
+        write64(file, index + 8, data.size);
+        write64(file, index + 16, data.size);
+        file.insert(file.end(), image.data.begin() + data.offset, image.data.begin() + data.offset + data.size);
+    }
+
+    std::ofstream output(path, std::ios::binary);
+    if (!output.write(reinterpret_cast<const char *>(file.data()), file.size()))
+    {
+        throw std::runtime_error("failed to write KTX2 file: " + path);
+    }
+}
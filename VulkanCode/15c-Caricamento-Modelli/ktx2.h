@@ -0,0 +1,56 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Un livello di mipmap di un'immagine KTX2.
+ */
+struct Ktx2Level
+{
+    size_t offset;   // posizione dei dati del livello in Ktx2Image::data
+    size_t size;     // dimensione dei dati del livello in byte
+    uint32_t width;  // larghezza del livello in pixel
+    uint32_t height; // altezza del livello in pixel
+};
+
+/**
+ * @brief Immagine 2D letta da un file KTX2, con tutti i suoi livelli di mipmap già nel formato della GPU.
+ */
+struct Ktx2Image
+{
+    VkFormat format;               // formato dei dati, per esempio VK_FORMAT_BC7_SRGB_BLOCK
+    uint32_t width;                // larghezza del livello 0
+    uint32_t height;               // altezza del livello 0
+    std::vector<Ktx2Level> levels; // livelli di mipmap, dal più grande al più piccolo
+    std::vector<uint8_t> data;     // dati di tutti i livelli, uno dopo l'altro a partire dal livello 0
+};
+
+/**
+ * @brief Legge un file KTX2 con un'immagine 2D.
+ *
+ * Sono supportate solo le immagini 2D senza array, cube map e supercompressione (Basis Universal, zstd):
+ * sono quelle scritte da writeKtx2 e dallo strumento texconvert.
+ *
+ * Un file non valido o non supportato (formato diverso da BC1/BC3/BC7, più livelli di quelli possibili,
+ * livelli troncati o con una dimensione diversa da quella dei loro blocchi) viene segnalato e rifiutato,
+ * così chi lo legge può decodificare l'immagine originale invece di copiare sulla GPU dati incompleti.
+ *
+ * @param path Il percorso del file.
+ * @param image L'immagine letta.
+ * @return false se il file non esiste o non può essere usato.
+ */
+bool readKtx2(const std::string &path, Ktx2Image &image);
+
+/**
+ * @brief Scrive un'immagine 2D in un file KTX2, con il descrittore del formato (DFD) richiesto dalla specifica.
+ *
+ * Il descrittore viene scritto solo per i formati BC1 RGB, BC3 e BC7, sRGB o lineari, gli unici prodotti da texconvert.
+ *
+ * @param path Il percorso del file.
+ * @param image L'immagine da scrivere.
+ * @throws std::runtime_error Se il formato non è supportato o il file non può essere scritto.
+ */
+void writeKtx2(const std::string &path, const Ktx2Image &image);
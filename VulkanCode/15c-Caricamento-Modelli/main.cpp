@@ -15,6 +15,16 @@
 #include "light.h"
 #include "texture.h"
 #include "mesh.h"
+#include "meshCache.h"
+#include "meshlet.h"
+#include "stagingRing.h"
+#include "uploadBatch.h"
+#include "deletionQueue.h"
+#include "samplerCache.h"
+#include "textureTable.h"
+#include "uniformRing.h"
+#include "objectBuffer.h"
+#include "commandRecorder.h"
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
@@ -30,12 +40,55 @@
 #include <map>
 #include <string>
 #include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <queue>
+#include <future>
+#include <memory>
+#include <filesystem>
 
 #ifdef NDEBUG
 const bool enableValidationLayers = true;
 #else
 const bool enableValidationLayers = true;
 #endif
+// lettore usato per importare i modelli: Assimp oppure il parser dedicato ai file .obj (più veloce, vedi objParser.h)
+const MeshImporter meshImporter = MeshImporter::Assimp;
+// ottimizzazioni applicate ai modelli dopo l'importazione (vedi meshOptimizer.h)
+// quella per l'overdraw cambia l'ordine dei triangoli, quindi anche il risultato della trasparenza dei capelli: per questo non la usiamo
+const unsigned int meshOptimizations = MeshOptimize_VertexCache | MeshOptimize_VertexFetch;
+// formato dei vertici sulla GPU (vedi vertexFormat.h): Packed16 usa 16 byte per vertice invece dei 32 di Vertex
+const VertexLayout vertexLayout = VertexLayout::Packed16;
+// livelli di dettaglio generati per ogni modello (vedi meshSimplifier.h), ognuno con circa la metà dei triangoli del precedente
+const unsigned int meshLodLevels = 4;
+// errore massimo sullo schermo, in pixel, con cui una mesh può passare a un livello di dettaglio più semplice
+const float lodMaxPixelError = 1.0f;
+// se la memoria device local è anche host visible (GPU integrate, lavapipe, resizable BAR) vertici, indici e buffer uniformi vengono scritti direttamente,
+// senza buffer di staging (vedi supportsDirectUploads); con false si usa sempre lo staging, per confrontare i due percorsi
+const bool directUploads = true;
+// i modelli non visibili vengono tolti dalla GPU quando si cambia modello e ricaricati (dalla cache) quando tornano visibili,
+// la distruzione avviene con la coda di distruzioni (vedi deletionQueue.h), quindi senza fermare la GPU; si può cambiare con il tasto U
+const bool unloadHiddenModels = true;
+// le texture vengono caricate dai file .ktx2 creati da texconvert (BC1/BC7 con le mipmap), se il dispositivo supporta i formati BC;
+// con false o senza supporto si usano le immagini originali in RGBA8
+const bool compressedTextures = true;
+// tutte le texture usano lo stesso sampler della cache (vedi samplerCache.h), che viene messo direttamente nel descriptor set layout come immutable sampler;
+// con false il sampler viene scritto nei descriptor set insieme a ogni texture
+const bool immutableSamplers = true;
+// le texture stanno in un'unica tabella aggiornata anche mentre è in uso (VK_EXT_descriptor_indexing), se il dispositivo lo supporta;
+// con false o senza supporto la tabella ha MAX_TEXTURES posti e una copia per ogni frame in volo
+const bool bindlessTextures = true;
+// i disegni di ogni frame vengono divisi in pezzi registrati in parallelo da più thread, in command buffer secondari (vedi commandRecorder.h);
+// con false vengono registrati tutti dal thread principale nel command buffer primario, per confrontare i tempi di registrazione
+const bool multithreadedRecording = true;
+// i command buffer secondari con i disegni vengono registrati una volta sola e riutilizzati finché non cambiano le mesh da disegnare, il loro livello di dettaglio,
+// la modalità wireframe o la swap chain: a ogni frame cambiano solo i dati nel buffer uniforme e nello storage buffer degli oggetti,
+// e il command buffer primario che li esegue; in questa modalità i meshlet non vengono scartati, perché la loro visibilità dipende dalla camera
+// (il tasto C non ha effetto e la percentuale scartata resta a 0), e ogni cambio di livello di dettaglio fa registrare di nuovo tutti i disegni;
+// per questo è disattivato di base, si può provare con il tasto P
+const bool cachedCommandBuffers = false;
 const std::vector<const char *> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 const std::vector<const char *> validationLayers = {
@@ -44,20 +97,32 @@ const uint32_t WIDTH = 1024;
 const uint32_t HEIGHT = 768;
 
 const uint32_t MAX_FRAMES_IN_FLIGHT = 2; // numero di frame in volo
-const uint32_t MAX_TEXTURES = 16;        // numero massimo di texture
+const uint32_t MAX_TEXTURES = 16;        // numero massimo di texture senza VK_EXT_descriptor_indexing
+// posti della tabella delle texture con VK_EXT_descriptor_indexing, limitati dal dispositivo (vedi textureTable.h)
+const uint32_t BINDLESS_TEXTURES = 4096;
+// oggetti che possono essere disegnati in un frame, ognuno ha il suo posto nello storage buffer degli oggetti (vedi objectBuffer.h);
+// ogni copia disegnata con l'instancing conta come un oggetto, quindi deve contenere la griglia di teiere
+const uint32_t MAX_OBJECTS_PER_FRAME = 16384;
+// lato della griglia di teiere della scena di prova per l'instancing (tasto I): 100 x 100 = 10000 copie disegnate con un solo comando
+const uint32_t TEAPOT_GRID_SIZE = 100;
+// numero massimo di thread che registrano i comandi, ne vengono usati al massimo quanti sono i core della CPU
+const uint32_t MAX_RECORDING_THREADS = 8;
+// dimensione del buffer di staging condiviso da tutti i caricamenti, deve contenere almeno la texture più grande
+// (2048x2048 RGBA = 16 MB, 21.3 MB con le mipmap generate sulla CPU)
+const VkDeviceSize STAGING_RING_SIZE = 32 * 1024 * 1024;
 auto previousTime = std::chrono::high_resolution_clock::now();
 
 /**
  * @brief Struttura per l'oggetto del buffer uniforme.
  *
- * Questo struct contiene tutti i dati che devono essere passati alla shader.
+ * Questo struct contiene i dati comuni a tutto il frame (camera e luci), scritti una volta sola per frame.
+ * I dati dei singoli oggetti (matrice del modello e delle normali) stanno invece nello storage buffer degli oggetti (vedi objectBuffer.h).
  * Ogni elemento della struttura deve essere allineato a 16 byte per garantire che Vulkan possa accedervi correttamente.
  */
 struct UniformBufferObject
 {
     struct alignas(16) SceneMatrices // struttura per le matrici di scena
     {
-        glm::mat4 model;
         glm::mat4 view;
         glm::mat4 proj;
     } sMatrices;
@@ -107,6 +172,9 @@ glm::mat4 userTransform = glm::mat4(1.0f); // matrice di trasformazione del cubo
 
 std::vector<uint32_t> meshToRender = {}; // vettore di indici delle mesh da renderizzare
 uint32_t meshCount = 0;                  // numero di mesh
+std::vector<MeshInstance> meshInstances = {}; // copie di ogni mesh da renderizzare con l'instancing, vuoto per disegnarne una sola
+std::vector<MeshInstance> teapotGrid = {};    // copie della griglia di teiere, preparate in createTeapotGrid
+uint64_t sceneVersion = 0;                    // cambia quando cambiano le mesh da disegnare o il modo di disegnarle, invalida i command buffer in cache
 
 /**
  * @brief Struttura per gli indici delle famiglie di code.
@@ -117,6 +185,8 @@ struct QueueFamilyIndices
 {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> transferFamily; // famiglia solo per i trasferimenti, se il dispositivo ne ha una
+
 
     bool isComplete()
     {
@@ -154,6 +224,14 @@ DiffusiveLight diffusive_light(0.7f); // intensità della luce diffusa
 SpecularLight specular_light(0.3f, 32.0f); // intensità e shininess della luce speculare
 
 bool wireframeMode = false; // modalità wireframe
+bool lodEnabled = true;     // se false le mesh vengono sempre disegnate al livello di dettaglio completo
+bool meshletCulling = true; // se false i meshlet vengono disegnati tutti, anche quelli non visibili
+bool modelUnloading = unloadHiddenModels;   // se true i modelli non visibili vengono tolti dalla GPU (vedi unloadHiddenModels), si cambia con il tasto U
+bool commandCaching = cachedCommandBuffers; // se true i disegni vengono registrati una volta e riutilizzati (vedi cachedCommandBuffers), si cambia con il tasto P
+size_t drawnTriangles = 0;  // triangoli disegnati nell'ultimo frame registrato
+size_t culledTriangles = 0; // triangoli scartati con i meshlet nell'ultimo frame registrato
+double recordingMs = 0.0;   // tempo di CPU speso a registrare i comandi, sommato fino alla prossima stampa delle statistiche
+uint32_t commandRecordings = 0; // frame in cui i disegni sono stati registrati di nuovo, fino alla prossima stampa delle statistiche
 class InformaticaGraficaApplication
 {
 public:
@@ -179,8 +257,15 @@ private:
 
     VkQueue graphicsQueue; // coda di rendering Vulkan
     VkQueue presentQueue;  // coda di presentazione Vulkan
-
-    VkSwapchainKHR swapChain;             // swap chain Vulkan
+    VkQueue transferQueue; // coda usata per caricare modelli e texture, la coda grafica se non ce n'è una dedicata
+    bool physicalDeviceProperties2Enabled = false; // true se l'istanza ha VK_KHR_get_physical_device_properties2
+    bool memoryBudgetEnabled = false;              // true se il dispositivo ha VK_EXT_memory_budget
+    bool textureCompressionEnabled = false;        // true se è attiva la feature textureCompressionBC e si usano le texture compresse
+    bool descriptorIndexingEnabled = false;        // true se è attiva VK_EXT_descriptor_indexing con le feature per la tabella delle texture
+    uint32_t bindlessTextureLimit = 0;             // posti massimi della tabella delle texture con descriptor indexing, secondo il dispositivo
+    bool nonUniformTextureIndexing = false;        // true se la fragment shader può scegliere una texture diversa per ogni copia di un disegno
+
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE; // swap chain Vulkan
     std::vector<VkImage> swapChainImages; // immagini della swap chain Vulkan
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
@@ -189,21 +274,36 @@ private:
     VkRenderPass renderPass;                                  // passaggio di rendering Vulkan
     VkDescriptorSetLayout descriptorSetLayout;                // layout del set di descrittori Vulkan
     VkDescriptorPool descriptorPool;                          // pool di descrittori Vulkan
-    std::vector<std::vector<VkDescriptorSet>> descriptorSets; // set di descrittori Vulkan
+    VkDescriptorSet uniformDescriptorSet;                     // set del buffer uniforme, lo stesso per tutti gli oggetti e i frame (cambia solo l'offset dinamico)
     VkPipelineLayout pipelineLayout;                          // layout della pipeline Vulkan
     std::vector<VkPipeline> noWirePipelines;                  // pipeline Vulkan per gli oggetti non wireframe
     std::vector<VkPipeline> wirePipelines;                    // pipeline Vulkan per gli oggetti wireframe
 
     std::vector<VkFramebuffer> swapChainFramebuffers;              // framebuffer della swap chain Vulkan
     VkCommandPool commandPool;                                     // pool di comandi Vulkan
+    VkCommandPool transferCommandPool;                             // pool di comandi della coda di trasferimento, uguale a commandPool se non c'è una coda dedicata
+    StagingRing *stagingRing = nullptr;                            // buffer di staging usato da tutti i caricamenti sulla GPU
+    UploadBatch *uploadBatch = nullptr;                            // raccoglie i caricamenti in un solo command buffer
     std::vector<VkCommandBuffer> commandBuffers;                   // buffer di comandi Vulkan
-    std::vector<std::vector<VkBuffer>> uniformBuffers;             // buffer uniformi Vulkan
-    std::vector<std::vector<VkDeviceMemory>> uniformBuffersMemory; // memoria dei buffer uniformi Vulkan
-    std::vector<std::vector<void *>> uniformBuffersMapped;         // puntatori ai buffer uniformi Vulkan
+    CommandRecorder *commandRecorder = nullptr;                    // thread che registrano i disegni in command buffer secondari
+
+    // cosa contengono i command buffer secondari di un frame in volo, per sapere se si possono riutilizzare (vedi cachedCommandBuffers)
+    struct CachedCommands
+    {
+        bool valid = false;
+        uint64_t version = 0;                       // sceneVersion al momento della registrazione
+        std::array<uint32_t, 2> dynamicOffsets{};   // offset dinamici del set 0
+        std::vector<std::array<uint32_t, 5>> draws; // mesh, trasparenza, primo oggetto, numero di copie e livello di dettaglio di ogni disegno
+        size_t drawnTriangles = 0;
+        size_t culledTriangles = 0;
+    };
+    std::array<CachedCommands, MAX_FRAMES_IN_FLIGHT> commandCache;
+    UniformRing *uniformRing = nullptr;                            // buffer uniforme con i dati comuni di ogni frame in volo
+    ObjectBuffer *objectBuffer = nullptr;                          // storage buffer con i dati di ogni oggetto disegnato in ogni frame
 
     // depth image
     VkImage depthImage;
-    VkDeviceMemory depthImageMemory;
+    DeviceAllocation depthImageMemory;
     VkImageView depthImageView;
 
     // sto usando dei vettori in caso ci siano dei frame aggiuntivi, ma essendo che non ci sono, si puà usare anche un solo elemento
@@ -212,9 +312,30 @@ private:
     std::vector<VkSemaphore> renderFinishedSemaphores;
     std::vector<VkFence> inFlightFences;
 
+    // ogni frame inviato ha un numero crescente, le risorse non più usate vengono distrutte quando il frame con quel numero è finito
+    DeletionQueue deletionQueue;
+    uint64_t submittedFrames = 0;                              // numero dell'ultimo frame inviato
+    uint64_t completedFrames = 0;                              // numero dell'ultimo frame finito dalla GPU
+    uint64_t inFlightFrameNumbers[MAX_FRAMES_IN_FLIGHT] = {}; // numero del frame che segnala ogni fence
+
     // risorse per le texture
     std::map<std::string, Texture *> textures; // mappa delle texture
-    std::vector<Mesh *> meshes;                // vettore di puntatori a mesh
+    SamplerCache *samplerCache = nullptr;      // sampler condivisi da tutte le texture
+    TextureTable *textureTable = nullptr;      // descriptor set con tutte le texture, ogni texture ha un posto fisso
+    std::vector<Mesh *> meshes;                // vettore di puntatori a mesh, nullptr se il modello non è sulla GPU
+
+    // modello da caricare, con i flag di Assimp e la texture da usare
+    struct ModelToLoad
+    {
+        const char *path;
+        unsigned int flags;
+        const char *texture;
+        bool meshlets;
+    };
+    std::vector<ModelToLoad> models;                                        // modelli della scena, uno per ogni posto di meshes
+    std::vector<uint64_t> meshUploads;                                      // invio di UploadBatch con i buffer di ogni mesh, si disegna solo quando è pronto
+    std::map<size_t, std::future<std::unique_ptr<MeshData>>> pendingMeshLoads; // modelli tornati visibili che i thread stanno ricaricando
+    std::unordered_set<size_t> failedMeshLoads;                                // modelli che non si sono ricaricati, non vengono più riprovati
 
     uint32_t currentFrame = 0; // frame corrente
 
@@ -301,8 +422,33 @@ private:
             case GLFW_KEY_B:
             case GLFW_KEY_F:
             case GLFW_KEY_M:
+            case GLFW_KEY_I:
                 modelSwitcher(key);
                 break;
+            case GLFW_KEY_L:
+                // attiva o disattiva i livelli di dettaglio, per confrontare triangoli e frame time
+                lodEnabled = !lodEnabled;
+                std::cout << "livelli di dettaglio " << (lodEnabled ? "attivi" : "disattivati") << std::endl;
+                break;
+            case GLFW_KEY_C:
+                // attiva o disattiva lo scarto dei meshlet non visibili
+                meshletCulling = !meshletCulling;
+                std::cout << "culling dei meshlet " << (meshletCulling ? "attivo" : "disattivato") << std::endl;
+                break;
+            case GLFW_KEY_U:
+                // attiva o disattiva lo scaricamento dei modelli non visibili, quelli già scaricati vengono ricaricati quando tornano visibili
+                modelUnloading = !modelUnloading;
+                std::cout << "scaricamento dei modelli non visibili " << (modelUnloading ? "attivo" : "disattivato") << std::endl;
+                break;
+            case GLFW_KEY_P:
+                // passa dai command buffer in cache a quelli registrati a ogni frame, per confrontare i tempi di registrazione
+                commandCaching = !commandCaching;
+                sceneVersion++; // nel frattempo i command buffer secondari dei frame vengono riscritti, quindi la cache non vale più
+                std::cout << "command buffer " << (commandCaching ? "in cache, meshlet non scartati" : "registrati a ogni frame") << std::endl;
+                break;
+            case GLFW_KEY_R:
+                printMemoryReport();
+                break;
             case GLFW_KEY_Z:
                 // cambia la modalità di rendering
                 if (wireframeMode)
@@ -313,6 +459,7 @@ private:
                 {
                     wireframeMode = true;
                 }
+                sceneVersion++; // la pipeline è registrata nei command buffer in cache
                 break;
             default:
                 break;
@@ -487,6 +634,22 @@ private:
         }
     }
 
+    /**
+     * @brief metodo per stampare l'uso della memoria del dispositivo
+     *
+     * Stampa la memoria usata da mesh, texture, buffer uniformi, attachment e staging, con uso e budget di ogni heap,
+     * e scrive gli stessi dati in memoryReport.json per confrontare scene diverse.
+     *
+     * @return non ritorna nulla
+     */
+    static void printMemoryReport()
+    {
+        getDeviceAllocator()->printMemoryReport(std::cout);
+        std::ofstream file("memoryReport.json");
+        getDeviceAllocator()->writeMemoryReport(file);
+        std::cout << "report della memoria scritto in memoryReport.json" << std::endl;
+    }
+
     /**
      * @brief metodo per cambiare il modello da visualizzare
      * @param key il tasto premuto
@@ -496,6 +659,8 @@ private:
     {
         meshToRender.clear(); // svuotiamo il vettore delle mesh da renderizzare
         meshCount = 0;        // resettiamo il contatore delle mesh
+        meshInstances.clear(); // solo la scena della griglia di teiere usa l'instancing
+        sceneVersion++;
         float k =  0.08f; // variabile per calcolare la velocità della camera
         switch (key)
         {
@@ -548,6 +713,15 @@ private:
             meshToRender = {5, 6, 7, 8, 9, 10, 11};
             meshCount = 7;
             break;
+        case GLFW_KEY_I:
+            // scena di prova per l'instancing: la griglia di teiere, tutte disegnate con un solo comando di disegno
+            cameraControls(GLFW_KEY_SPACE);
+            baseTransform = glm::translate(glm::mat4(), glm::vec3(0.0f, -4.0f, -10.0f));
+            camera.speed = k * glm::length(glm::vec3(0.0f, -4.0f, -10.0f) - camera.pos);
+            meshToRender = {0};
+            meshCount = 1;
+            meshInstances = teapotGrid;
+            break;
         }
     }
 
@@ -557,25 +731,45 @@ private:
      */
     void initVulkan()
     {
+        // il tempo di avvio dipende soprattutto dal caricamento di modelli e texture, lo stampiamo insieme al numero di invii alla coda
+        auto initStart = std::chrono::high_resolution_clock::now();
         createInstance();
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
+        // con VK_EXT_memory_budget l'allocatore legge dal driver uso e budget di ogni heap (vedi memoryBudget.h)
+        createDeviceAllocator(device, physicalDevice,
+                              memoryBudgetEnabled ? reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR")) : nullptr);
+        // i sampler servono già al descriptor set layout, come immutable sampler
+        samplerCache = new SamplerCache(device, physicalDevice);
         createSwapChain();
         createImageViews();
         createRenderPass();
         createDescriptorSetLayout();
         createGraphicsPipeline();
         createCommandPool();
+        createUploadResources();
         createDepthResources();
         createFramebuffers();
         initializeTextures();
         initializeMeshes();
+        loadMaterialTextures();
+        createTeapotGrid();
+        printTextureMemory();
+        // tutti i caricamenti di texture e modelli partono qui con un solo invio, senza aspettarli: i draw inviati dopo sulla coda grafica li vedono già completati
+        // con la coda di trasferimento dedicata è la coda grafica ad aspettare la fine delle copie, non la CPU
+        uploadBatch->acquire(uploadBatch->submit());
         createUniformBuffers();
         createDescriptorPool();
         createDescriptorSets();
         createCommandBuffers();
         createSyncObjects();
+        std::cout << "avvio completato in " << std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - initStart).count()
+                  << " ms, " << uploadBatch->getSubmitCount() << " invii di caricamenti alla coda, "
+                  << getDeviceAllocator()->getDeviceAllocationCount() << " allocazioni di memoria del dispositivo" << std::endl;
+        std::cout << "picco del buffer di staging " << stagingRing->getPeakUsedBytes() / 1024.0 / 1024.0
+                  << " MB, picco della memoria del dispositivo " << getDeviceAllocator()->getPeakAllocatedBytes() / 1024.0 / 1024.0 << " MB" << std::endl;
+        getDeviceAllocator()->printMemoryReport(std::cout);
     }
 
     /**
@@ -587,11 +781,42 @@ private:
      */
     void mainLoop()
     {
-
+        // ogni 2 secondi stampiamo il tempo medio di un frame, per confrontare i formati dei vertici e le altre ottimizzazioni
+        auto statsStart = std::chrono::high_resolution_clock::now();
+        uint32_t statsFrames = 0;
         while (!glfwWindowShouldClose(window))
         {
             glfwPollEvents();
             drawFrame();
+
+            statsFrames++;
+            float statsSeconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - statsStart).count();
+            if (statsSeconds >= 2.0f)
+            {
+                // con la distanza della camera dal modello si possono confrontare triangoli e frame time a distanze diverse
+                size_t submittedTriangles = drawnTriangles + culledTriangles;
+                std::cout << "frame time medio: " << statsSeconds * 1000.0f / statsFrames << " ms (" << statsFrames / statsSeconds << " fps), "
+                          << drawnTriangles << " triangoli (" << (submittedTriangles > 0 ? 100.0f * culledTriangles / submittedTriangles : 0.0f)
+                          << "% scartati con i meshlet), distanza " << glm::length(glm::vec3(baseTransform[3]) - camera.pos) << std::endl;
+                std::cout << "oggetti: al massimo " << objectBuffer->getPeakObjectCount() << " in un frame su " << MAX_OBJECTS_PER_FRAME
+                          << ", registrazione dei comandi: " << recordingMs / statsFrames << " ms di CPU per frame, disegni registrati in "
+                          << commandRecordings << " frame su " << statsFrames << std::endl;
+                if (commandRecorder != nullptr)
+                {
+                    // con i thread bilanciati il tempo del thread principale si avvicina a quello di un solo thread
+                    std::cout << "tempo di registrazione per thread:";
+                    for (double threadMs : commandRecorder->getThreadMs())
+                    {
+                        std::cout << " " << threadMs / statsFrames << " ms";
+                    }
+                    std::cout << std::endl;
+                    commandRecorder->resetTimings();
+                }
+                statsStart = std::chrono::high_resolution_clock::now();
+                recordingMs = 0.0;
+                commandRecordings = 0;
+                statsFrames = 0;
+            }
         }
         // aspettiamo che il dispositivo sia idle prima di chiudere l'applicazione
         vkDeviceWaitIdle(device);
@@ -606,6 +831,9 @@ private:
      */
     void cleanup()
     {
+        // il dispositivo è inattivo, quindi possiamo distruggere subito le risorse in coda e aspettare i modelli in caricamento
+        pendingMeshLoads.clear();
+        deletionQueue.flush();
         cleanupSwapChain();
 
         // distruggiamo le mesh
@@ -625,16 +853,30 @@ private:
         vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 
         vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        delete textureTable;
+        textureTable = nullptr;
+        // i sampler vanno distrutti dopo le texture e il layout che li usano
+        delete samplerCache;
+        samplerCache = nullptr;
+
+        delete uniformRing;
+        uniformRing = nullptr;
+        delete objectBuffer;
+        objectBuffer = nullptr;
 
-        for (size_t i = 0; i < uniformBuffers.size(); i++)
+        delete commandRecorder;
+        commandRecorder = nullptr;
+
+        // il buffer di staging libera i command buffer dei caricamenti, quindi va distrutto prima del command pool
+        delete uploadBatch;
+        uploadBatch = nullptr;
+        delete stagingRing;
+        stagingRing = nullptr;
+
+        if (transferCommandPool != commandPool)
         {
-            for (size_t j = 0; j < uniformBuffers[i].size(); j++)
-            {
-                vkDestroyBuffer(device, uniformBuffers[i][j], nullptr);
-                vkFreeMemory(device, uniformBuffersMemory[i][j], nullptr);
-            }
+            vkDestroyCommandPool(device, transferCommandPool, nullptr);
         }
-
         vkDestroyCommandPool(device, commandPool, nullptr);
 
         vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
@@ -652,6 +894,9 @@ private:
             vkDestroyFence(device, inFlightFences[i], nullptr);
         }
 
+        // tutti i buffer e le immagini sono stati distrutti, quindi i blocchi di memoria sono vuoti
+        destroyDeviceAllocator();
+
         vkDestroyDevice(device, nullptr);
 
         vkDestroySurfaceKHR(instance, surface, nullptr);
@@ -687,9 +932,25 @@ private:
         uint32_t glfwExtensionCount = 0;
         const char **glfwExtensions;
         glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        std::vector<const char *> instanceExtensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+
+        // con Vulkan 1.0 per leggere il budget della memoria (VK_EXT_memory_budget) serve vkGetPhysicalDeviceMemoryProperties2KHR,
+        // che fa parte di questa estensione: la attiviamo solo se c'è, il budget è facoltativo
+        uint32_t availableCount = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(availableCount);
+        vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, availableExtensions.data());
+        for (const auto &extension : availableExtensions)
+        {
+            if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+            {
+                instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+                physicalDeviceProperties2Enabled = true;
+            }
+        }
 
-        createInfo.enabledExtensionCount = glfwExtensionCount;
-        createInfo.ppEnabledExtensionNames = glfwExtensions;
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(instanceExtensions.size());
+        createInfo.ppEnabledExtensionNames = instanceExtensions.data();
 
         createInfo.enabledLayerCount = 0;
 
@@ -817,24 +1078,30 @@ private:
         std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
         vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
+        // guardiamo tutte le famiglie, perché quella di trasferimento di solito viene dopo quella grafica
         int i = 0;
         for (const auto &queueFamily : queueFamilies)
         {
             // ora che useremo anche il transferimento di memoria, ci serve anche il VKQUEUE_TRANSFER_BIT
             // per fortuna, il VKQUEUE_GRAPHICS_BIT include anche il VKQUEUE_TRANSFER_BIT, quindi non ci serve fare altro
-            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.has_value())
             {
                 indices.graphicsFamily = i;
             }
 
-            if (indices.isComplete())
+            // una famiglia senza grafica che può copiare lavora in parallelo al rendering (sulle GPU dedicate è il motore DMA)
+            // preferiamo quella senza compute, che è la più specializzata
+            if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
             {
-                break;
+                if (!indices.transferFamily.has_value() || !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
+                {
+                    indices.transferFamily = i;
+                }
             }
 
             VkBool32 presentSupport = false;
             vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-            if (presentSupport)
+            if (presentSupport && !indices.presentFamily.has_value())
             {
                 indices.presentFamily = i;
             }
@@ -858,6 +1125,10 @@ private:
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+        if (indices.transferFamily.has_value())
+        {
+            uniqueQueueFamilies.insert(indices.transferFamily.value());
+        }
 
         // Vulkan usa come valore di priorità un numero tra 0 e 1, possiamo usare un float per rappresentare il valore di priorità.
         // Più il valore è alto, più la priorità è alta.
@@ -876,6 +1147,13 @@ private:
         // Per ora non ci serve nulla di particolare, quindi lo lasciamo vuoto.
         VkPhysicalDeviceFeatures deviceFeatures{};
         deviceFeatures.samplerAnisotropy = VK_TRUE; // ci serve essendo che abbiamo aggiunto l'asintropic filtering
+        // i formati BC sono supportati da quasi tutte le GPU desktop, sui dispositivi mobili di solito no: in quel caso le texture restano in RGBA8
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        textureCompressionEnabled = compressedTextures && supportedFeatures.textureCompressionBC;
+        deviceFeatures.textureCompressionBC = textureCompressionEnabled ? VK_TRUE : VK_FALSE;
+        // la fragment shader sceglie la texture con un indice passato come push constant
+        deviceFeatures.shaderSampledImageArrayDynamicIndexing = supportedFeatures.shaderSampledImageArrayDynamicIndexing;
 
         // Ora con questi struct possiamo finalmente creare il dispositivo logico.
         VkDeviceCreateInfo createInfo{};
@@ -890,8 +1168,41 @@ private:
 
         // Anche se inutile perché ora non è più necessario farlo, essendo che dalle recenti implementazioni Vulkan esse vengono ignorate,
         // possiamo specificare le estensioni che vogliamo usare.
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        // Oltre a quelle obbligatorie attiviamo VK_EXT_memory_budget se il dispositivo la supporta, per conoscere il budget di ogni heap.
+        // Con VK_EXT_descriptor_indexing (e VK_KHR_maintenance3, che richiede) le texture stanno in un'unica tabella bindless (vedi textureTable.h).
+        std::vector<const char *> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+        indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        if (physicalDeviceProperties2Enabled)
+        {
+            uint32_t extensionCount;
+            vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+            std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+            vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+            bool descriptorIndexingAvailable = false, maintenance3Available = false;
+            for (const auto &extension : availableExtensions)
+            {
+                if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+                {
+                    enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+                    memoryBudgetEnabled = true;
+                }
+                descriptorIndexingAvailable |= strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0;
+                maintenance3Available |= strcmp(extension.extensionName, VK_KHR_MAINTENANCE3_EXTENSION_NAME) == 0;
+            }
+            if (bindlessTextures && descriptorIndexingAvailable && maintenance3Available)
+            {
+                enableDescriptorIndexing(indexingFeatures);
+                if (descriptorIndexingEnabled)
+                {
+                    enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+                    enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+                    createInfo.pNext = &indexingFeatures;
+                }
+            }
+        }
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         if (enableValidationLayers)
         {
@@ -913,6 +1224,76 @@ private:
         vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
         // E la coda di presentazione (presentQueue) che ci serve per presentare il disegno.
         vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+        // E la coda per i caricamenti, che se non c'è una famiglia dedicata è la stessa coda di rendering.
+        if (indices.transferFamily.has_value())
+        {
+            vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+            std::cout << "caricamenti sulla coda di trasferimento dedicata (famiglia " << indices.transferFamily.value() << ")" << std::endl;
+        }
+        else
+        {
+            transferQueue = graphicsQueue;
+            std::cout << "nessuna coda di trasferimento dedicata, caricamenti sulla coda grafica" << std::endl;
+        }
+    }
+
+    /**
+     * @brief metodo per scegliere le feature di VK_EXT_descriptor_indexing usate dalla tabella delle texture
+     *
+     * Servono i posti vuoti (partially bound) e gli aggiornamenti dei posti non usati mentre il set è in uso (update after bind, update unused while pending).
+     * Legge anche dal dispositivo quanti posti può avere la tabella.
+     * Se c'è anche shaderSampledImageArrayNonUniformIndexing lo attiva, così ogni copia di un disegno può avere la sua texture (vedi createTeapotGrid);
+     * senza, la fragment shader usa solo la texture della push constant.
+     *
+     * @param indexingFeatures Le feature da attivare, da collegare al VkDeviceCreateInfo se descriptorIndexingEnabled diventa true.
+     * @return non ritorna nulla
+     */
+    void enableDescriptorIndexing(VkPhysicalDeviceDescriptorIndexingFeaturesEXT &indexingFeatures)
+    {
+        auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR"));
+        auto getProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR"));
+        if (getFeatures2 == nullptr || getProperties2 == nullptr)
+        {
+            return;
+        }
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported{};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        VkPhysicalDeviceFeatures2KHR features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features2.pNext = &supported;
+        getFeatures2(physicalDevice, &features2);
+        if (!supported.descriptorBindingPartiallyBound || !supported.descriptorBindingSampledImageUpdateAfterBind ||
+            !supported.descriptorBindingUpdateUnusedWhilePending)
+        {
+            return;
+        }
+
+        // con update after bind i limiti sono diversi da quelli normali, e i combined image sampler contano sia come sampler che come immagini
+        VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties{};
+        indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+        VkPhysicalDeviceProperties2KHR properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+        properties2.pNext = &indexingProperties;
+        getProperties2(physicalDevice, &properties2);
+        bindlessTextureLimit = std::min({BINDLESS_TEXTURES,
+                                         indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+                                         indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                         indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+                                         indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages});
+        if (bindlessTextureLimit <= MAX_TEXTURES)
+        {
+            return; // la tabella non sarebbe più grande di quella normale
+        }
+
+        indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        descriptorIndexingEnabled = true;
+        if (supported.shaderSampledImageArrayNonUniformIndexing)
+        {
+            indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            nonUniformTextureIndexing = true;
+        }
     }
 
     /**
@@ -1146,8 +1527,8 @@ private:
         createInfo.clipped = VK_TRUE;
 
         // questo serve in caso serva ricreare la swap chain, per esempio se la finestra viene ridimensionata
-        //  in questo caso, non ci interessa, quindi lo lasciamo a VK_NULL_HANDLE
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        //  alla prima creazione è VK_NULL_HANDLE, poi è la swap chain che viene sostituita (distrutta più tardi da recreateSwapChain)
+        createInfo.oldSwapchain = swapChain;
 
         // ora che abbiamo settato tutti i parametri, possiamo finalmente creare la swap chain
         if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS)
@@ -1178,8 +1559,7 @@ private:
     void cleanupSwapChain()
     {
         vkDestroyImageView(device, depthImageView, nullptr);
-        vkDestroyImage(device, depthImage, nullptr);
-        vkFreeMemory(device, depthImageMemory, nullptr);
+        destroyImage(device, depthImage, depthImageMemory);
 
         for (auto framebuffer : swapChainFramebuffers)
         {
@@ -1214,14 +1594,28 @@ private:
             glfwWaitEvents();
         }
 
-        vkDeviceWaitIdle(device);
-
-        cleanupSwapChain();
+        // invece di aspettare che la GPU sia inattiva, le risorse della vecchia swap chain vanno nella coda di distruzioni:
+        // la nuova swap chain viene creata a partire dalla vecchia (oldSwapchain), che resta valida finché i frame in volo non sono finiti
+        deletionQueue.push(submittedFrames + 1, [device = device, depthImageView = depthImageView, depthImage = depthImage, depthImageMemory = depthImageMemory,
+                                                 framebuffers = swapChainFramebuffers, imageViews = swapChainImageViews, oldSwapChain = swapChain]()
+                           {
+            vkDestroyImageView(device, depthImageView, nullptr);
+            destroyImage(device, depthImage, depthImageMemory);
+            for (auto framebuffer : framebuffers)
+            {
+                vkDestroyFramebuffer(device, framebuffer, nullptr);
+            }
+            for (auto imageView : imageViews)
+            {
+                vkDestroyImageView(device, imageView, nullptr);
+            }
+            vkDestroySwapchainKHR(device, oldSwapChain, nullptr); });
 
         createSwapChain();
         createImageViews();
         createDepthResources(); // prima di ricreare i framebuffer, dobbiamo ricreare le depth resources
         createFramebuffers();
+        sceneVersion++; // viewport e scissor registrati nei command buffer in cache hanno la dimensione della vecchia swap chain
     }
 
     /**
@@ -1238,7 +1632,7 @@ private:
 
         for (size_t i = 0; i < swapChainImages.size(); i++)
         {
-            swapChainImageViews[i] = createImageView(device, swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+            swapChainImageViews[i] = createImageView(device, swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
         }
     }
 
@@ -1260,7 +1654,8 @@ private:
         {
             throw std::runtime_error("failed to create shader module!");
         }
-        shaderClass.enable();
+        // senza l'indicizzazione non uniforme la shader normale non è valida, usiamo la variante con la sola texture della push constant
+        shaderClass.enable(nonUniformTextureIndexing ? "" : "uniform");
 
         VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
         vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -1269,11 +1664,37 @@ private:
         vertShaderStageInfo.module = shaderClass.getVertShaderModule();
         vertShaderStageInfo.pName = "main";
 
+        // la vertex shader decodifica le normali ottaedriche solo con i formati compressi
+        // usiamo una specialization constant così il confronto viene risolto alla creazione della pipeline e non per ogni vertice
+        VkBool32 packedNormals = vertexLayout != VertexLayout::Full ? VK_TRUE : VK_FALSE;
+        VkSpecializationMapEntry specializationEntry{};
+        specializationEntry.constantID = 0;
+        specializationEntry.offset = 0;
+        specializationEntry.size = sizeof(VkBool32);
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = 1;
+        specializationInfo.pMapEntries = &specializationEntry;
+        specializationInfo.dataSize = sizeof(VkBool32);
+        specializationInfo.pData = &packedNormals;
+        vertShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
         VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
         fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
         fragShaderStageInfo.module = shaderClass.getFragShaderModule();
         fragShaderStageInfo.pName = "main";
+        // l'array di texture della fragment shader deve avere la stessa dimensione della tabella
+        uint32_t textureTableSize = textureTable->getCapacity();
+        VkSpecializationMapEntry fragSpecializationEntry{};
+        fragSpecializationEntry.constantID = 1;
+        fragSpecializationEntry.offset = 0;
+        fragSpecializationEntry.size = sizeof(uint32_t);
+        VkSpecializationInfo fragSpecializationInfo{};
+        fragSpecializationInfo.mapEntryCount = 1;
+        fragSpecializationInfo.pMapEntries = &fragSpecializationEntry;
+        fragSpecializationInfo.dataSize = sizeof(uint32_t);
+        fragSpecializationInfo.pData = &textureTableSize;
+        fragShaderStageInfo.pSpecializationInfo = &fragSpecializationInfo;
 
         VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
@@ -1289,8 +1710,9 @@ private:
         // dynamicState.pDynamicStates = dynamicStates.data();
 
         // questo struct specifica il formato in cui vengono inseriti i vertex, a differenza dello scorso progetto, usiamo un buffer
-        auto bindingDescription = Vertex::getBindingDescription();
-        auto attributeDescriptions = Vertex::getAttributeDescriptions();
+        // il formato dipende da vertexLayout, deve essere lo stesso usato per caricare le mesh
+        auto bindingDescription = getVertexBindingDescription(vertexLayout);
+        auto attributeDescriptions = getVertexAttributeDescriptions(vertexLayout);
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
         vertexInputInfo.vertexBindingDescriptionCount = 1;
@@ -1393,17 +1815,24 @@ private:
         // questo struct specifica lo stato della pipeline, cioè il processo di creazione della pipeline
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 1;                 // abbiamo solo 1 descriptor set layout, quindi 1
-        pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout; // il layout dei descriptor set, che abbiamo creato prima
+        // set 0: il blocco uniforme dinamico del frame (binding 0) e lo storage buffer degli oggetti (binding 1),
+        // set 1: la tabella delle texture, collegata una volta sola per command buffer
+        std::array<VkDescriptorSetLayout, 2> setLayouts = {descriptorSetLayout, textureTable->getLayout()};
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = setLayouts.data(); // i layout dei descriptor set, che abbiamo creato prima
 
         // questo struct specifica il range dei push constant, che sono dei dati che possiamo passare alla pipeline
-        VkPushConstantRange pushConstantRange{};
-        pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-        pushConstantRange.offset = 0;
-        pushConstantRange.size = sizeof(uint32_t);
-
-        pipelineLayoutInfo.pushConstantRangeCount = 1;
-        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        // il primo range è l'indice della texture per la fragment shader, il secondo sono scala e offset dei vertici compressi per la vertex shader
+        std::array<VkPushConstantRange, 2> pushConstantRanges{};
+        pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        pushConstantRanges[0].offset = 0;
+        pushConstantRanges[0].size = sizeof(uint32_t);
+        pushConstantRanges[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushConstantRanges[1].offset = VERTEX_PUSH_CONSTANT_OFFSET;
+        pushConstantRanges[1].size = sizeof(VertexQuantization);
+
+        pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+        pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
         // ora che abbiamo settato tutti i parametri, possiamo finalmente creare la pipeline layout
         if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
         {
@@ -1471,21 +1900,22 @@ private:
     {
         VkDescriptorSetLayoutBinding uboLayoutBinding{};
         uboLayoutBinding.binding = 0;
-        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        // con l'offset dinamico ogni frame sceglie il suo blocco del buffer uniforme senza cambiare descriptor set
+        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         uboLayoutBinding.descriptorCount = 1;
-        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        // la vertex shader legge le matrici di vista e proiezione, la fragment shader le luci e la posizione della camera
+        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
         uboLayoutBinding.pImmutableSamplers = nullptr; // Opzionale, è per lo più usato per le texture
 
-        // questo struct specifica il binding della texture array
-        VkDescriptorSetLayoutBinding textureArrayBinding{};
-        textureArrayBinding.binding = 1;
-        textureArrayBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        textureArrayBinding.descriptorCount = MAX_TEXTURES;
-        textureArrayBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-        textureArrayBinding.pImmutableSamplers = nullptr;
+        // array dei dati degli oggetti, letto solo dalla vertex shader con gl_InstanceIndex
+        VkDescriptorSetLayoutBinding objectLayoutBinding{};
+        objectLayoutBinding.binding = 1;
+        objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        objectLayoutBinding.descriptorCount = 1;
+        objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-        std::array<VkDescriptorSetLayoutBinding, 2> bindings = {
-            uboLayoutBinding, textureArrayBinding};
+        // le texture non stanno più nel set di ogni mesh ma nella tabella globale, che è il set 1 del pipeline layout
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, objectLayoutBinding};
         VkDescriptorSetLayoutCreateInfo layoutInfo{};
         layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
@@ -1495,6 +1925,14 @@ private:
         {
             throw std::runtime_error("failed to create descriptor set layout!");
         }
+
+        // tutte le texture usano lo stesso sampler della cache, che può stare nel layout della tabella come immutable sampler
+        uint32_t textureCapacity = descriptorIndexingEnabled ? bindlessTextureLimit : MAX_TEXTURES;
+        textureTable = new TextureTable(device, textureCapacity, MAX_FRAMES_IN_FLIGHT, descriptorIndexingEnabled,
+                                        immutableSamplers ? samplerCache->get(samplerCache->textureState()) : VK_NULL_HANDLE);
+        std::cout << "tabella delle texture con " << textureCapacity << " posti"
+                  << (descriptorIndexingEnabled ? " (bindless, VK_EXT_descriptor_indexing)" : ", una copia per frame in volo")
+                  << (nonUniformTextureIndexing ? ", texture diversa per ogni copia" : ", una texture per disegno") << std::endl;
     }
 
     /**
@@ -1655,6 +2093,38 @@ private:
         {
             throw std::runtime_error("failed to create command pool!");
         }
+
+        // i command buffer possono essere inviati solo a code della famiglia del loro pool, quindi la coda di trasferimento ha il suo
+        transferCommandPool = commandPool;
+        if (queueFamilyIndices.transferFamily.has_value())
+        {
+            // i command buffer dei caricamenti vengono usati una volta sola e poi liberati
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily.value();
+            if (vkCreateCommandPool(device, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create transfer command pool!");
+            }
+        }
+    }
+
+    /**
+     * @brief metodo per creare il buffer di staging e il batch dei caricamenti
+     *
+     * Crea il buffer di staging circolare da cui passano tutte le copie di vertici, indici e texture (vedi stagingRing.h)
+     * e il batch che le registra in un solo command buffer (vedi uploadBatch.h).
+     * Deve essere chiamato dopo la creazione del command pool e prima di caricare texture e modelli.
+     *
+     * @return non ritorna nulla
+     */
+    void createUploadResources()
+    {
+        stagingRing = new StagingRing(device, physicalDevice, STAGING_RING_SIZE);
+        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        bool direct = directUploads && supportsDirectUploads(physicalDevice);
+        std::cout << "caricamento dei buffer " << (direct ? "diretto nella memoria device local" : "con il buffer di staging") << std::endl;
+        uploadBatch = new UploadBatch(device, physicalDevice, direct, transferCommandPool, transferQueue, indices.transferFamily.value_or(indices.graphicsFamily.value()),
+                                      commandPool, graphicsQueue, indices.graphicsFamily.value(), stagingRing);
     }
 
     /**
@@ -1681,6 +2151,13 @@ private:
         {
             throw std::runtime_error("failed to allocate command buffers!");
         }
+
+        // i command buffer secondari vengono eseguiti dal primario, quindi usano la stessa famiglia di code
+        // il recorder serve sempre, perché la cache si può attivare con il tasto P: i comandi in cache sono sempre in command buffer secondari,
+        // senza multithreadedRecording registrati da un solo thread
+        uint32_t threadCount = multithreadedRecording ? std::clamp(std::thread::hardware_concurrency(), 1u, MAX_RECORDING_THREADS) : 1;
+        commandRecorder = new CommandRecorder(device, findQueueFamilies(physicalDevice).graphicsFamily.value(), threadCount, MAX_FRAMES_IN_FLIGHT);
+        std::cout << "registrazione dei comandi su " << threadCount << " thread" << std::endl;
     }
 
     /**
@@ -1698,6 +2175,7 @@ private:
      */
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
     {
+        auto recordingStart = std::chrono::high_resolution_clock::now();
         // come ogni cosa in vulkan, usiamo uno struct per specificare i parametri
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -1742,28 +2220,39 @@ private:
         // il terzo può essere uno dei seguenti valori:
         // VK_SUBPASS_CONTENTS_INLINE: il render pass viene eseguito inline, cioè il buffer di comandi viene eseguito direttamente e non ci sono buffer di comandi secondari
         // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS: il render pass viene eseguito in un buffer di comandi secondario
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        // ora possiamo collegare la pipeline grafica al buffer di comandi
-        // spostato nel ciclo di draw perché ora abbiamo più pipeline una per le mesh trasparenti e una per quelle opache
-        // vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-
-        // ora dobbiamo specificare la viewport, cioè la parte della finestra in cui vogliamo disegnare
-        // ricordiamo che dobbiamo ribaltare le coordinate Y, quindi l'altezza sarà negativa
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = static_cast<float>(swapChainExtent.height); // Sposta l'origine Y in basso per compensare l'inversione
-        viewport.width = static_cast<float>(swapChainExtent.width);
-        viewport.height = -static_cast<float>(swapChainExtent.height); // Altezza negativa per ribaltare l'asse Y
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-        // e anche la scissor, cioè la parte della finestra in cui vogliamo disegnare
-        VkRect2D scissor{};
-        scissor.offset = {0, 0};
-        scissor.extent = swapChainExtent;
-        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        // con più thread i comandi del render pass stanno tutti nei command buffer secondari, il primario li esegue soltanto
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, commandCaching || multithreadedRecording ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+
+        // i dati di camera e luci vengono scritti una volta per frame, e gli offset dinamici scelgono
+        // il blocco del frame nel buffer uniforme e il suo array nello storage buffer degli oggetti
+        std::array<uint32_t, 2> dynamicOffsets = {updateUniformBuffer(), objectBuffer->getFrameOffset(currentFrame)};
+        VkDescriptorSet textureSet = textureTable->getDescriptorSet(currentFrame);
+
+        // lo stato non passa da un command buffer all'altro, quindi ogni command buffer secondario deve impostarlo da capo
+        auto recordState = [&](VkCommandBuffer cmd)
+        {
+            // ora dobbiamo specificare la viewport, cioè la parte della finestra in cui vogliamo disegnare
+            // ricordiamo che dobbiamo ribaltare le coordinate Y, quindi l'altezza sarà negativa
+            VkViewport viewport{};
+            viewport.x = 0.0f;
+            viewport.y = static_cast<float>(swapChainExtent.height); // Sposta l'origine Y in basso per compensare l'inversione
+            viewport.width = static_cast<float>(swapChainExtent.width);
+            viewport.height = -static_cast<float>(swapChainExtent.height); // Altezza negativa per ribaltare l'asse Y
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+            vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+            // e anche la scissor, cioè la parte della finestra in cui vogliamo disegnare
+            VkRect2D scissor{};
+            scissor.offset = {0, 0};
+            scissor.extent = swapChainExtent;
+            vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+            // la tabella delle texture e il set 0 sono gli stessi per tutte le mesh, quindi li colleghiamo una volta sola
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &textureSet, 0, nullptr);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &uniformDescriptorSet,
+                                    static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+        };
 
         // avendo più mesh, dobbiamo usare un ciclo per disegnarle tutte
         std::unordered_set<size_t> transparentMeshIndices = {6, 7, 9, 10, 11};
@@ -1771,10 +2260,47 @@ private:
         std::vector<std::pair<float, size_t>> transparentSorted;
         glm::vec3 cameraPos = glm::vec3(camera.pos);
 
+        // il livello di dettaglio di ogni mesh dipende da quanto è grande sullo schermo, serve la stessa proiezione di updateUniformBuffer
+        glm::mat4 model = baseTransform * userTransform;
+        float projectionScale = swapChainExtent.height / (2.0f * std::tan(glm::radians(45.0f) * 0.5f));
+        // piani del frustum e camera nello spazio del modello, il test del cono vale solo per la pipeline che scarta le facce posteriori
+        glm::mat4 viewProj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 255.0f) *
+                             glm::lookAt(camera.pos, camera.target, camera.up);
+        MeshletCulling opaqueCulling = makeMeshletCulling(model, viewProj, cameraPos, !wireframeMode);
+        MeshletCulling transparentCulling = makeMeshletCulling(model, viewProj, cameraPos, false);
+
+        // prima prepariamo la lista dei disegni, nell'ordine in cui vanno eseguiti, e riserviamo i posti dei loro oggetti;
+        // il lavoro su ogni oggetto (matrici, livello di dettaglio) viene fatto dopo, diviso tra i thread per oggetti e non per disegni,
+        // così anche le copie di un solo disegno con l'instancing vengono preparate in parallelo; poi si registrano i comandi
+        struct DrawItem
+        {
+            size_t mesh;                   // indice della mesh in meshes
+            bool transparent;              // sceglie la pipeline e i dati per il culling dei meshlet
+            uint32_t firstObject;          // posto del primo oggetto nello storage buffer degli oggetti
+            const MeshInstance *instances; // copie da disegnare con l'instancing, nullptr per un solo oggetto
+            uint32_t instanceCount;        // numero di oggetti del disegno
+            uint32_t lod;                  // livello di dettaglio, scelto da prepareDraws
+        };
+        std::vector<DrawItem> drawItems;
+        size_t objectCount = 0; // oggetti di tutti i disegni, in posti consecutivi dello storage buffer
+        auto addDrawItems = [&](size_t index, bool transparent)
+        {
+            // tutte le copie di una mesh vanno in un solo disegno, cioè un solo comando per sub-mesh
+            uint32_t count = meshInstances.empty() ? 1 : static_cast<uint32_t>(meshInstances.size());
+            drawItems.push_back({index, transparent, objectBuffer->reserve(count), meshInstances.empty() ? nullptr : meshInstances.data(), count, 0});
+            objectCount += count;
+        };
+
         // Ciclo ottimizzato
         for (size_t i = 0; i < meshToRender.size(); ++i)
         {
             size_t index = meshToRender[i];
+            // un modello appena tornato visibile viene disegnato solo quando i suoi buffer sono sulla GPU,
+            // un modello che non si è caricato all'avvio resta una mesh vuota senza buffer
+            if (meshes[index] == nullptr || !uploadBatch->isReady(meshUploads[index]) || meshes[index]->getIndexCount() == 0)
+            {
+                continue;
+            }
 
             if (transparentMeshIndices.count(index))
             {
@@ -1785,13 +2311,8 @@ private:
             }
             else
             {
-                // Disegna subito gli opachi
-                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, wireframeMode ? wirePipelines[0] : noWirePipelines[0]);
-                meshes[index]->draw(commandBuffer, currentFrame, pipelineLayout,
-                                    [&]()
-                                    {
-                                        updateUniformBuffer(currentFrame);
-                                    });
+                // gli opachi vengono disegnati per primi
+                addDrawItems(index, false);
             }
         }
 
@@ -1805,17 +2326,177 @@ private:
         // Disegna i trasparenti ordinati
         for (const auto &[_, index] : transparentSorted)
         {
-            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, wireframeMode ? wirePipelines[1] : noWirePipelines[1]);
-            meshes[index]->draw(commandBuffer, currentFrame, pipelineLayout,
-                                [&]()
-                                {
-                                    updateUniformBuffer(currentFrame);
-                                });
+            addDrawItems(index, true);
+        }
+
+        // scrive i dati delle copie da first a last di un disegno nello storage buffer e restituisce il livello di dettaglio che serve alla più vicina
+        // ogni oggetto scrive la sua matrice del modello, e quella delle normali calcolata sulla CPU, nel suo posto dello storage buffer degli oggetti:
+        // il posto arriva alla vertex shader come gl_InstanceIndex tramite firstInstance
+        auto prepareCopies = [&](const DrawItem &item, uint32_t first, uint32_t last)
+        {
+            Mesh *mesh = meshes[item.mesh];
+            if (item.instances == nullptr)
+            {
+                objectBuffer->write(item.firstObject, model);
+                return lodEnabled ? mesh->selectLod(model, cameraPos, projectionScale, lodMaxPixelError) : 0u;
+            }
+            uint32_t lod = std::numeric_limits<uint32_t>::max();
+            for (uint32_t copy = first; copy < last; copy++)
+            {
+                const MeshInstance &instance = item.instances[copy];
+                glm::mat4 instanceModel = model * instance.transform;
+                objectBuffer->write(item.firstObject + copy, instanceModel,
+                                    instance.textureIndex >= 0 ? static_cast<uint32_t>(instance.textureIndex) : OBJECT_MESH_TEXTURE);
+                lod = std::min(lod, lodEnabled ? mesh->selectLod(instanceModel, cameraPos, projectionScale, lodMaxPixelError) : 0u);
+            }
+            return lod;
+        };
+        // prepara la parte part di partCount degli oggetti di tutti i disegni e scrive in lods il livello di dettaglio trovato per ogni disegno;
+        // può essere chiamata da più thread insieme, su parti diverse
+        auto prepareObjects = [&](uint32_t part, uint32_t partCount, std::vector<uint32_t> &lods)
+        {
+            lods.assign(drawItems.size(), std::numeric_limits<uint32_t>::max());
+            size_t begin = objectCount * part / partCount, end = objectCount * (part + 1) / partCount;
+            size_t itemStart = 0;
+            for (size_t i = 0; i < drawItems.size() && itemStart < end; i++)
+            {
+                size_t itemEnd = itemStart + drawItems[i].instanceCount;
+                if (itemEnd > begin)
+                {
+                    lods[i] = prepareCopies(drawItems[i], static_cast<uint32_t>(std::max(begin, itemStart) - itemStart),
+                                            static_cast<uint32_t>(std::min(end, itemEnd) - itemStart));
+                }
+                itemStart = itemEnd;
+            }
+        };
+        // prepara tutti gli oggetti, sui thread del recorder se ce n'è più di uno: tutte le copie di un disegno usano lo stesso livello di dettaglio,
+        // quello che serve alla copia più vicina, quindi il livello di ogni disegno è il minimo tra quelli delle parti
+        auto prepareDraws = [&]()
+        {
+            uint32_t partCount = multithreadedRecording ? commandRecorder->getThreadCount() : 1;
+            std::vector<std::vector<uint32_t>> partLods(partCount);
+            if (partCount > 1)
+            {
+                commandRecorder->run([&](uint32_t part)
+                                     { prepareObjects(part, partCount, partLods[part]); });
+            }
+            else
+            {
+                prepareObjects(0, 1, partLods[0]);
+            }
+            for (size_t i = 0; i < drawItems.size(); i++)
+            {
+                drawItems[i].lod = std::numeric_limits<uint32_t>::max();
+                for (const std::vector<uint32_t> &lods : partLods)
+                {
+                    drawItems[i].lod = std::min(drawItems[i].lod, lods[i]);
+                }
+            }
+        };
+        // registra i disegni da begin a end e conta i triangoli disegnati e quelli scartati; può essere chiamata da più thread insieme, su disegni diversi
+        // con l'instancing un solo comando di disegno per sub-mesh disegna tutte le copie di un disegno
+        auto recordDraws = [&](VkCommandBuffer cmd, size_t begin, size_t end, bool cullMeshlets, size_t &drawn, size_t &culled)
+        {
+            VkPipeline boundPipeline = VK_NULL_HANDLE;
+            for (size_t i = begin; i < end; i++)
+            {
+                const DrawItem &item = drawItems[i];
+                Mesh *mesh = meshes[item.mesh];
+                VkPipeline pipeline = wireframeMode ? wirePipelines[item.transparent ? 1 : 0] : noWirePipelines[item.transparent ? 1 : 0];
+                if (pipeline != boundPipeline)
+                {
+                    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                    boundPipeline = pipeline;
+                }
+                // i meshlet vengono scartati solo per gli oggetti singoli, con l'instancing la visibilità cambia da copia a copia
+                const MeshletCulling &culling = item.transparent ? transparentCulling : opaqueCulling;
+                bool cull = cullMeshlets && item.instances == nullptr;
+                size_t meshDrawn = mesh->draw(cmd, pipelineLayout, item.firstObject, item.lod, cull ? &culling : nullptr, item.instanceCount);
+                drawn += meshDrawn;
+                culled += mesh->getTriangleCount(item.lod) * item.instanceCount - meshDrawn;
+            }
+        };
+        drawnTriangles = 0;
+        culledTriangles = 0;
+        // i dati degli oggetti cambiano a ogni frame e passano solo dallo storage buffer, quindi vengono scritti anche quando i comandi sono in cache
+        prepareDraws();
+
+        if (commandCaching)
+        {
+            // i comandi registrati dipendono solo dalla lista dei disegni (con i livelli di dettaglio), dagli offset dinamici e da sceneVersion
+            CachedCommands &cache = commandCache[currentFrame];
+            std::vector<std::array<uint32_t, 5>> drawKey;
+            drawKey.reserve(drawItems.size());
+            for (const DrawItem &item : drawItems)
+            {
+                drawKey.push_back({static_cast<uint32_t>(item.mesh), item.transparent ? 1u : 0u, item.firstObject, item.instanceCount, item.lod});
+            }
+            if (!cache.valid || cache.version != sceneVersion || cache.dynamicOffsets != dynamicOffsets || cache.draws != drawKey)
+            {
+                // senza framebuffer i comandi restano validi per tutte le immagini della swap chain;
+                // i meshlet non vengono scartati perché la loro visibilità cambierebbe a ogni movimento della camera
+                uint32_t threadCount = commandRecorder->getThreadCount();
+                std::vector<size_t> chunkDrawn(threadCount, 0), chunkCulled(threadCount, 0);
+                commandRecorder->record(
+                    currentFrame, renderPass, VK_NULL_HANDLE,
+                    [&](VkCommandBuffer cmd, uint32_t chunk)
+                    {
+                        recordState(cmd);
+                        recordDraws(cmd, drawItems.size() * chunk / threadCount, drawItems.size() * (chunk + 1) / threadCount,
+                                    false, chunkDrawn[chunk], chunkCulled[chunk]);
+                    },
+                    true);
+                cache.valid = true;
+                cache.version = sceneVersion;
+                cache.dynamicOffsets = dynamicOffsets;
+                cache.draws = std::move(drawKey);
+                cache.drawnTriangles = 0;
+                cache.culledTriangles = 0;
+                for (uint32_t chunk = 0; chunk < threadCount; chunk++)
+                {
+                    cache.drawnTriangles += chunkDrawn[chunk];
+                    cache.culledTriangles += chunkCulled[chunk];
+                }
+                commandRecordings++;
+            }
+            std::vector<VkCommandBuffer> secondaryBuffers = commandRecorder->getCommandBuffers(currentFrame);
+            vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryBuffers.size()), secondaryBuffers.data());
+            drawnTriangles = cache.drawnTriangles;
+            culledTriangles = cache.culledTriangles;
+        }
+        else if (multithreadedRecording)
+        {
+            // ogni thread registra un pezzo consecutivo della lista, quindi eseguendo i pezzi in ordine l'ordine dei disegni non cambia
+            uint32_t threadCount = commandRecorder->getThreadCount();
+            std::vector<size_t> chunkDrawn(threadCount, 0), chunkCulled(threadCount, 0);
+            const std::vector<VkCommandBuffer> &secondaryBuffers = commandRecorder->record(
+                currentFrame, renderPass, swapChainFramebuffers[imageIndex],
+                [&](VkCommandBuffer cmd, uint32_t chunk)
+                {
+                    recordState(cmd);
+                    recordDraws(cmd, drawItems.size() * chunk / threadCount, drawItems.size() * (chunk + 1) / threadCount,
+                                meshletCulling, chunkDrawn[chunk], chunkCulled[chunk]);
+                });
+            vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryBuffers.size()), secondaryBuffers.data());
+            for (uint32_t chunk = 0; chunk < threadCount; chunk++)
+            {
+                drawnTriangles += chunkDrawn[chunk];
+                culledTriangles += chunkCulled[chunk];
+            }
+            commandRecordings++;
+        }
+        else
+        {
+            recordState(commandBuffer);
+            recordDraws(commandBuffer, 0, drawItems.size(), meshletCulling, drawnTriangles, culledTriangles);
+            commandRecordings++;
         }
 
         // ora che abbiamo finito di disegnare, possiamo finalmente terminare il render pass
         vkCmdEndRenderPass(commandBuffer);
 
+        recordingMs += std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - recordingStart).count();
+
         // se è un successo non avremo nessun errore
         if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
         {
@@ -1832,45 +2513,30 @@ private:
      */
     void createUniformBuffers()
     {
-        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-        uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-        uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-        uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
-
-        // avendo più mesh, dobbiamo creare un buffer per ogni mesh
-        for (size_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+        VkMemoryPropertyFlags uniformMemoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        if (uploadBatch->usesDirectUploads())
         {
-            uniformBuffers[frame].resize(1);
-            uniformBuffersMemory[frame].resize(1);
-            uniformBuffersMapped[frame].resize(1);
-            int meshIndex = 0;
-            // for (size_t meshIndex = 0; meshIndex < meshToRender.size(); meshIndex++)
-            // {
-            createBuffer(device, physicalDevice, bufferSize,
-                         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                         uniformBuffers[frame][meshIndex], uniformBuffersMemory[frame][meshIndex]);
-
-            vkMapMemory(device, uniformBuffersMemory[frame][meshIndex], 0, bufferSize, 0,
-                        &uniformBuffersMapped[frame][meshIndex]);
-            // }
+            uniformMemoryProperties |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
         }
+
+        // un solo buffer per tutti i frame in volo: ogni frame ha il suo blocco con camera e luci, e il suo array di oggetti nello storage buffer
+        // con i caricamenti diretti anche questi buffer stanno nella memoria device local, che la GPU legge più velocemente
+        uniformRing = new UniformRing(device, physicalDevice, sizeof(UniformBufferObject), 1, MAX_FRAMES_IN_FLIGHT, uniformMemoryProperties);
+        objectBuffer = new ObjectBuffer(device, physicalDevice, MAX_OBJECTS_PER_FRAME, MAX_FRAMES_IN_FLIGHT, uniformMemoryProperties);
     }
 
     /**
      * @brief metodo per aggiornare i buffer uniformi
      *
-     * Questo metodo aggiorna i buffer uniformi con i dati correnti.
+     * Questo metodo scrive i dati correnti di camera e luci nel blocco del buffer uniforme del frame corrente.
+     * Va chiamato una volta sola per frame, i dati degli oggetti vanno nello storage buffer degli oggetti.
      *
-     * @param frame il numero del frame corrente
-     * @return non ritorna nulla
+     * @return l'offset dinamico del blocco, da usare quando si collega il descriptor set del buffer uniforme
      */
-    void updateUniformBuffer(const uint32_t frame, const uint32_t meshIndex = 0)
+    uint32_t updateUniformBuffer()
     {
         // ora applico tutto al uniform buffer object
         struct UniformBufferObject ubo{};
-        ubo.sMatrices.model = baseTransform * userTransform;                                                                             // matrice di trasformazione del modello
         ubo.sMatrices.view = glm::lookAt(camera.pos, camera.target, camera.up);                                                          // matrice di vista della camera
         ubo.sMatrices.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 255.0f); // proiezione prospettica
         ubo.aLight.color = ambient_light.color();
@@ -1881,7 +2547,7 @@ private:
         ubo.specLight.intensity = specular_light.intensity();
         ubo.specLight.shininess = specular_light.shininess();
         ubo.cameraPos = glm::vec4(camera.pos, 0.0f); // posizione della camera in vec4 così da essere allineata a 16 byte
-        memcpy(uniformBuffersMapped[frame][meshIndex], &ubo, sizeof(ubo));
+        return uniformRing->push(&ubo, sizeof(ubo));
     }
 
     /**
@@ -1897,10 +2563,10 @@ private:
         VkFormat depthFormat = findDepthFormat();
         // l'immagine deve avere la stessa risoluzione della swap chain
         createImage(device, physicalDevice,
-                    swapChainExtent.width, swapChainExtent.height,
+                    swapChainExtent.width, swapChainExtent.height, 1,
                     depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                    depthImage, depthImageMemory);
-        depthImageView = createImageView(device, depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+                    MemoryCategory::Attachment, depthImage, depthImageMemory);
+        depthImageView = createImageView(device, depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
     }
 
     /**
@@ -1970,19 +2636,18 @@ private:
      */
     void createDescriptorPool()
     {
+        // le texture hanno il loro pool nella tabella delle texture, qui servono solo il buffer uniforme e quello degli oggetti, con un solo set per tutto
         std::array<VkDescriptorPoolSize, 2> poolSizes{};
-        // Moltiplica per il numero di mesh e frame
-        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * meshes.size());
-        poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * meshes.size() * MAX_TEXTURES);
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        poolSizes[0].descriptorCount = 1;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        poolSizes[1].descriptorCount = 1;
 
         VkDescriptorPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
         poolInfo.pPoolSizes = poolSizes.data();
-        // Numero massimo di set = numero di frame * numero di mesh
-        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * meshes.size());
+        poolInfo.maxSets = 1;
 
         if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
         {
@@ -2017,80 +2682,50 @@ private:
                 - estremamente efficiente, ma molto limitato in termini di dimensioni dei dati (max 128 byte)
                 - non possiamo usarlo perché altrimenti non potremmo usare le luci
                 - molto semplice da implementare, ma non ci interessa
-            noi useremo la 2, perché è più intuibile a livello didattico e più leggibile a livello di codice, ma in caso di progetti futuri più complessi, la 3 è l'opzione migliore
-            quindi prima di tutto creiamo un array di descriptor set grande frame * mesh
-            quando toccherà alle texture della singola mesh, creeremo un array di texture e lo passeremo al descriptor set
+            noi usiamo una variante della 3: un solo descriptor set per tutti gli oggetti e tutti i frame
+                - camera e luci stanno nel buffer uniforme, in un blocco per frame scritto una volta sola (vedi uniformRing.h)
+                - le matrici degli oggetti stanno in un array in uno storage buffer, e ogni comando di disegno sceglie il suo oggetto
+                  con firstInstance, che la vertex shader legge come gl_InstanceIndex (vedi objectBuffer.h)
+                - gli offset dinamici scelgono il blocco e l'array del frame, quindi non serve un set per frame
+            le texture invece non sono più nei set delle mesh: stanno tutte nella tabella delle texture (vedi textureTable.h),
+            un unico set in cui ogni texture ha un posto fisso, e la mesh passa alla shader solo il numero del posto
         */
-        size_t meshCount = meshes.size();
-        descriptorSets.resize(MAX_FRAMES_IN_FLIGHT, std::vector<VkDescriptorSet>(meshCount));
-
-        for (size_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame)
-        {
-            std::vector<VkDescriptorSetLayout> layouts(meshCount, descriptorSetLayout);
-
-            VkDescriptorSetAllocateInfo allocInfo{};
-            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            allocInfo.descriptorPool = descriptorPool;
-            allocInfo.descriptorSetCount = static_cast<uint32_t>(meshCount);
-            allocInfo.pSetLayouts = layouts.data();
-            if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets[frame].data()) != VK_SUCCESS)
-            {
-                throw std::runtime_error("failed to allocate descriptor sets!");
-            }
-
-            for (size_t meshIndex = 0; meshIndex < meshCount; ++meshIndex)
-            {
-                Mesh *mesh = meshes[meshIndex];
-
-                if (textures.empty())
-                    throw std::runtime_error("Mesh has no textures!");
-
-                // ora dobbiamo passare le info di tutte le texture della mesh al descriptor set
-                // ricordiamo che dobbiamo anche dire quali indici hanno le texture delle mesh
-
-                std::vector<VkDescriptorImageInfo> imageInfos;
-                int i = 0;
-                for (auto [name, texture] : textures)
-                {
-                    texture->setIndex(i);
-                    imageInfos.push_back(texture->getDescriptorInfo());
-                    // ora devo scorrere tutte le mesh per settare l'indice della texture
-                    // tanto in caso non sia presente nella mesh, non succede nulla, viene solo ignorata
-                    for (auto mesh : meshes)
-                    {
-                        mesh->setTextureIndex(name, i);
-                    }
-                    i++;
-                }
-
-                VkDescriptorBufferInfo bufferInfo{};
-                bufferInfo.buffer = uniformBuffers[frame][0];
-                bufferInfo.offset = 0;
-                bufferInfo.range = sizeof(UniformBufferObject);
-
-                std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
-
-                descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrites[0].dstSet = descriptorSets[frame][meshIndex];
-                descriptorWrites[0].dstBinding = 0;
-                descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                descriptorWrites[0].descriptorCount = 1;
-                descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-                descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrites[1].dstSet = descriptorSets[frame][meshIndex];
-                descriptorWrites[1].dstBinding = 1;
-                descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-                descriptorWrites[1].descriptorCount = static_cast<uint32_t>(imageInfos.size());
-                descriptorWrites[1].pImageInfo = imageInfos.data();
-
-                vkUpdateDescriptorSets(device,
-                                       static_cast<uint32_t>(descriptorWrites.size()),
-                                       descriptorWrites.data(),
-                                       0, nullptr);
-                meshes[meshIndex]->setDescriptorSet(frame, descriptorSets[frame][meshIndex]);
-            }
-        }
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &descriptorSetLayout;
+        if (vkAllocateDescriptorSets(device, &allocInfo, &uniformDescriptorSet) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+
+        // la range è un solo blocco o un solo array: l'offset dinamico passato a vkCmdBindDescriptorSets si somma all'offset 0
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer = uniformRing->getBuffer();
+        bufferInfo.offset = 0;
+        bufferInfo.range = sizeof(UniformBufferObject);
+
+        VkDescriptorBufferInfo objectInfo{};
+        objectInfo.buffer = objectBuffer->getBuffer();
+        objectInfo.offset = 0;
+        objectInfo.range = objectBuffer->getRange();
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = uniformDescriptorSet;
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = uniformDescriptorSet;
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pBufferInfo = &objectInfo;
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
     }
 
     /**
@@ -2108,6 +2743,21 @@ private:
         // il VK_TRUE indica che vogliamo aspettare tutte le fence (essendo solo una in questo caso, non cambia nulla)
         // mentre il UINT64_MAX indica il tempo massimo per un timeout di attesa (essendo massimo, esso viene disabilitato)
         vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        // i frame finiscono nell'ordine in cui sono stati inviati, quindi anche tutti quelli prima di questo sono finiti
+        completedFrames = std::max(completedFrames, inFlightFrameNumbers[currentFrame]);
+        deletionQueue.collect(completedFrames);
+        // la GPU ha finito il frame, il suo blocco del buffer uniforme e il suo array di oggetti si possono riscrivere
+        uniformRing->beginFrame(currentFrame);
+        objectBuffer->beginFrame(currentFrame);
+        // senza descriptor indexing le texture nuove entrano nella copia della tabella di questo frame solo ora,
+        // e riscrivere un descriptor set rende non validi i command buffer che lo usano
+        if (textureTable->update(currentFrame))
+        {
+            commandCache[currentFrame].valid = false;
+        }
+        uploadBatch->submit();  // inviamo i caricamenti registrati dopo l'avvio, prima dei comandi di disegno che li usano
+        stagingRing->reclaim(); // liberiamo lo spazio e i command buffer dei caricamenti che la GPU ha già finito
+        updateResidentMeshes();
         uint32_t imageIndex;
 
         // ci serve sapere se dobbiamo ricreare la swap chain, quindi usiamo la funzione vkAcquireNextImageKHR
@@ -2163,6 +2813,7 @@ private:
         {
             throw std::runtime_error("failed to submit draw command buffer!");
         }
+        inFlightFrameNumbers[currentFrame] = ++submittedFrames;
 
         // ora onfiguriamo la presentazione dell'immagine, cioè la parte finale del rendering
         VkPresentInfoKHR presentInfo{};
@@ -2309,49 +2960,309 @@ private:
         //     octahdron[i].texCoord.y = 1.0f - octahdron[i].texCoord.y;
         // }
         // ora possiamo creare le mesh, composte dagli array di vertici che abbiamo creato prima
-        meshes.resize(12);
-        for (int i = 0; i < 12; i++)
+        auto flags = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_FlipUVs;
+        // elenco dei modelli da caricare, con i flag di Assimp e la texture di ognuno
+        // i primi 3 modelli non hanno una loro texture, quindi gli imposto la texture bianca
+        // le parti di marius possono essere in qualunque ordine, l'importante è che partano dal 5
+        // i meshlet cambiano l'ordine dei triangoli, quindi come l'ottimizzazione per l'overdraw li usiamo solo per i modelli opachi
+        models = {
+            {"models/teapot.obj", flags, "blank", true},
+            {"models/skull.obj", flags, "blank", true},
+            {"models/dragon.obj", flags, "blank", true},
+            {"models/boot/boot.obj", flags, "boot", true},
+            {"models/flower/flower.obj", flags, "flower", true},
+            {"models/marius/head.obj", aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals, "mariusHead", true},
+            {"models/marius/eyelashesLower.obj", flags, "mariusLash", false},
+            {"models/marius/eyelashesUpper.obj", flags, "mariusLash", false},
+            {"models/marius/eyes.obj", flags, "mariusEye", true},
+            {"models/marius/hair_plate.obj", flags, "mariusHPlate", false},
+            {"models/marius/hair_vac.obj", flags, "mariusHVac", false},
+            {"models/marius/eyebrows.obj", flags, "mariusLash", false},
+        };
+        // ora possiamo creare le mesh, che verranno riempite con i modelli caricati da file
+        meshes.resize(models.size());
+        meshUploads.resize(models.size(), 0);
+        for (size_t i = 0; i < models.size(); i++)
+        {
+            meshes[i] = new Mesh(device, physicalDevice, commandPool, graphicsQueue, uploadBatch);
+            meshes[i]->addTexture(models[i].texture, -1);
+        }
+
+        // il caricamento è diviso in due parti:
+        //  1. la parte CPU (lettura della cache o import con Assimp e conversione in Vertex) viene fatta in parallelo da un pool di thread
+        //  2. il caricamento sulla GPU viene fatto solo da questo thread, perché il command pool e la coda non possono essere usati da più thread contemporaneamente
+        // i thread del pool mettono i modelli pronti in una coda, e questo thread li carica sulla GPU man mano che arrivano
+        struct LoadedModel
+        {
+            size_t index;
+            bool loaded;
+            double importMs;
+            MeshData data;
+        };
+        std::mutex readyMutex;
+        std::condition_variable readyCondition;
+        std::queue<LoadedModel> readyModels;
+        std::atomic<size_t> nextModel{0};
+
+        auto loadStart = std::chrono::high_resolution_clock::now();
+        unsigned int workerCount = std::max(1u, std::min(std::thread::hardware_concurrency(), static_cast<unsigned int>(models.size())));
+        std::vector<std::thread> workers;
+        for (unsigned int w = 0; w < workerCount; w++)
+        {
+            workers.emplace_back([&]()
+                                 {
+                // ogni thread prende il prossimo modello libero finché non sono finiti
+                for (size_t i = nextModel++; i < models.size(); i = nextModel++)
+                {
+                    LoadedModel result{i, false, 0.0, {}};
+                    auto start = std::chrono::high_resolution_clock::now();
+                    try
+                    {
+                        result.loaded = loadModelData(i, result.data);
+                    }
+                    catch (const std::exception &e)
+                    {
+                        std::cerr << models[i].path << ": " << e.what() << std::endl;
+                    }
+                    result.importMs = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+                    {
+                        std::lock_guard<std::mutex> lock(readyMutex);
+                        readyModels.push(std::move(result));
+                    }
+                    readyCondition.notify_one();
+                } });
+        }
+
+        std::vector<double> importMs(models.size(), 0.0), uploadMs(models.size(), 0.0);
+        std::vector<bool> loaded(models.size(), false);
+        try
         {
-            meshes[i] = new Mesh(device, physicalDevice, commandPool, graphicsQueue);
+            for (size_t uploaded = 0; uploaded < models.size(); uploaded++)
+            {
+                std::unique_lock<std::mutex> lock(readyMutex);
+                readyCondition.wait(lock, [&]()
+                                    { return !readyModels.empty(); });
+                LoadedModel model = std::move(readyModels.front());
+                readyModels.pop();
+                lock.unlock();
+
+                importMs[model.index] = model.importMs;
+                loaded[model.index] = model.loaded;
+                if (!model.loaded)
+                {
+                    continue;
+                }
+                auto start = std::chrono::high_resolution_clock::now();
+                meshes[model.index]->setMeshData(std::move(model.data), vertexLayout);
+                uploadMs[model.index] = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+            }
         }
-        auto flags = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_FlipUVs;
-        // ora che abbiamo creato le mesh, carichiamo i file .obj
-        meshes[0]->loadFromFile("models/teapot.obj", flags);
-        meshes[1]->loadFromFile("models/skull.obj", flags);
-        meshes[2]->loadFromFile("models/dragon.obj", flags);
-        // essendo che i primi 3 modelli non hanno una loro texture, gli imposto la texture bianca
-        for (int i = 0; i < 3; i++)
-        {
-            meshes[i]->addTexture("blank", -1);
-        }
-        // ora carico le texture dei modelli che hanno una loro texture
-        meshes[3]->loadFromFile("models/boot/boot.obj", flags);
-        meshes[3]->addTexture("boot", -1);
-        meshes[4]->loadFromFile("models/flower/flower.obj", flags);
-        meshes[4]->addTexture("flower", -1);
-
-        // ora carico tutte le parti di marius (non importa l'ordine delle singole, l'importante è che partano dal 5)
-        meshes[5]->loadFromFile("models/marius/head.obj", aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals);
-        meshes[5]->addTexture("mariusHead", -1);
-        meshes[6]->loadFromFile("models/marius/eyelashesLower.obj", flags);
-        meshes[6]->addTexture("mariusLash", -1);
-        meshes[7]->loadFromFile("models/marius/eyelashesUpper.obj", flags);
-        meshes[7]->addTexture("mariusLash", -1);
-        meshes[8]->loadFromFile("models/marius/eyes.obj", flags);
-        meshes[8]->addTexture("mariusEye", -1);
-        meshes[9]->loadFromFile("models/marius/hair_plate.obj", flags);
-        meshes[9]->addTexture("mariusHPlate", -1);
-        meshes[10]->loadFromFile("models/marius/hair_vac.obj", flags);
-        meshes[10]->addTexture("mariusHVac", -1);
-        meshes[11]->loadFromFile("models/marius/eyebrows.obj", flags);
-        meshes[11]->addTexture("mariusLash", -1);
-        std::cout << "modelli caricati" << std::endl;
+        catch (...)
+        {
+            // prima di propagare l'errore dobbiamo aspettare i thread, altrimenti il programma viene terminato
+            for (auto &worker : workers)
+            {
+                worker.join();
+            }
+            throw;
+        }
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+        auto loadEnd = std::chrono::high_resolution_clock::now();
+
+        for (size_t i = 0; i < models.size(); i++)
+        {
+            if (loaded[i])
+            {
+                std::cout << models[i].path << ": import " << importMs[i] << " ms, upload " << uploadMs[i] << " ms" << std::endl;
+            }
+            else
+            {
+                std::cout << models[i].path << ": non caricato" << std::endl;
+            }
+        }
+        std::cout << "modelli caricati in " << std::chrono::duration<float, std::chrono::milliseconds::period>(loadEnd - loadStart).count() << " ms con " << workerCount << " thread" << std::endl;
+        double totalUploadMs = 0.0;
+        for (double ms : uploadMs)
+        {
+            totalUploadMs += ms;
+        }
+        std::cout << "upload totale " << totalUploadMs << " ms " << (uploadBatch->usesDirectUploads() ? "(diretto)" : "(con staging)") << std::endl;
+
+        // memoria occupata dai vertex buffer, confrontata con quella che servirebbe con il formato Full
+        VkDeviceSize vertexBytes = 0, fullVertexBytes = 0;
+        for (size_t i = 0; i < models.size(); i++)
+        {
+            vertexBytes += meshes[i]->getVertexBufferSize();
+            fullVertexBytes += meshes[i]->getVertexCount() * sizeof(Vertex);
+        }
+        std::cout << "vertex buffer: " << vertexBytes / 1024 << " KB (" << fullVertexBytes / 1024 << " KB con il formato Full)" << std::endl;
         meshToRender.resize(1);
         meshToRender.push_back(0);
         meshCount = 1;
         baseTransform = glm::translate(glm::mat4(), glm::vec3(0.0f, -1.6f, -10.0f));
     }
 
+    /**
+     * @brief metodo per tenere sulla GPU solo i modelli visibili
+     *
+     * Chiamato ad ogni frame, prima di registrare i comandi di disegno:
+     *  - se modelUnloading è attivo, i modelli che non sono più in meshToRender vengono messi nella coda di distruzioni con il numero del prossimo frame,
+     *    così i buffer vengono liberati solo quando la GPU ha finito i frame che li usavano, senza vkDeviceWaitIdle
+     *  - i modelli tornati visibili vengono ricaricati da un thread, poi questo thread crea la mesh e registra i caricamenti
+     *    (il command pool e la coda si usano solo da qui); la mesh viene disegnata quando il suo invio di UploadBatch è pronto;
+     *    questo avviene anche con modelUnloading disattivato, per i modelli scaricati prima di disattivarlo
+     * Le mesh con caricamenti non ancora pronti non vengono distrutte, perché le acquisizioni in attesa usano i loro buffer.
+     *
+     * @return non ritorna nulla
+     */
+    void updateResidentMeshes()
+    {
+        std::unordered_set<size_t> visible(meshToRender.begin(), meshToRender.end());
+        for (size_t i = 0; i < meshes.size() && modelUnloading; i++)
+        {
+            if (visible.count(i) > 0 || meshes[i] == nullptr || !uploadBatch->isReady(meshUploads[i]))
+            {
+                continue;
+            }
+            // il prossimo frame inviato viene dopo tutti i frame e le acquisizioni che possono usare la mesh
+            Mesh *mesh = meshes[i];
+            deletionQueue.push(submittedFrames + 1, [mesh]()
+                               { delete mesh; });
+            meshes[i] = nullptr;
+            sceneVersion++; // i command buffer in cache possono contenere i buffer della mesh
+        }
+
+        for (size_t index : visible)
+        {
+            if (index >= meshes.size() || meshes[index] != nullptr || pendingMeshLoads.count(index) > 0 || failedMeshLoads.count(index) > 0)
+            {
+                continue;
+            }
+            pendingMeshLoads[index] = std::async(std::launch::async, [this, index]()
+                                                 {
+                auto data = std::make_unique<MeshData>();
+                try
+                {
+                    if (loadModelData(index, *data))
+                    {
+                        return data;
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    std::cerr << models[index].path << ": " << e.what() << std::endl;
+                }
+                return std::unique_ptr<MeshData>(); });
+        }
+
+        std::vector<size_t> reloaded;
+        for (auto it = pendingMeshLoads.begin(); it != pendingMeshLoads.end();)
+        {
+            if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                ++it;
+                continue;
+            }
+            size_t index = it->first;
+            std::unique_ptr<MeshData> data = it->second.get();
+            it = pendingMeshLoads.erase(it);
+            if (data == nullptr)
+            {
+                // la mesh resta nulla, quindi non viene disegnata; non riproviamo ad ogni frame
+                failedMeshLoads.insert(index);
+                std::cerr << models[index].path << ": impossibile ricaricare il modello" << std::endl;
+                continue;
+            }
+            Mesh *mesh = new Mesh(device, physicalDevice, commandPool, graphicsQueue, uploadBatch);
+            mesh->addTexture(models[index].texture, -1);
+            mesh->setMeshData(std::move(*data), vertexLayout);
+            // i posti delle texture nella tabella non cambiano, e il buffer uniforme è condiviso da tutte le mesh
+            assignTextureSlots(mesh);
+            meshes[index] = mesh;
+            sceneVersion++; // la mesh ricaricata ha buffer nuovi, anche se ha lo stesso indice
+            reloaded.push_back(index);
+            std::cout << models[index].path << ": ricaricato" << std::endl;
+        }
+        if (!reloaded.empty())
+        {
+            // tutti i modelli arrivati in questo frame vanno in un solo invio
+            uint64_t submission = uploadBatch->submit();
+            for (size_t index : reloaded)
+            {
+                meshUploads[index] = submission;
+            }
+        }
+    }
+
+    /**
+     * @brief metodo per leggere i dati di un modello, dalla cache o importandolo
+     *
+     * Usa solo la lista dei modelli e le impostazioni globali, quindi può essere chiamato da più thread contemporaneamente.
+     *
+     * @param index L'indice del modello in models.
+     * @param data I dati letti.
+     * @return true se il modello è stato caricato.
+     */
+    bool loadModelData(size_t index, MeshData &data) const
+    {
+        MeshLoadOptions options;
+        options.importer = meshImporter;
+        options.optimizations = meshOptimizations;
+        options.lodLevels = meshLodLevels;
+        options.buildMeshlets = models[index].meshlets;
+        return loadOrImportMeshData(models[index].path, models[index].flags, data, options);
+    }
+
+    /**
+     * @brief metodo per caricare le texture dei materiali dei modelli
+     *
+     * Ogni sub-mesh importata conosce il percorso della texture diffusa (map_Kd) del suo materiale.
+     * Se quel file non è già tra le texture caricate da initializeTextures, lo carichiamo qui, usando il percorso come nome.
+     * Il posto nella tabella delle texture viene assegnato in loadTextures, insieme a quello delle altre texture.
+     *
+     * @return non ritorna nulla
+     */
+    void loadMaterialTextures()
+    {
+        std::vector<std::pair<std::string, std::string>> files; // nome e percorso delle texture da caricare
+        for (Mesh *mesh : meshes)
+        {
+            for (const std::string &path : mesh->getSubMeshTextureFiles())
+            {
+                // la stessa texture può servire a più sub-mesh, la carichiamo una volta sola
+                if (path.empty() || textures.count(path) > 0 ||
+                    std::any_of(files.begin(), files.end(), [&](const auto &file)
+                                { return file.first == path; }))
+                {
+                    continue;
+                }
+                bool loaded = false;
+                for (auto &[name, texture] : textures)
+                {
+                    if (std::filesystem::path(texture->getPath()).lexically_normal() == std::filesystem::path(path).lexically_normal())
+                    {
+                        loaded = true;
+                        break;
+                    }
+                }
+                if (loaded)
+                {
+                    continue;
+                }
+                if (textures.size() + files.size() >= textureTable->getCapacity() || !std::filesystem::exists(path))
+                {
+                    std::cerr << "texture del materiale ignorata: " << path << std::endl;
+                    continue;
+                }
+                files.push_back({path, path});
+            }
+        }
+        loadTextures(files);
+    }
+
     /**
      * @brief metodo per inizializzare le texture
      *
@@ -2363,14 +3274,195 @@ private:
     void initializeTextures()
     {
         // per comodità, ho creato una mappa di texture, in modo da poterle usare più facilmente senza ricordare l'indice esatto di ogni texture
-        textures["blank"] = new Texture(device, physicalDevice, commandPool, graphicsQueue, "moreTextures/white.png");
-        textures["boot"] = new Texture(device, physicalDevice, commandPool, graphicsQueue, "models/boot/d-1.png");
-        textures["flower"] = new Texture(device, physicalDevice, commandPool, graphicsQueue, "models/flower/12301_Flower_diff.jpg");
-        textures["mariusEye"] = new Texture(device, physicalDevice, commandPool, graphicsQueue, "models/marius/mrus_eyeball_iris_diffout.png");
-        textures["mariusLash"] = new Texture(device, physicalDevice, commandPool, graphicsQueue, "models/marius/mrus_eyelash_diffout.png");
-        textures["mariusHPlate"] = new Texture(device, physicalDevice, commandPool, graphicsQueue, "models/marius/mrus_hair_plate_diffout.png");
-        textures["mariusHVac"] = new Texture(device, physicalDevice, commandPool, graphicsQueue, "models/marius/mrus_hair_vac_diffout.png");
-        textures["mariusHead"] = new Texture(device, physicalDevice, commandPool, graphicsQueue, "models/marius/mrus_head_clean_diffout.png");
+        loadTextures({
+            {"blank", "moreTextures/white.png"},
+            {"boot", "models/boot/d-1.png"},
+            {"flower", "models/flower/12301_Flower_diff.jpg"},
+            {"mariusEye", "models/marius/mrus_eyeball_iris_diffout.png"},
+            {"mariusLash", "models/marius/mrus_eyelash_diffout.png"},
+            {"mariusHPlate", "models/marius/mrus_hair_plate_diffout.png"},
+            {"mariusHVac", "models/marius/mrus_hair_vac_diffout.png"},
+            {"mariusHead", "models/marius/mrus_head_clean_diffout.png"},
+        });
+    }
+
+    /**
+     * @brief metodo per preparare le copie della scena di prova per l'instancing
+     *
+     * Le teiere sono disposte in una griglia di TEAPOT_GRID_SIZE x TEAPOT_GRID_SIZE sul piano XZ, davanti alla camera,
+     * ognuna ruotata in modo diverso e con una delle texture già caricate, per provare anche la texture di ogni copia
+     * (solo se il dispositivo supporta l'indicizzazione non uniforme, altrimenti tutte usano la texture della mesh).
+     * Va chiamato dopo il caricamento delle texture, quando i loro posti nella tabella sono già assegnati.
+     *
+     * @return non ritorna nulla
+     */
+    void createTeapotGrid()
+    {
+        // -1 lascia la texture della mesh, le altre sono texture caricate da initializeTextures
+        std::vector<int32_t> gridTextures = {-1};
+        if (nonUniformTextureIndexing)
+        {
+            for (const char *name : {"blank", "boot", "flower"})
+            {
+                gridTextures.push_back(static_cast<int32_t>(textures.at(name)->getIndex()));
+            }
+        }
+        const float spacing = 4.0f;
+        teapotGrid.clear();
+        teapotGrid.reserve(TEAPOT_GRID_SIZE * TEAPOT_GRID_SIZE);
+        for (uint32_t row = 0; row < TEAPOT_GRID_SIZE; row++)
+        {
+            for (uint32_t column = 0; column < TEAPOT_GRID_SIZE; column++)
+            {
+                MeshInstance instance;
+                glm::vec3 position((column - (TEAPOT_GRID_SIZE - 1) * 0.5f) * spacing, 0.0f, -(row * spacing));
+                instance.transform = glm::translate(glm::mat4(1.0f), position) *
+                                     glm::rotate(glm::mat4(1.0f), glm::radians(static_cast<float>((row * 37 + column * 53) % 360)), glm::vec3(0.0f, 1.0f, 0.0f));
+                instance.textureIndex = gridTextures[(row + column) % gridTextures.size()];
+                teapotGrid.push_back(instance);
+            }
+        }
+    }
+
+    /**
+     * @brief metodo per dire a una mesh in quale posto della tabella si trovano le sue texture
+     *
+     * @param mesh La mesh, con le texture indicate per nome (addTexture) o per percorso del file (sub-mesh con un materiale).
+     * @return non ritorna nulla
+     */
+    void assignTextureSlots(Mesh *mesh)
+    {
+        // se la mesh non usa una texture non succede nulla, viene solo ignorata
+        for (auto &[name, texture] : textures)
+        {
+            mesh->setTextureIndex(name, texture->getIndex());
+            mesh->setSubMeshTextureIndex(texture->getPath(), texture->getIndex());
+        }
+    }
+
+    /**
+     * @brief metodo per caricare più texture insieme
+     *
+     * Come per i modelli, il caricamento è diviso in due parti:
+     *  1. la decodifica delle immagini (stb_image o lettura dei file KTX2, e le mipmap se la GPU non può generarle) viene fatta in parallelo da un pool di thread
+     *  2. la creazione delle immagini Vulkan e la registrazione delle copie nel batch vengono fatte solo da questo thread, man mano che le immagini sono pronte
+     * Le copie partono tutte insieme con l'invio del batch in initVulkan.
+     *
+     * @param files Il nome con cui salvare ogni texture nella mappa e il percorso del suo file.
+     * @return non ritorna nulla
+     */
+    void loadTextures(const std::vector<std::pair<std::string, std::string>> &files)
+    {
+        struct DecodedTexture
+        {
+            size_t index;
+            TextureData data;
+            std::exception_ptr error; // l'errore della decodifica, viene rilanciato da questo thread
+        };
+        std::mutex readyMutex;
+        std::condition_variable readyCondition;
+        std::queue<DecodedTexture> readyTextures;
+        std::atomic<size_t> nextTexture{0};
+        bool gpuMipmaps = uploadBatch->generatesMipmaps(VK_FORMAT_R8G8B8A8_SRGB);
+
+        auto loadStart = std::chrono::high_resolution_clock::now();
+        unsigned int workerCount = std::max(1u, std::min(std::thread::hardware_concurrency(), static_cast<unsigned int>(files.size())));
+        std::vector<std::thread> workers;
+        for (unsigned int w = 0; w < workerCount; w++)
+        {
+            workers.emplace_back([&]()
+                                 {
+                for (size_t i = nextTexture++; i < files.size(); i = nextTexture++)
+                {
+                    DecodedTexture result{i, {}, nullptr};
+                    try
+                    {
+                        result.data = Texture::loadImageData(files[i].second, textureCompressionEnabled, gpuMipmaps);
+                    }
+                    catch (...)
+                    {
+                        result.error = std::current_exception();
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(readyMutex);
+                        readyTextures.push(std::move(result));
+                    }
+                    readyCondition.notify_one();
+                } });
+        }
+
+        std::exception_ptr error;
+        for (size_t uploaded = 0; uploaded < files.size(); uploaded++)
+        {
+            std::unique_lock<std::mutex> lock(readyMutex);
+            readyCondition.wait(lock, [&]()
+                                { return !readyTextures.empty(); });
+            DecodedTexture texture = std::move(readyTextures.front());
+            readyTextures.pop();
+            lock.unlock();
+
+            // in caso di errore aspettiamo comunque tutte le immagini, i thread vanno fermati prima di propagarlo
+            if (error || texture.error)
+            {
+                error = error ? error : texture.error;
+                continue;
+            }
+            try
+            {
+                Texture *loaded = new Texture(device, physicalDevice, commandPool, graphicsQueue, uploadBatch, samplerCache, texture.data);
+                textures[files[texture.index].first] = loaded;
+                // il posto nella tabella non cambia più, quindi le mesh possono usarlo da subito
+                loaded->setIndex(static_cast<int>(textureTable->add(loaded->getDescriptorInfo())));
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+        }
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        // le texture possono arrivare anche dopo le mesh (per esempio quelle dei materiali), quindi aggiorniamo gli indici di tutte
+        for (Mesh *mesh : meshes)
+        {
+            if (mesh != nullptr)
+            {
+                assignTextureSlots(mesh);
+            }
+        }
+        if (files.empty())
+        {
+            return;
+        }
+        std::cout << files.size() << " texture decodificate con " << workerCount << " thread e caricate in "
+                  << std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - loadStart).count()
+                  << " ms" << std::endl;
+    }
+
+    /**
+     * @brief metodo per stampare la memoria occupata dalle texture, con e senza compressione
+     *
+     * @return non ritorna nulla
+     */
+    void printTextureMemory()
+    {
+        VkDeviceSize imageBytes = 0, uncompressedBytes = 0;
+        size_t compressedCount = 0;
+        for (auto &[name, texture] : textures)
+        {
+            imageBytes += texture->getImageBytes();
+            uncompressedBytes += texture->getUncompressedBytes();
+            compressedCount += texture->isCompressed() ? 1 : 0;
+        }
+        std::cout << "texture: " << imageBytes / 1024 << " KB (" << uncompressedBytes / 1024 << " KB in RGBA8), "
+                  << compressedCount << " di " << textures.size() << " compresse"
+                  << (textureCompressionEnabled ? "" : " (formati BC non attivi)") << ", "
+                  << samplerCache->size() << " sampler" << (immutableSamplers ? " immutabili" : "") << std::endl;
     }
 
     /**
@@ -0,0 +1,148 @@
+#include "memoryBudget.h"
+#include <iostream>
+#include <algorithm>
+
+// senza VK_EXT_memory_budget non sappiamo quanta memoria usano gli altri programmi, quindi ne lasciamo libera una parte
+const double ESTIMATED_BUDGET_FRACTION = 0.8;
+// oltre questa frazione del budget viene stampato il primo avviso
+const double BUDGET_WARNING_FRACTION = 0.9;
+
+static double toMB(VkDeviceSize bytes)
+{
+    return bytes / 1024.0 / 1024.0;
+}
+
+const char *memoryCategoryName(MemoryCategory category)
+{
+    switch (category)
+    {
+    case MemoryCategory::Mesh:
+        return "mesh";
+    case MemoryCategory::Texture:
+        return "texture";
+    case MemoryCategory::Uniform:
+        return "uniform";
+    case MemoryCategory::Attachment:
+        return "attachment";
+    case MemoryCategory::Staging:
+        return "staging";
+    default:
+        return "unknown";
+    }
+}
+
+MemoryBudget::MemoryBudget(VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2)
+    : physicalDevice(physicalDevice), getMemoryProperties2(getMemoryProperties2)
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    updateBudgets();
+}
+
+void MemoryBudget::updateBudgets()
+{
+    if (getMemoryProperties2 != nullptr)
+    {
+        // il driver restituisce uso e budget di ogni heap nella struttura collegata a pNext
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2KHR properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+        properties.pNext = &budgetProperties;
+        getMemoryProperties2(physicalDevice, &properties);
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+        {
+            heaps[i].usage = budgetProperties.heapUsage[i];
+            heaps[i].budget = budgetProperties.heapBudget[i];
+        }
+        return;
+    }
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+    {
+        heaps[i].usage = heaps[i].allocatedBytes;
+        heaps[i].budget = static_cast<VkDeviceSize>(memoryProperties.memoryHeaps[i].size * ESTIMATED_BUDGET_FRACTION);
+    }
+}
+
+void MemoryBudget::trackResource(MemoryCategory category, int64_t bytes)
+{
+    CategoryStats &stats = categories[static_cast<int>(category)];
+    stats.bytes += bytes;
+    if (bytes >= 0)
+    {
+        stats.count++;
+    }
+    else
+    {
+        stats.count--;
+    }
+    stats.peakBytes = std::max(stats.peakBytes, stats.bytes);
+}
+
+void MemoryBudget::trackDeviceMemory(uint32_t memoryType, int64_t bytes)
+{
+    HeapStats &heap = heaps[memoryProperties.memoryTypes[memoryType].heapIndex];
+    heap.allocatedBytes += bytes;
+    heap.peakAllocatedBytes = std::max(heap.peakAllocatedBytes, heap.allocatedBytes);
+}
+
+bool MemoryBudget::checkDeviceAllocation(uint32_t memoryType, VkDeviceSize bytes)
+{
+    updateBudgets();
+    uint32_t heapIndex = memoryProperties.memoryTypes[memoryType].heapIndex;
+    HeapStats &heap = heaps[heapIndex];
+    VkDeviceSize after = heap.usage + bytes;
+    int level = after > heap.budget ? 2 : (after > heap.budget * BUDGET_WARNING_FRACTION ? 1 : 0);
+    if (level > heap.warningLevel)
+    {
+        std::cerr << "attenzione: allocazione di " << toMB(bytes) << " MB nell'heap " << heapIndex
+                  << (level == 2 ? " oltre il budget" : " vicino al budget") << " (uso " << toMB(heap.usage)
+                  << " MB, budget " << toMB(heap.budget) << " MB)" << std::endl;
+    }
+    heap.warningLevel = level;
+    return level < 2;
+}
+
+void MemoryBudget::printReport(std::ostream &out)
+{
+    updateBudgets();
+    out << "memoria per categoria:";
+    for (int i = 0; i < static_cast<int>(MemoryCategory::Count); i++)
+    {
+        out << " " << memoryCategoryName(static_cast<MemoryCategory>(i)) << " " << toMB(categories[i].bytes) << " MB ("
+            << categories[i].count << " risorse, picco " << toMB(categories[i].peakBytes) << " MB)" << (i + 1 < static_cast<int>(MemoryCategory::Count) ? "," : "");
+    }
+    out << std::endl;
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+    {
+        out << "heap " << i << (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? " (device local)" : "")
+            << ": allocati " << toMB(heaps[i].allocatedBytes) << " MB (picco " << toMB(heaps[i].peakAllocatedBytes)
+            << " MB), uso " << toMB(heaps[i].usage) << " MB su un budget di " << toMB(heaps[i].budget)
+            << " MB" << (getMemoryProperties2 != nullptr ? "" : " stimato") << ", dimensione " << toMB(memoryProperties.memoryHeaps[i].size) << " MB" << std::endl;
+    }
+}
+
+void MemoryBudget::writeJson(std::ostream &out)
+{
+    updateBudgets();
+    out << "{\n  \"memoryBudgetExtension\": " << (getMemoryProperties2 != nullptr ? "true" : "false") << ",\n  \"categories\": [\n";
+    for (int i = 0; i < static_cast<int>(MemoryCategory::Count); i++)
+    {
+        out << "    {\"name\": \"" << memoryCategoryName(static_cast<MemoryCategory>(i)) << "\", \"bytes\": " << categories[i].bytes
+            << ", \"peakBytes\": " << categories[i].peakBytes << ", \"count\": " << categories[i].count << "}"
+            << (i + 1 < static_cast<int>(MemoryCategory::Count) ? ",\n" : "\n");
+    }
+    out << "  ],\n  \"heaps\": [\n";
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+    {
+        out << "    {\"index\": " << i << ", \"deviceLocal\": " << (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? "true" : "false")
+            << ", \"size\": " << memoryProperties.memoryHeaps[i].size << ", \"allocatedBytes\": " << heaps[i].allocatedBytes
+            << ", \"peakAllocatedBytes\": " << heaps[i].peakAllocatedBytes << ", \"usage\": " << heaps[i].usage
+            << ", \"budget\": " << heaps[i].budget << "}" << (i + 1 < memoryProperties.memoryHeapCount ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+VkDeviceSize MemoryBudget::getCategoryBytes(MemoryCategory category) const
+{
+    return categories[static_cast<int>(category)].bytes;
+}
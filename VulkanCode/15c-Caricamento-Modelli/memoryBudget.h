@@ -0,0 +1,120 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <ostream>
+
+/**
+ * @brief A cosa serve una porzione di memoria del dispositivo, per sapere quanta memoria usa ogni parte della scena.
+ */
+enum class MemoryCategory
+{
+    Mesh,       // vertex e index buffer dei modelli
+    Texture,    // immagini delle texture
+    Uniform,    // buffer uniformi
+    Attachment, // immagini usate come attachment, come il depth buffer
+    Staging,    // buffer di staging per i caricamenti
+    Count
+};
+
+/**
+ * @brief Restituisce il nome di una categoria, usato nel report e nel file JSON.
+ * @param category La categoria.
+ * @return Il nome in minuscolo.
+ */
+const char *memoryCategoryName(MemoryCategory category);
+
+/**
+ * @brief Contabilità della memoria del dispositivo, per categoria di risorsa e per heap.
+ *
+ * Per ogni categoria conta le risorse e i loro byte, per ogni heap la memoria chiesta al driver.
+ * Se l'estensione VK_EXT_memory_budget è attiva, il budget e l'uso di ogni heap vengono letti dal driver
+ * (comprendono anche la memoria usata dagli altri programmi), altrimenti il budget è stimato all'80% dell'heap
+ * e l'uso è solo quello di questo programma.
+ * Prima di chiedere memoria al driver, checkDeviceAllocation avvisa se l'allocazione porta l'heap vicino o oltre il budget,
+ * così il problema si vede prima che vkAllocateMemory fallisca.
+ * Non è thread safe: viene usata da DeviceAllocator, che la protegge con il suo mutex.
+ */
+class MemoryBudget
+{
+public:
+    /**
+     * @brief Costruttore della classe MemoryBudget.
+     *
+     * @param physicalDevice Il dispositivo fisico Vulkan.
+     * @param getMemoryProperties2 vkGetPhysicalDeviceMemoryProperties2KHR se VK_EXT_memory_budget è attiva, altrimenti nullptr.
+     */
+    MemoryBudget(VkPhysicalDevice physicalDevice, PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2);
+
+    /**
+     * @brief Registra una risorsa creata o distrutta.
+     *
+     * @param category La categoria della risorsa.
+     * @param bytes La dimensione della risorsa, positiva se creata e negativa se distrutta.
+     */
+    void trackResource(MemoryCategory category, int64_t bytes);
+
+    /**
+     * @brief Registra memoria chiesta al driver o restituita.
+     *
+     * @param memoryType Il tipo di memoria.
+     * @param bytes La dimensione, positiva se allocata e negativa se liberata.
+     */
+    void trackDeviceMemory(uint32_t memoryType, int64_t bytes);
+
+    /**
+     * @brief Controlla, prima di vkAllocateMemory, se l'allocazione rientra nel budget del suo heap e stampa un avviso se non è così.
+     *
+     * Avvisa una volta quando l'heap supera il 90% del budget e una volta quando lo supera, poi di nuovo solo dopo essere sceso sotto.
+     *
+     * @param memoryType Il tipo di memoria dell'allocazione.
+     * @param bytes La dimensione dell'allocazione.
+     * @return false se l'allocazione supera il budget.
+     */
+    bool checkDeviceAllocation(uint32_t memoryType, VkDeviceSize bytes);
+
+    /**
+     * @brief Stampa l'uso della memoria per categoria e per heap.
+     * @param out Lo stream su cui stampare.
+     */
+    void printReport(std::ostream &out);
+
+    /**
+     * @brief Scrive l'uso della memoria per categoria e per heap in formato JSON.
+     * @param out Lo stream su cui scrivere.
+     */
+    void writeJson(std::ostream &out);
+
+    /**
+     * @brief Restituisce i byte delle risorse di una categoria.
+     * @param category La categoria.
+     * @return I byte delle risorse ancora vive.
+     */
+    VkDeviceSize getCategoryBytes(MemoryCategory category) const;
+
+private:
+    struct CategoryStats
+    {
+        VkDeviceSize bytes = 0;
+        VkDeviceSize peakBytes = 0;
+        uint32_t count = 0;
+    };
+
+    struct HeapStats
+    {
+        VkDeviceSize allocatedBytes = 0; // memoria chiesta al driver da questo programma
+        VkDeviceSize peakAllocatedBytes = 0;
+        VkDeviceSize usage = 0;          // uso dell'heap, dal driver se c'è VK_EXT_memory_budget
+        VkDeviceSize budget = 0;         // memoria che il programma può usare senza problemi
+        int warningLevel = 0;            // 0 nessun avviso, 1 vicino al budget, 2 oltre il budget
+    };
+
+    // aggiorna uso e budget di tutti gli heap
+    void updateBudgets();
+
+    VkPhysicalDevice physicalDevice;
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    CategoryStats categories[static_cast<int>(MemoryCategory::Count)];
+    HeapStats heaps[VK_MAX_MEMORY_HEAPS];
+};
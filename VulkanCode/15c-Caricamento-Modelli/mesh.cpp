@@ -1,16 +1,18 @@
 #include "texture.h"
 #include "bufferUtils.h"
 #include "mesh.h"
-#include "assimp/Importer.hpp" // Assimp Importer object
+#include "meshCache.h"
 #include <iostream>
+#include <filesystem>
 
 Mesh::Mesh(VkDevice device, VkPhysicalDevice physicalDevice,
-           VkCommandPool commandPool, VkQueue graphicsQueue,
+           VkCommandPool commandPool, VkQueue graphicsQueue, UploadBatch *uploadBatch,
            const std::vector<Vertex> &vertices,
            const std::vector<uint32_t> &indices) : device(device),
                                                    physicalDevice(physicalDevice),
                                                    commandPool(commandPool),
                                                    graphicsQueue(graphicsQueue),
+                                                   uploadBatch(uploadBatch),
                                                    vertices(vertices),
                                                    indices(indices)
 {
@@ -26,11 +28,9 @@ Mesh::Mesh(VkDevice device, VkPhysicalDevice physicalDevice,
 
 Mesh::~Mesh()
 {
-    vkDestroyBuffer(device, vertexBuffer, nullptr);    // distruggiamo il buffer dei vertici
-    vkFreeMemory(device, vertexBufferMemory, nullptr); // distruggiamo la memoria del buffer dei vertici
+    destroyBuffer(device, vertexBuffer, vertexBufferMemory); // distruggiamo il buffer dei vertici e la sua memoria
 
-    vkDestroyBuffer(device, indexBuffer, nullptr); // distruggiamo il buffer degli indici
-    vkFreeMemory(device, indexBufferMemory, nullptr); // distruggiamo la memoria del buffer degli indici
+    destroyBuffer(device, indexBuffer, indexBufferMemory); // distruggiamo il buffer degli indici e la sua memoria
 
     textures.clear(); // distruggiamo le texture
 }
@@ -74,33 +74,15 @@ void Mesh::setTextureIndex(std::string name, int index)
 // questa funzione ci permette di creare il vertex Buffer
 void Mesh::createVertexBuffer()
 {
-    
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size(); // la dimensione del buffer è la somma della dimensione di tutti i vertici
-
-    // per ottimizzare le prestazioni, usiamo un buffer di staging, che è un buffer temporaneo che viene usato per copiare i dati nella GPU, è come un ponte
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(device, physicalDevice, bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    // ora piazziamo i dati nel buffer di staging, poi successivamente verranno inseriti nel buffer finale
-    void *data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data); // mappiamo la memoria per poterci scrivere
-    // ora possiamo copiare i dati nel buffer, essendo che il buffer è un array di vertici, possiamo usare la funzione memcpy per copiare i dati
-    // però c'è un problema, i dati possono non essere inseriti immediatamente dentro il buffer, per esempio per colpa del caching e quindi essi potrebbero non essere visibili alla GPU
-    // per questo motivo ci sono 2 possibili fix, abbiamo scelto il primo, che è più veloce e semplice
-    //  1. usare un heap che sia coerente all'host, infatti abbiamo usato VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-    //  2. chiamare 2 funzioni: una vkFlushMappedMemoryRanges dopo la memcpy e una vkInvalidateMappedMemoryRanges prima di leggere i dati dalla memoria mappata
-    memcpy(data, vertices.data(), (size_t)bufferSize); // copiamo i dati nel buffer
-    vkUnmapMemory(device, stagingBufferMemory);        // unmapiamo la memoria per poterla usare
+    // convertiamo i vertici nel formato scelto, con il formato Full è una semplice copia
+    quantization = computeVertexQuantization(vertices, boundsMin, boundsMax, vertexLayout);
+    std::vector<uint8_t> vertexBytes = packVertices(vertices, vertexLayout, quantization);
+    VkDeviceSize bufferSize = vertexBytes.size(); // la dimensione del buffer è la somma della dimensione di tutti i vertici
 
     // creiamo il buffer finale, che è quello che verrà usato dalla GPU
-    createBuffer(device, physicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-    // ora possiamo copiare i dati dal buffer di staging al buffer finale, che è quello che verrà usato dalla GPU
-    copyBuffer(device, commandPool, graphicsQueue, stagingBuffer, vertexBuffer, bufferSize); // copiamo i dati dal buffer di staging al buffer finale
-
-    // e ora puliamo il buffer di staging, che non ci serve più
-    vkDestroyBuffer(device, stagingBuffer, nullptr);    // distruggiamo il buffer di staging
-    vkFreeMemory(device, stagingBufferMemory, nullptr); // distruggiamo la memoria del buffer di staging
+    // di solito la memoria device local non è accessibile dalla CPU, quindi i dati ci arrivano con una copia dal buffer di staging, che è come un ponte
+    // la copia viene solo registrata e inviata insieme agli altri caricamenti; se invece la memoria è anche host visible i dati vengono scritti direttamente (vedi uploadBatch.h)
+    uploadBatch->createDeviceBuffer(vertexBytes.data(), bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryCategory::Mesh, vertexBuffer, vertexBufferMemory);
 }
 
 // in caso di immagini più complesse, come un semplice rettangolo, formato da 2 triangoli, ci servirà un buffer di indici
@@ -110,123 +92,215 @@ void Mesh::createIndexBuffer()
 {
     VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(device, physicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    void *data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-
     // la differenza principale è che il buffer di indici deve essere creato con VK_BUFFER_USAGE_INDEX_BUFFER_BIT
-    createBuffer(device, physicalDevice, bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+    uploadBatch->createDeviceBuffer(indices.data(), bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, MemoryCategory::Mesh, indexBuffer, indexBufferMemory);
+}
 
-    copyBuffer(device, commandPool, graphicsQueue, stagingBuffer, indexBuffer, bufferSize);
+const std::vector<SubMesh> &Mesh::getSubMeshes() const
+{
+    return subMeshes; // ritorniamo i submesh
+}
+
+void Mesh::addSubMesh(uint32_t offset, uint32_t count, int texIdx)
+{
+    subMeshes.push_back({offset, count, texIdx}); // aggiungiamo il submesh
+    subMeshTextureFiles.push_back(""); // il submesh aggiunto a mano non ha un materiale
+}
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+const std::vector<std::string> &Mesh::getSubMeshTextureFiles() const
+{
+    return subMeshTextureFiles; // ritorniamo i percorsi delle texture dei submesh
 }
 
-void Mesh::setDescriptorSet(uint32_t frameIndex, VkDescriptorSet set)
+void Mesh::setSubMeshTextureIndex(const std::string &path, int index)
 {
-    if (descriptorSets.size() <= frameIndex)
+    // confrontiamo i percorsi normalizzati, così "models/boot/./d-1.png" e "models/boot/d-1.png" sono lo stesso file
+    std::filesystem::path texturePath = std::filesystem::path(path).lexically_normal();
+    for (size_t i = 0; i < subMeshes.size(); i++)
     {
-        descriptorSets.resize(frameIndex + 1); // se il frame index è maggiore della dimensione del vettore, lo ridimensioniamo
+        if (!subMeshTextureFiles[i].empty() && std::filesystem::path(subMeshTextureFiles[i]).lexically_normal() == texturePath)
+        {
+            subMeshes[i].textureIndex = index; // settiamo l'indice della texture del submesh
+        }
     }
-    descriptorSets[frameIndex] = set; // settiamo il descriptor set per il frame corrente
 }
 
-VkDescriptorSet Mesh::getDescriptorSet(uint32_t frameIndex) const
+glm::vec3 Mesh::getBoundsMin() const
 {
-    return descriptorSets[frameIndex]; // ritorniamo il descriptor set per il frame corrente
+    return boundsMin;
 }
 
-const std::vector<SubMesh> &Mesh::getSubMeshes() const
+glm::vec3 Mesh::getBoundsMax() const
 {
-    return subMeshes; // ritorniamo i submesh
+    return boundsMax;
 }
 
-void Mesh::addSubMesh(uint32_t offset, uint32_t count, int texIdx)
+VertexLayout Mesh::getVertexLayout() const
 {
-    subMeshes.push_back({offset, count, texIdx}); // aggiungiamo il submesh
+    return vertexLayout;
 }
 
-void Mesh::loadFromFile(const std::string &filename, unsigned int flags)
+VkDeviceSize Mesh::getVertexBufferSize() const
 {
-    Assimp::Importer importer;
-    const aiScene *scene = importer.ReadFile(filename, flags);
+    return static_cast<VkDeviceSize>(vertices.size() * vertexStride(vertexLayout));
+}
+
+uint32_t Mesh::getLodCount() const
+{
+    return static_cast<uint32_t>(lods.size()) + 1;
+}
 
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+size_t Mesh::getTriangleCount(uint32_t lod) const
+{
+    if (subMeshes.empty())
     {
-        std::cerr << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
-        return;
+        return (getIndexCount() > 0 ? getIndexCount() : getVertexCount()) / 3;
     }
-    // Assimp ci da la possibilità di caricare più mesh, ma noi ne consideriamo solo una
-    const aiMesh *mesh = scene->mMeshes[0];
-    vertices.resize(mesh->mNumVertices);
-    indices.resize(mesh->mNumFaces * 3); // ogni faccia ha 3 indici
+    // gli indici dei livelli semplificati sono in fondo allo stesso buffer, quindi contiamo solo quelli degli intervalli disegnati
+    const std::vector<SubMesh> &ranges = lod > 0 && lod <= lods.size() ? lods[lod - 1].ranges : subMeshes;
+    size_t count = 0;
+    for (const SubMesh &range : ranges)
+    {
+        count += range.indexCount;
+    }
+    return count / 3;
+}
 
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+bool Mesh::hasMeshlets() const
+{
+    return !meshlets.empty();
+}
+
+uint32_t Mesh::selectLod(const glm::mat4 &model, const glm::vec3 &cameraPos, float projectionScale, float maxPixelError) const
+{
+    if (lods.empty())
     {
-        vertices[i].pos = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
-        vertices[i].normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
-        if (mesh->HasTextureCoords(0))
-        {
-            vertices[i].texCoord = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
-        }
-        else
-        {
-            vertices[i].texCoord = glm::vec2(0.0f, 0.0f);
-        }
+        return 0;
+    }
+    // la scala della mesh è la lunghezza massima delle colonne della parte 3x3 della matrice
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    glm::vec3 center = glm::vec3(model * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+    float radius = glm::length(boundsMax - boundsMin) * 0.5f * scale;
+    float distance = glm::length(center - cameraPos) - radius; // distanza dal punto più vicino della sfera che contiene la mesh
+    if (distance <= 0.0f)
+    {
+        return 0; // la camera è dentro la mesh o appoggiata su di essa
+    }
+    // quanti pixel occupa un'unità del modello a quella distanza
+    float pixelsPerUnit = projectionScale * scale / distance;
+    uint32_t lod = 0;
+    while (lod < lods.size() && lods[lod].error * pixelsPerUnit <= maxPixelError)
+    {
+        lod++;
     }
+    return lod;
+}
 
-    for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+void Mesh::loadFromFile(const std::string &filename, unsigned int flags, const MeshLoadOptions &options, VertexLayout layout)
+{
+    MeshData data;
+    if (!loadOrImportMeshData(filename, flags, data, options))
     {
-        const aiFace &face = mesh->mFaces[i];
-        indices[i * 3] = face.mIndices[0];
-        indices[i * 3 + 1] = face.mIndices[1];
-        indices[i * 3 + 2] = face.mIndices[2];
+        return;
     }
+    setMeshData(std::move(data), layout);
+}
+
+void Mesh::setMeshData(MeshData &&data, VertexLayout layout)
+{
+    vertexLayout = layout;
+    vertices = std::move(data.vertices);
+    indices = std::move(data.indices);
+    subMeshes = std::move(data.subMeshes);
+    subMeshTextureFiles = std::move(data.textureFiles);
+    subMeshTextureFiles.resize(subMeshes.size());
+    boundsMin = data.boundsMin;
+    boundsMax = data.boundsMax;
+    lods = std::move(data.lods);
+    meshlets = std::move(data.meshlets);
     createVertexBuffer();
     createIndexBuffer();
 }
 
-void Mesh::draw(VkCommandBuffer cmd, uint32_t frameIndex,
-                VkPipelineLayout pipelineLayout,
-                std::function<void()> updateUniformCallback)
+size_t Mesh::draw(VkCommandBuffer cmd, VkPipelineLayout pipelineLayout, uint32_t objectIndex,
+                  uint32_t lod, const MeshletCulling *culling, uint32_t instanceCount)
 {
+    size_t drawnIndices = 0;
     VkBuffer vb = getVertexBuffer();
     VkDeviceSize offsets[] = {0};
     vkCmdBindVertexBuffers(cmd, 0, 1, &vb, offsets);
 
-    VkDescriptorSet descriptorSet = getDescriptorSet(frameIndex);
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
     bool hasIndexBuffer = getIndexCount() > 0;
     if (hasIndexBuffer)
     {
         vkCmdBindIndexBuffer(cmd, getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
     }
+    // scala e offset per decodificare i vertici compressi, sono gli stessi per tutte le sub-mesh
+    vkCmdPushConstants(cmd, pipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT,
+                       VERTEX_PUSH_CONSTANT_OFFSET, sizeof(VertexQuantization), &quantization);
 
+    // i meshlet esistono solo per il modello completo, e il culling è calcolato nello spazio di una sola copia
+    bool cullMeshlets = culling != nullptr && instanceCount == 1 && lod == 0 && !meshlets.empty() && hasIndexBuffer;
+    size_t meshletIndex = 0;
     if (!subMeshes.empty())
     {
         for (uint32_t i = 0; i < subMeshes.size(); ++i)
         {
             const auto &sub = subMeshes[i];
-            uint32_t index = static_cast<uint32_t>(sub.textureIndex);
+            // a un livello di dettaglio semplificato cambia solo l'intervallo di indici, la texture resta quella della sub-mesh
+            const SubMesh &range = lod > 0 && lod <= lods.size() ? lods[lod - 1].ranges[i] : sub;
+            if (range.indexCount == 0)
+            {
+                continue;
+            }
+            // le sub-mesh senza una texture propria usano quella della mesh
+            uint32_t index = static_cast<uint32_t>(sub.textureIndex >= 0 ? sub.textureIndex : textures.begin()->second);
             // questo mi permette di passare l'indice della texture alla shader
             vkCmdPushConstants(cmd, pipelineLayout,
                                VK_SHADER_STAGE_FRAGMENT_BIT,
                                0, sizeof(uint32_t), &index);
-            updateUniformCallback(); // aggiorna ubo con il textureIndex giusto
-            if (hasIndexBuffer)
+            if (cullMeshlets)
+            {
+                // i meshlet della sub-mesh sono contigui e coprono esattamente il suo intervallo di indici,
+                // quelli visibili uno dopo l'altro diventano un unico intervallo
+                uint32_t end = range.indexOffset + range.indexCount;
+                uint32_t runOffset = range.indexOffset;
+                uint32_t runCount = 0;
+                for (; meshletIndex < meshlets.size() && meshlets[meshletIndex].indexOffset < end; meshletIndex++)
+                {
+                    const Meshlet &meshlet = meshlets[meshletIndex];
+                    if (isMeshletVisible(meshlet, *culling))
+                    {
+                        if (runCount == 0)
+                        {
+                            runOffset = meshlet.indexOffset;
+                        }
+                        runCount += meshlet.indexCount;
+                        continue;
+                    }
+                    if (runCount > 0)
+                    {
+                        vkCmdDrawIndexed(cmd, runCount, instanceCount, runOffset, 0, objectIndex);
+                        drawnIndices += runCount;
+                        runCount = 0;
+                    }
+                }
+                if (runCount > 0)
+                {
+                    vkCmdDrawIndexed(cmd, runCount, instanceCount, runOffset, 0, objectIndex);
+                    drawnIndices += runCount;
+                }
+            }
+            else if (hasIndexBuffer)
             {
-                vkCmdDrawIndexed(cmd, sub.indexCount, 1, sub.indexOffset, 0, 0);
+                vkCmdDrawIndexed(cmd, range.indexCount, instanceCount, range.indexOffset, 0, objectIndex);
+                drawnIndices += range.indexCount;
             }
             else
             {
-                vkCmdDraw(cmd, sub.indexCount, 1, sub.indexOffset, 0);
+                vkCmdDraw(cmd, range.indexCount, instanceCount, range.indexOffset, objectIndex);
+                drawnIndices += range.indexCount;
             }
         }
     }
@@ -237,14 +311,16 @@ void Mesh::draw(VkCommandBuffer cmd, uint32_t frameIndex,
         vkCmdPushConstants(cmd, pipelineLayout,
                            VK_SHADER_STAGE_FRAGMENT_BIT,
                            0, sizeof(uint32_t), &index);
-        updateUniformCallback(); // se non ci sono submesh, usa quello principale
         if (hasIndexBuffer)
         {
-            vkCmdDrawIndexed(cmd, getIndexCount(), 1, 0, 0, 0);
+            vkCmdDrawIndexed(cmd, getIndexCount(), instanceCount, 0, 0, objectIndex);
+            drawnIndices += getIndexCount();
         }
         else
         {
-            vkCmdDraw(cmd, getVertexCount(), 1, 0, 0);
+            vkCmdDraw(cmd, getVertexCount(), instanceCount, 0, objectIndex);
+            drawnIndices += getVertexCount();
         }
     }
+    return drawnIndices / 3 * instanceCount;
 }
\ No newline at end of file
@@ -5,24 +5,16 @@
 #include <array>
 #include <map>
 #include <string>
-#include <functional>
 #include "assimp/scene.h"       // Assimp output data structure
 #include "assimp/postprocess.h" // Assimp post processing flags
+#include "bufferUtils.h"
+#include "meshData.h"
+#include "meshCache.h"
+#include "vertexFormat.h"
+#include "meshlet.h"
+#include "uploadBatch.h"
 class Texture;
 
-/**
- * @brief Struttura per rappresentare un vertice del modello 3D.
- */
-struct SubMesh
-{
-    uint32_t indexOffset;
-    uint32_t indexCount;
-    int textureIndex; // indice nel global texture array
-
-    SubMesh(uint32_t offset, uint32_t count, int texIdx)
-        : indexOffset(offset), indexCount(count), textureIndex(texIdx) {}
-};
-
 class Mesh
 {
 public:
@@ -35,11 +27,12 @@ public:
      * @param physicalDevice Il dispositivo fisico Vulkan.
      * @param commandPool Il command pool per le operazioni di copia.
      * @param graphicsQueue La coda grafica per l'esecuzione dei comandi.
+     * @param uploadBatch Il batch in cui vengono registrate le copie dei vertici e degli indici.
      * @param vertices I vertici del modello 3D.
      * @param indices Gli indici del modello 3D.
      */
     Mesh(VkDevice device, VkPhysicalDevice physicalDevice,
-         VkCommandPool commandPool, VkQueue graphicsQueue,
+         VkCommandPool commandPool, VkQueue graphicsQueue, UploadBatch *uploadBatch,
          const std::vector<Vertex> &vertices = {},
          const std::vector<uint32_t> &indices = {});
 
@@ -95,20 +88,6 @@ public:
      */
     void setTextureIndex(std::string name, int index);
 
-    /**
-     * @brief Imposta il set di descrittori per un frame specifico.
-     * @param frameIndex L'indice del frame.
-     * @param set Il set di descrittori da impostare.
-     */
-    void setDescriptorSet(uint32_t frameIndex, VkDescriptorSet set);
-
-    /**
-     * @brief Restituisce il set di descrittori per un frame specifico.
-     * @param frameIndex L'indice del frame.
-     * @return Il set di descrittori per il frame specificato.
-     */
-    VkDescriptorSet getDescriptorSet(uint32_t frameIndex) const;
-
     /**
      * @brief Restituisce i sub-mesh della mesh.
      * @return Un vettore di sub-mesh.
@@ -125,25 +104,127 @@ public:
     void addSubMesh(uint32_t offset, uint32_t count, int texIdx);
 
     /**
-     * @brief Carica un modello 3D da un file utilizzando Assimp.
+     * @brief Restituisce i percorsi delle texture diffuse dei materiali delle sub-mesh.
+     * @return Un vettore con un percorso per ogni sub-mesh, vuoto se la sub-mesh non ha una texture.
+     */
+    const std::vector<std::string> &getSubMeshTextureFiles() const;
+
+    /**
+     * @brief Imposta l'indice della texture di tutte le sub-mesh il cui materiale usa il file indicato.
+     *
+     * Come per setTextureIndex, se nessuna sub-mesh usa quel file non succede nulla.
+     *
+     * @param path Il percorso del file della texture.
+     * @param index L'indice della texture nel global texture array.
+     */
+    void setSubMeshTextureIndex(const std::string &path, int index);
+
+    /**
+     * @brief Restituisce l'angolo minimo del bounding box del modello.
+     * @return Il vertice con le coordinate minime.
+     */
+    glm::vec3 getBoundsMin() const;
+
+    /**
+     * @brief Restituisce l'angolo massimo del bounding box del modello.
+     * @return Il vertice con le coordinate massime.
+     */
+    glm::vec3 getBoundsMax() const;
+
+    /**
+     * @brief Restituisce il formato dei vertici nel vertex buffer.
+     * @return Il formato scelto in setMeshData.
+     */
+    VertexLayout getVertexLayout() const;
+
+    /**
+     * @brief Restituisce la dimensione del vertex buffer sulla GPU.
+     * @return La dimensione in byte.
+     */
+    VkDeviceSize getVertexBufferSize() const;
+
+    /**
+     * @brief Restituisce il numero di livelli di dettaglio della mesh, compreso quello completo.
+     * @return Il numero di livelli, 1 se la mesh non ha livelli semplificati.
+     */
+    uint32_t getLodCount() const;
+
+    /**
+     * @brief Restituisce il numero di triangoli disegnati a un livello di dettaglio.
+     * @param lod Il livello di dettaglio, 0 è il modello completo.
+     * @return Il numero di triangoli.
+     */
+    size_t getTriangleCount(uint32_t lod = 0) const;
+
+    /**
+     * @brief Indica se il modello completo è diviso in meshlet (vedi meshlet.h).
+     * @return true se draw può scartare i meshlet non visibili.
+     */
+    bool hasMeshlets() const;
+
+    /**
+     * @brief Sceglie il livello di dettaglio in base alla dimensione della mesh sullo schermo.
+     *
+     * Il bounding box trasformato dà la distanza dalla camera e la scala della mesh, da cui si ricava quanti pixel occupa un'unità del modello.
+     * Viene scelto il livello più semplice il cui errore, proiettato sullo schermo, non supera maxPixelError.
+     *
+     * @param model La matrice di trasformazione della mesh.
+     * @param cameraPos La posizione della camera.
+     * @param projectionScale L'altezza in pixel dello schermo divisa per 2 * tan(fov / 2).
+     * @param maxPixelError L'errore massimo ammesso, in pixel.
+     * @return Il livello di dettaglio da passare a draw.
+     */
+    uint32_t selectLod(const glm::mat4 &model, const glm::vec3 &cameraPos, float projectionScale, float maxPixelError) const;
+
+    /**
+     * @brief Carica un modello 3D da un file utilizzando Assimp o il parser OBJ.
+     *
+     * Se accanto al modello esiste una cache binaria valida (vedi meshCache.h) i dati vengono letti da lì,
+     * altrimenti il modello viene importato con Assimp e la cache viene riscritta.
      *
      * @param filename Il percorso del file del modello.
      * @param flags I flag di post-elaborazione da utilizzare con Assimp.
+     * @param options Le opzioni di caricamento (cache, lettore e ottimizzazioni).
+     * @param layout Il formato dei vertici nel vertex buffer.
      * @throws std::runtime_error Se si verifica un errore durante il caricamento del modello.
      */
-    void loadFromFile(const std::string &filename, unsigned int flags = aiProcess_FlipUVs);
+    void loadFromFile(const std::string &filename, unsigned int flags = aiProcess_FlipUVs, const MeshLoadOptions &options = MeshLoadOptions(),
+                      VertexLayout layout = VertexLayout::Full);
+
+    /**
+     * @brief Imposta i dati del modello già caricati sulla CPU e crea i buffer Vulkan.
+     *
+     * È la seconda metà di loadFromFile: permette di importare i modelli su altri thread (vedi loadOrImportMeshData)
+     * e di fare solo il caricamento sulla GPU sul thread che possiede il command pool e la coda.
+     *
+     * I vertici vengono convertiti nel formato indicato solo al momento della copia nel vertex buffer,
+     * quindi la cache e i vertici tenuti sulla CPU restano sempre in Vertex.
+     *
+     * @param data I dati del modello, che vengono spostati dentro la mesh.
+     * @param layout Il formato dei vertici nel vertex buffer, deve essere lo stesso usato per creare la pipeline.
+     */
+    void setMeshData(MeshData &&data, VertexLayout layout = VertexLayout::Full);
 
     /**
      * @brief Disegna la mesh utilizzando un comando di disegno Vulkan.
      *
+     * Se viene disegnato il modello completo di una mesh divisa in meshlet e culling non è nullptr,
+     * i meshlet non visibili vengono scartati e quelli visibili consecutivi vengono uniti in un solo comando di disegno.
+     * Il set 0, con i dati del frame e l'array degli oggetti, deve essere già collegato da chi chiama.
+     * Con instanceCount maggiore di 1 tutte le copie vengono disegnate con un solo comando di disegno per sub-mesh:
+     * la copia i usa l'elemento objectIndex + i dello storage buffer degli oggetti (vedi ObjectBuffer::addInstances),
+     * e i meshlet non vengono scartati perché la visibilità cambia da copia a copia.
+     *
      * @param cmd Il comando di disegno Vulkan.
-     * @param frameIndex L'indice del frame corrente.
      * @param pipelineLayout Il layout della pipeline Vulkan.
-     * @param updateUniformCallback Una funzione di callback per aggiornare i dati uniformi.
+     * @param objectIndex L'indice dell'oggetto nello storage buffer degli oggetti (vedi ObjectBuffer::add), passato come firstInstance.
+     * @param lod Il livello di dettaglio da disegnare, 0 è il modello completo (vedi selectLod).
+     * @param culling I dati per scartare i meshlet preparati con makeMeshletCulling, nullptr per disegnarli tutti.
+     * @param instanceCount Il numero di copie da disegnare, con gli oggetti consecutivi a partire da objectIndex.
+     * @return Il numero di triangoli effettivamente disegnati, sommando tutte le copie.
      */
-    void draw(VkCommandBuffer cmd, uint32_t frameIndex,
-              VkPipelineLayout pipelineLayout,
-              std::function<void()> updateUniformCallback);
+    size_t draw(VkCommandBuffer cmd, VkPipelineLayout pipelineLayout, uint32_t objectIndex,
+                uint32_t lod = 0, const MeshletCulling *culling = nullptr, uint32_t instanceCount = 1);
 
 private:
     /**
@@ -160,18 +241,24 @@ private:
     VkPhysicalDevice physicalDevice;
     VkCommandPool commandPool;
     VkQueue graphicsQueue;
+    UploadBatch *uploadBatch;
 
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    VertexLayout vertexLayout = VertexLayout::Full;
+    VertexQuantization quantization; // passati alla vertex shader per decodificare i vertici compressi
 
-    VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
+    VkBuffer vertexBuffer = VK_NULL_HANDLE; // resta nullo se il modello non è stato caricato
+    DeviceAllocation vertexBufferMemory;
 
-    VkBuffer indexBuffer;
-    VkDeviceMemory indexBufferMemory;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    DeviceAllocation indexBufferMemory;
 
     std::map<std::string, int> textures; // mappa di puntatori a texture index - texture
     std::vector<SubMesh> subMeshes;
-
-    std::vector<VkDescriptorSet> descriptorSets;
+    std::vector<std::string> subMeshTextureFiles; // percorso della texture del materiale di ogni sub-mesh
+    std::vector<MeshLod> lods;                     // livelli di dettaglio semplificati, i loro indici sono nello stesso index buffer
+    std::vector<Meshlet> meshlets;                 // meshlet del modello completo, in ordine di sub-mesh
 };
\ No newline at end of file
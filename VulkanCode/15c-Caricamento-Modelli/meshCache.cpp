@@ -0,0 +1,436 @@
+#include "meshCache.h"
+#include "meshSimplifier.h"
+#include "meshlet.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// intestazione del file di cache, subito dopo seguono nell'ordine: vertici, indici, sub-mesh, livelli di dettaglio, meshlet e percorsi delle texture delle sub-mesh
+struct MeshCacheHeader
+{
+    char magic[4];         // "MSHC"
+    uint32_t version;      // MESH_CACHE_VERSION
+    uint32_t importFlags;  // flag di Assimp con cui è stato importato il modello
+    uint32_t vertexStride; // sizeof(Vertex), così ci accorgiamo se la struttura cambia
+    uint64_t sourceSize;   // dimensione del file sorgente
+    int64_t sourceMtime;   // data di ultima modifica del file sorgente
+    uint64_t sourceHash;   // hash FNV-1a del contenuto del file sorgente
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t subMeshCount;
+    uint32_t importer; // MeshImporter usato per leggere il modello
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t textureBytes; // dimensione totale dei percorsi delle texture, ognuno salvato come lunghezza a 32 bit seguita dai caratteri
+    uint32_t optimizations; // MeshOptimizeFlags applicati dopo l'importazione
+    uint32_t lodLevels;     // numero di livelli di dettaglio richiesti
+    uint32_t lodCount;      // numero di livelli di dettaglio salvati, ognuno come errore (float) seguito da un intervallo per sub-mesh
+    uint32_t buildMeshlets; // 1 se il modello è stato diviso in meshlet
+    uint32_t meshletCount;  // numero di meshlet, salvati così come sono in memoria
+};
+
+// ogni sub-mesh viene salvata come 3 interi a 32 bit
+struct MeshCacheSubMesh
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    int32_t textureIndex;
+};
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string &path)
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    mapped = static_cast<const uint8_t *>(view);
+    mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(file, &st) != 0 || st.st_size == 0)
+    {
+        ::close(file);
+        return false;
+    }
+    void *view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    if (view == MAP_FAILED)
+    {
+        ::close(file);
+        return false;
+    }
+    fd = file;
+    mapped = static_cast<const uint8_t *>(view);
+    mappedSize = static_cast<size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (!mapped)
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(mapped);
+    CloseHandle(static_cast<HANDLE>(mappingHandle));
+    CloseHandle(static_cast<HANDLE>(fileHandle));
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(const_cast<uint8_t *>(mapped), mappedSize);
+    ::close(fd);
+    fd = -1;
+#endif
+    mapped = nullptr;
+    mappedSize = 0;
+}
+
+const uint8_t *MappedFile::data() const
+{
+    return mapped;
+}
+
+size_t MappedFile::size() const
+{
+    return mappedSize;
+}
+
+// hash FNV-1a a 64 bit, semplice e abbastanza veloce per accorgersi se il file sorgente è cambiato
+static uint64_t hashBytes(const uint8_t *data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// legge dimensione, data di modifica e (solo se richiesto) hash del file sorgente
+static bool sourceInfo(const std::string &sourcePath, bool withHash,
+                       uint64_t &size, int64_t &mtime, uint64_t &hash)
+{
+    std::error_code ec;
+    size = static_cast<uint64_t>(fs::file_size(sourcePath, ec));
+    if (ec)
+    {
+        return false;
+    }
+    mtime = static_cast<int64_t>(fs::last_write_time(sourcePath, ec).time_since_epoch().count());
+    if (ec)
+    {
+        return false;
+    }
+    hash = 0;
+    if (withHash)
+    {
+        MappedFile source;
+        if (!source.open(sourcePath))
+        {
+            return false;
+        }
+        hash = hashBytes(source.data(), source.size());
+    }
+    return true;
+}
+
+std::string meshCachePath(const std::string &sourcePath)
+{
+    return sourcePath + ".meshcache";
+}
+
+bool loadMeshCache(const std::string &sourcePath, unsigned int flags, MeshData &out, const MeshLoadOptions &options)
+{
+    MappedFile cache;
+    if (!cache.open(meshCachePath(sourcePath)) || cache.size() < sizeof(MeshCacheHeader))
+    {
+        return false;
+    }
+
+    MeshCacheHeader header;
+    memcpy(&header, cache.data(), sizeof(header));
+    if (memcmp(header.magic, "MSHC", 4) != 0 || header.version != MESH_CACHE_VERSION ||
+        header.importFlags != flags || header.vertexStride != sizeof(Vertex) || header.importer != static_cast<uint32_t>(options.importer) ||
+        header.optimizations != options.optimizations || header.lodLevels != options.lodLevels ||
+        header.buildMeshlets != (options.buildMeshlets ? 1u : 0u))
+    {
+        return false;
+    }
+
+    size_t vertexBytes = static_cast<size_t>(header.vertexCount) * sizeof(Vertex);
+    size_t indexBytes = static_cast<size_t>(header.indexCount) * sizeof(uint32_t);
+    size_t subMeshBytes = static_cast<size_t>(header.subMeshCount) * sizeof(MeshCacheSubMesh);
+    // un modello senza sub-mesh ha comunque un intervallo per livello
+    size_t lodRangeCount = std::max<size_t>(header.subMeshCount, 1);
+    size_t lodBytes = static_cast<size_t>(header.lodCount) * (sizeof(float) + lodRangeCount * sizeof(MeshCacheSubMesh));
+    size_t meshletBytes = static_cast<size_t>(header.meshletCount) * sizeof(Meshlet);
+    if (cache.size() != sizeof(MeshCacheHeader) + vertexBytes + indexBytes + subMeshBytes + lodBytes + meshletBytes + header.textureBytes)
+    {
+        return false; // file troncato o corrotto
+    }
+
+    // prima controlliamo dimensione e data di modifica, che costano poco
+    uint64_t size, hash;
+    int64_t mtime;
+    if (!sourceInfo(sourcePath, false, size, mtime, hash) || size != header.sourceSize)
+    {
+        return false;
+    }
+    bool refresh = false;
+    if (mtime != header.sourceMtime)
+    {
+        // la data è cambiata (per esempio dopo un checkout), ma il contenuto potrebbe essere lo stesso
+        if (!sourceInfo(sourcePath, true, size, mtime, hash) || hash != header.sourceHash)
+        {
+            return false;
+        }
+        refresh = true;
+    }
+
+    // i dati sono già nel formato finale, quindi basta copiarli dalla memoria mappata
+    const uint8_t *ptr = cache.data() + sizeof(MeshCacheHeader);
+    const Vertex *vertices = reinterpret_cast<const Vertex *>(ptr);
+    out.vertices.assign(vertices, vertices + header.vertexCount);
+    ptr += vertexBytes;
+    const uint32_t *indices = reinterpret_cast<const uint32_t *>(ptr);
+    out.indices.assign(indices, indices + header.indexCount);
+    ptr += indexBytes;
+    for (uint32_t index : out.indices)
+    {
+        if (index >= header.vertexCount)
+        {
+            return false; // un indice fuori dai vertici leggerebbe memoria non valida sulla GPU
+        }
+    }
+    out.subMeshes.clear();
+    out.subMeshes.reserve(header.subMeshCount);
+    for (uint32_t i = 0; i < header.subMeshCount; i++)
+    {
+        MeshCacheSubMesh sub;
+        memcpy(&sub, ptr + i * sizeof(MeshCacheSubMesh), sizeof(sub));
+        if (static_cast<uint64_t>(sub.indexOffset) + sub.indexCount > header.indexCount)
+        {
+            return false;
+        }
+        out.subMeshes.emplace_back(sub.indexOffset, sub.indexCount, sub.textureIndex);
+    }
+    ptr += subMeshBytes;
+    out.lods.clear();
+    out.lods.resize(header.lodCount);
+    for (MeshLod &lod : out.lods)
+    {
+        memcpy(&lod.error, ptr, sizeof(float));
+        ptr += sizeof(float);
+        lod.ranges.reserve(lodRangeCount);
+        for (size_t i = 0; i < lodRangeCount; i++)
+        {
+            MeshCacheSubMesh range;
+            memcpy(&range, ptr, sizeof(range));
+            ptr += sizeof(range);
+            if (static_cast<uint64_t>(range.indexOffset) + range.indexCount > header.indexCount)
+            {
+                return false;
+            }
+            lod.ranges.emplace_back(range.indexOffset, range.indexCount, range.textureIndex);
+        }
+    }
+    out.meshlets.resize(header.meshletCount);
+    if (meshletBytes > 0)
+    {
+        memcpy(out.meshlets.data(), ptr, meshletBytes);
+    }
+    ptr += meshletBytes;
+    for (const Meshlet &meshlet : out.meshlets)
+    {
+        if (static_cast<uint64_t>(meshlet.indexOffset) + meshlet.indexCount > header.indexCount)
+        {
+            return false;
+        }
+    }
+    const uint8_t *texturesEnd = ptr + header.textureBytes;
+    out.textureFiles.clear();
+    while (ptr < texturesEnd)
+    {
+        uint32_t length;
+        if (texturesEnd - ptr < 4)
+        {
+            return false;
+        }
+        memcpy(&length, ptr, sizeof(length));
+        ptr += sizeof(length);
+        if (static_cast<size_t>(texturesEnd - ptr) < length)
+        {
+            return false;
+        }
+        out.textureFiles.emplace_back(reinterpret_cast<const char *>(ptr), length);
+        ptr += length;
+    }
+    out.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    out.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+
+    cache.close();
+    if (refresh)
+    {
+        saveMeshCache(sourcePath, flags, out, options); // aggiorniamo la data così la prossima volta non serve ricalcolare l'hash
+    }
+    return true;
+}
+
+bool saveMeshCache(const std::string &sourcePath, unsigned int flags, const MeshData &data, const MeshLoadOptions &options)
+{
+    MeshCacheHeader header{};
+    memcpy(header.magic, "MSHC", 4);
+    header.version = MESH_CACHE_VERSION;
+    header.importFlags = flags;
+    header.vertexStride = sizeof(Vertex);
+    if (!sourceInfo(sourcePath, true, header.sourceSize, header.sourceMtime, header.sourceHash))
+    {
+        return false;
+    }
+    header.vertexCount = static_cast<uint32_t>(data.vertices.size());
+    header.indexCount = static_cast<uint32_t>(data.indices.size());
+    header.subMeshCount = static_cast<uint32_t>(data.subMeshes.size());
+    header.importer = static_cast<uint32_t>(options.importer);
+    header.optimizations = options.optimizations;
+    header.lodLevels = options.lodLevels;
+    header.lodCount = static_cast<uint32_t>(data.lods.size());
+    header.buildMeshlets = options.buildMeshlets ? 1u : 0u;
+    header.meshletCount = static_cast<uint32_t>(data.meshlets.size());
+    for (const std::string &texture : data.textureFiles)
+    {
+        header.textureBytes += static_cast<uint32_t>(sizeof(uint32_t) + texture.size());
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        header.boundsMin[i] = data.boundsMin[i];
+        header.boundsMax[i] = data.boundsMax[i];
+    }
+
+    // scriviamo prima su un file temporaneo e poi lo rinominiamo, così un'interruzione non lascia una cache a metà
+    std::string path = meshCachePath(sourcePath);
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            std::cerr << "impossibile scrivere la cache " << path << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(data.vertices.data()), data.vertices.size() * sizeof(Vertex));
+        file.write(reinterpret_cast<const char *>(data.indices.data()), data.indices.size() * sizeof(uint32_t));
+        for (const SubMesh &sub : data.subMeshes)
+        {
+            MeshCacheSubMesh raw{sub.indexOffset, sub.indexCount, sub.textureIndex};
+            file.write(reinterpret_cast<const char *>(&raw), sizeof(raw));
+        }
+        for (const MeshLod &lod : data.lods)
+        {
+            file.write(reinterpret_cast<const char *>(&lod.error), sizeof(float));
+            for (const SubMesh &range : lod.ranges)
+            {
+                MeshCacheSubMesh raw{range.indexOffset, range.indexCount, range.textureIndex};
+                file.write(reinterpret_cast<const char *>(&raw), sizeof(raw));
+            }
+        }
+        file.write(reinterpret_cast<const char *>(data.meshlets.data()), data.meshlets.size() * sizeof(Meshlet));
+        for (const std::string &texture : data.textureFiles)
+        {
+            uint32_t length = static_cast<uint32_t>(texture.size());
+            file.write(reinterpret_cast<const char *>(&length), sizeof(length));
+            file.write(texture.data(), length);
+        }
+        if (!file.good())
+        {
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmpPath, path, ec);
+    if (ec)
+    {
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool loadOrImportMeshData(const std::string &sourcePath, unsigned int flags, MeshData &out, const MeshLoadOptions &options)
+{
+    // la cache contiene già vertici e indici nel formato finale e già ottimizzati, quindi evitiamo completamente l'importazione
+    if (options.useCache && loadMeshCache(sourcePath, flags, out, options))
+    {
+        return true;
+    }
+    if (!importMeshData(sourcePath, flags, out, options.importer))
+    {
+        return false;
+    }
+    if (options.optimizations != MeshOptimize_None)
+    {
+        optimizeMeshData(out, options.optimizations);
+    }
+    if (options.lodLevels > 0)
+    {
+        generateMeshLods(out, options.lodLevels, options.optimizations);
+    }
+    if (options.buildMeshlets)
+    {
+        buildMeshlets(out, options.optimizations); // dopo i livelli di dettaglio, che vanno generati dall'ordine originale dei triangoli
+    }
+    if (options.useCache)
+    {
+        saveMeshCache(sourcePath, flags, out, options); // la prossima volta il modello verrà letto dalla cache
+    }
+    return true;
+}
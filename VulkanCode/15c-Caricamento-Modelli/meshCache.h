@@ -0,0 +1,125 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "meshData.h"
+#include "meshOptimizer.h"
+
+/**
+ * @brief File mappato in memoria in sola lettura.
+ *
+ * Permette di leggere un file senza copiarlo prima in un buffer: il sistema operativo carica le pagine solo quando vengono lette.
+ * Su Windows usa CreateFileMapping, sugli altri sistemi mmap.
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /**
+     * @brief Mappa in memoria il file indicato.
+     *
+     * @param path Il percorso del file da mappare.
+     * @return true se il file è stato mappato, false altrimenti.
+     */
+    bool open(const std::string &path);
+
+    /**
+     * @brief Rilascia la mappatura e chiude il file.
+     */
+    void close();
+
+    /**
+     * @brief Restituisce il puntatore all'inizio del file mappato.
+     * @return Il puntatore ai dati, nullptr se il file non è aperto.
+     */
+    const uint8_t *data() const;
+
+    /**
+     * @brief Restituisce la dimensione del file mappato.
+     * @return La dimensione in byte.
+     */
+    size_t size() const;
+
+private:
+    const uint8_t *mapped = nullptr;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    void *fileHandle = nullptr;    // HANDLE del file
+    void *mappingHandle = nullptr; // HANDLE della mappatura
+#else
+    int fd = -1;
+#endif
+};
+
+/**
+ * @brief Versione del formato della cache, da incrementare ogni volta che cambia il layout del file o della struttura Vertex.
+ */
+const uint32_t MESH_CACHE_VERSION = 6;
+
+/**
+ * @brief Opzioni di caricamento di un modello.
+ *
+ * Tutto ciò che cambia i dati prodotti (lettore, ottimizzazioni, livelli di dettaglio e meshlet) fa parte della chiave della cache,
+ * quindi cambiare un'opzione invalida automaticamente la cache scritta con le opzioni precedenti.
+ */
+struct MeshLoadOptions
+{
+    bool useCache = true;                           // se false ignora la cache e importa sempre il modello
+    MeshImporter importer = MeshImporter::Assimp;   // il lettore da usare se il modello va importato
+    unsigned int optimizations = MeshOptimize_None; // combinazione di MeshOptimizeFlags da applicare dopo l'importazione
+    unsigned int lodLevels = 0;                     // numero massimo di livelli di dettaglio da generare (vedi meshSimplifier.h)
+    bool buildMeshlets = false;                     // se true il modello completo viene diviso in meshlet (vedi meshlet.h)
+};
+
+/**
+ * @brief Restituisce il percorso del file di cache associato a un modello.
+ *
+ * La cache viene salvata accanto al modello, con l'estensione ".meshcache" aggiunta al nome del file.
+ *
+ * @param sourcePath Il percorso del modello.
+ * @return Il percorso del file di cache.
+ */
+std::string meshCachePath(const std::string &sourcePath);
+
+/**
+ * @brief Carica un modello dalla cache binaria, se questa è valida.
+ *
+ * La cache è considerata valida se è stata scritta con la stessa versione del formato, con gli stessi flag di importazione, lo stesso lettore, le stesse ottimizzazioni, lo stesso numero di livelli di dettaglio e la stessa scelta sui meshlet,
+ * e se il file sorgente non è cambiato: prima si confrontano dimensione e data di modifica, e solo se queste non coincidono si confronta l'hash del contenuto.
+ *
+ * @param sourcePath Il percorso del modello originale.
+ * @param flags I flag di post-elaborazione usati per l'importazione.
+ * @param out I dati del modello letti dalla cache.
+ * @param options Le opzioni con cui è stato caricato il modello.
+ * @return true se la cache era valida e i dati sono stati letti, false se bisogna reimportare il modello.
+ */
+bool loadMeshCache(const std::string &sourcePath, unsigned int flags, MeshData &out, const MeshLoadOptions &options = MeshLoadOptions());
+
+/**
+ * @brief Scrive la cache binaria di un modello appena importato.
+ *
+ * @param sourcePath Il percorso del modello originale.
+ * @param flags I flag di post-elaborazione usati per l'importazione.
+ * @param data I dati del modello da salvare.
+ * @param options Le opzioni con cui è stato caricato il modello.
+ * @return true se la cache è stata scritta, false altrimenti.
+ */
+bool saveMeshCache(const std::string &sourcePath, unsigned int flags, const MeshData &data, const MeshLoadOptions &options = MeshLoadOptions());
+
+/**
+ * @brief Legge un modello dalla cache o, se la cache non è valida, lo importa, lo ottimizza, ne genera i livelli di dettaglio e i meshlet e riscrive la cache.
+ *
+ * Lavora solo sulla CPU, quindi può essere chiamata in parallelo da più thread su modelli diversi.
+ *
+ * @param sourcePath Il percorso del modello.
+ * @param flags I flag di post-elaborazione usati per l'importazione.
+ * @param out I dati del modello.
+ * @param options Le opzioni di caricamento.
+ * @return true se il modello è stato caricato, false se l'importazione è fallita.
+ */
+bool loadOrImportMeshData(const std::string &sourcePath, unsigned int flags, MeshData &out, const MeshLoadOptions &options = MeshLoadOptions());
@@ -0,0 +1,139 @@
+#include "meshData.h"
+#include "objParser.h"
+#include "assimp/Importer.hpp" // Assimp Importer object
+#include "assimp/scene.h"       // Assimp output data structure
+#include "assimp/postprocess.h" // Assimp post processing flags
+#include <iostream>
+#include <cctype>
+
+// controlla l'estensione del file senza distinguere maiuscole e minuscole
+static bool isObjFile(const std::string &filename)
+{
+    if (filename.size() < 4)
+    {
+        return false;
+    }
+    std::string extension = filename.substr(filename.size() - 4);
+    for (char &c : extension)
+    {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    return extension == ".obj";
+}
+
+static bool importWithAssimp(const std::string &filename, unsigned int flags, MeshData &out)
+{
+    Assimp::Importer importer;
+    const aiScene *scene = importer.ReadFile(filename, flags);
+
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+    {
+        std::cerr << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+        return false;
+    }
+    // una scena di Assimp può contenere più mesh (per esempio una per ogni materiale del file .obj)
+    // le concateniamo tutte in un unico buffer di vertici e di indici, e ogni aiMesh diventa una sub-mesh
+    // così il modello intero si disegna con un solo bind dei buffer e un draw indicizzato per ogni sub-mesh
+    size_t vertexCount = 0, indexCount = 0;
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+    {
+        vertexCount += scene->mMeshes[m]->mNumVertices;
+        indexCount += scene->mMeshes[m]->mNumFaces * 3;
+    }
+    out.vertices.clear();
+    out.indices.clear();
+    out.subMeshes.clear();
+    out.textureFiles.clear();
+    out.vertices.reserve(vertexCount);
+    out.indices.reserve(indexCount);
+
+    // i percorsi delle texture nei materiali sono relativi alla cartella del modello
+    size_t slash = filename.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? std::string() : filename.substr(0, slash + 1);
+
+    for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+    {
+        const aiMesh *mesh = scene->mMeshes[m];
+        uint32_t baseVertex = static_cast<uint32_t>(out.vertices.size());
+        uint32_t indexOffset = static_cast<uint32_t>(out.indices.size());
+
+        for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+        {
+            Vertex vertex{};
+            vertex.pos = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+            if (mesh->HasNormals())
+            {
+                vertex.normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+            }
+            else
+            {
+                vertex.normal = glm::vec3(0.0f, 0.0f, 0.0f);
+            }
+            if (mesh->HasTextureCoords(0))
+            {
+                vertex.texCoord = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+            }
+            else
+            {
+                vertex.texCoord = glm::vec2(0.0f, 0.0f);
+            }
+            out.vertices.push_back(vertex);
+        }
+
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            const aiFace &face = mesh->mFaces[i];
+            if (face.mNumIndices != 3)
+            {
+                continue; // punti e linee non li disegniamo
+            }
+            // gli indici di ogni aiMesh partono da 0, quindi vanno spostati dopo i vertici delle mesh precedenti
+            out.indices.push_back(baseVertex + face.mIndices[0]);
+            out.indices.push_back(baseVertex + face.mIndices[1]);
+            out.indices.push_back(baseVertex + face.mIndices[2]);
+        }
+
+        uint32_t subMeshIndexCount = static_cast<uint32_t>(out.indices.size()) - indexOffset;
+        if (subMeshIndexCount == 0)
+        {
+            continue;
+        }
+        // l'indice della texture verrà deciso dall'applicazione, qui salviamo solo il percorso della texture diffusa (map_Kd)
+        out.subMeshes.emplace_back(indexOffset, subMeshIndexCount, -1);
+        std::string texture;
+        aiString texturePath;
+        if (mesh->mMaterialIndex < scene->mNumMaterials &&
+            scene->mMaterials[mesh->mMaterialIndex]->GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) == aiReturn_SUCCESS &&
+            texturePath.C_Str()[0] != '*') // le texture che iniziano con "*" sono incorporate nel file, e non le gestiamo
+        {
+            texture = directory + texturePath.C_Str();
+        }
+        out.textureFiles.push_back(texture);
+    }
+    computeBounds(out);
+    return true;
+}
+
+bool importMeshData(const std::string &filename, unsigned int flags, MeshData &out, MeshImporter importer)
+{
+    if (importer == MeshImporter::NativeObj && isObjFile(filename))
+    {
+        return parseObjMeshData(filename, flags, out);
+    }
+    return importWithAssimp(filename, flags, out);
+}
+
+void computeBounds(MeshData &data)
+{
+    if (data.vertices.empty())
+    {
+        data.boundsMin = data.boundsMax = glm::vec3(0.0f);
+        return;
+    }
+    data.boundsMin = data.boundsMax = data.vertices[0].pos;
+    for (const Vertex &v : data.vertices)
+    {
+        data.boundsMin = glm::min(data.boundsMin, v.pos);
+        data.boundsMax = glm::max(data.boundsMax, v.pos);
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "bufferUtils.h"
+
+/**
+ * @brief Struttura per rappresentare una porzione (sub-mesh) del buffer degli indici.
+ */
+struct SubMesh
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    int textureIndex; // indice nel global texture array
+
+    SubMesh(uint32_t offset, uint32_t count, int texIdx)
+        : indexOffset(offset), indexCount(count), textureIndex(texIdx) {}
+};
+
+/**
+ * @brief Un livello di dettaglio (LOD) semplificato di un modello.
+ *
+ * Gli indici del livello stanno nello stesso buffer degli indici del modello completo, dopo quelli del livello precedente,
+ * e usano gli stessi vertici. ranges[i] è la sub-mesh i a questo livello: la texture resta quella di MeshData::subMeshes[i].
+ */
+struct MeshLod
+{
+    std::vector<SubMesh> ranges;
+    float error; // distanza massima, nelle unità del modello, tra la superficie semplificata e quella originale
+};
+
+/**
+ * @brief Un gruppo di triangoli vicini del modello completo, con i dati per scartarlo sulla CPU (vedi meshlet.h).
+ *
+ * I meshlet sono salvati nell'ordine delle sub-mesh e ognuno è un intervallo contiguo del buffer degli indici.
+ */
+struct Meshlet
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    glm::vec3 center; // centro della sfera che contiene il meshlet
+    float radius;
+    glm::vec3 coneAxis; // direzione media delle normali dei triangoli
+    float coneCutoff;   // coseno dell'angolo massimo tra le normali e coneAxis, <= 0 se il cono è troppo largo per essere usato
+};
+
+/**
+ * @brief Dati CPU di un modello già pronti per essere caricati sulla GPU.
+ *
+ * Contiene gli array finali di vertici e indici, le porzioni in cui è diviso il buffer degli indici e il bounding box del modello.
+ * È il risultato sia dell'importazione con Assimp sia della lettura della cache binaria.
+ */
+struct MeshData
+{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<SubMesh> subMeshes;
+    std::vector<std::string> textureFiles; // per ogni sub-mesh, il percorso della texture diffusa (map_Kd) del suo materiale, vuoto se non ce l'ha
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    std::vector<MeshLod> lods; // livelli di dettaglio dal più ricco al più povero, escluso il modello completo
+    std::vector<Meshlet> meshlets; // meshlet del modello completo, vuoto se non sono stati generati
+};
+
+/**
+ * @brief Il lettore da usare per importare i modelli.
+ */
+enum class MeshImporter
+{
+    Assimp,   // importatore generico di Assimp, legge qualunque formato
+    NativeObj // parser dedicato ai file .obj (vedi objParser.h), gli altri formati passano comunque da Assimp
+};
+
+/**
+ * @brief Importa un modello 3D da file utilizzando Assimp o il parser OBJ.
+ *
+ * Questa funzione lavora solo sulla CPU, quindi può essere usata anche senza un dispositivo Vulkan.
+ *
+ * @param filename Il percorso del file del modello.
+ * @param flags I flag di post-elaborazione da utilizzare con Assimp.
+ * @param out I dati del modello importato.
+ * @param importer Il lettore da usare.
+ * @return true se l'importazione è andata a buon fine, false altrimenti.
+ */
+bool importMeshData(const std::string &filename, unsigned int flags, MeshData &out, MeshImporter importer = MeshImporter::Assimp);
+
+/**
+ * @brief Calcola il bounding box allineato agli assi dei vertici.
+ *
+ * @param data I dati del modello, di cui vengono aggiornati boundsMin e boundsMax.
+ */
+void computeBounds(MeshData &data);
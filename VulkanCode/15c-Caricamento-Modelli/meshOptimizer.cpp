@@ -0,0 +1,361 @@
+#include "meshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // parametri dell'algoritmo di Forsyth, con i valori consigliati nell'articolo originale
+    const int FORSYTH_CACHE_SIZE = 32;        // dimensione della cache LRU simulata
+    const float FORSYTH_DECAY_POWER = 1.5f;   // quanto velocemente cala il punteggio man mano che il vertice scende nella cache
+    const float FORSYTH_LAST_TRIANGLE = 0.75f; // punteggio dei vertici dell'ultimo triangolo emesso (basso, per non riusarlo subito in strisce lunghe)
+    const float FORSYTH_VALENCE_SCALE = 2.0f; // bonus per i vertici con pochi triangoli rimasti, così non restano isolati
+    const float FORSYTH_VALENCE_POWER = 0.5f;
+
+    float vertexScore(int cachePosition, uint32_t activeTriangles)
+    {
+        if (activeTriangles == 0)
+        {
+            return -1.0f; // il vertice non serve più a nessun triangolo
+        }
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            if (cachePosition < 3)
+            {
+                score = FORSYTH_LAST_TRIANGLE;
+            }
+            else
+            {
+                float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scaler, FORSYTH_DECAY_POWER);
+            }
+        }
+        score += FORSYTH_VALENCE_SCALE * std::pow(static_cast<float>(activeTriangles), -FORSYTH_VALENCE_POWER);
+        return score;
+    }
+
+    // intervalli di indici su cui lavorare: uno per sub-mesh, oppure tutto il buffer se non ce ne sono
+    std::vector<std::pair<size_t, size_t>> indexRanges(const MeshData &data)
+    {
+        std::vector<std::pair<size_t, size_t>> ranges;
+        if (data.subMeshes.empty())
+        {
+            ranges.push_back({0, data.indices.size()});
+        }
+        for (const SubMesh &sub : data.subMeshes)
+        {
+            ranges.push_back({sub.indexOffset, sub.indexCount});
+        }
+        return ranges;
+    }
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, unsigned int cacheSize)
+{
+    VertexCacheStats stats{0.0f, 0.0f};
+    if (indices.empty())
+    {
+        return stats;
+    }
+    // una cache FIFO si simula con un timestamp per vertice: il vertice è in cache se è stato inserito negli ultimi cacheSize inserimenti
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    std::vector<bool> used(vertexCount, false);
+    uint32_t time = cacheSize + 1;
+    size_t misses = 0, uniqueVertices = 0;
+    for (uint32_t index : indices)
+    {
+        if (time - timestamps[index] > cacheSize)
+        {
+            timestamps[index] = time++;
+            misses++;
+        }
+        if (!used[index])
+        {
+            used[index] = true;
+            uniqueVertices++;
+        }
+    }
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(uniqueVertices);
+    return stats;
+}
+
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t first, size_t count, size_t vertexCount)
+{
+    size_t triangleCount = count / 3;
+    if (triangleCount < 2)
+    {
+        return;
+    }
+    const uint32_t *triangles = indices.data() + first;
+
+    // per ogni vertice, la lista dei triangoli che lo usano e non sono ancora stati emessi (tutte in un unico array)
+    std::vector<uint32_t> activeTriangles(vertexCount, 0);
+    for (size_t i = 0; i < count; i++)
+    {
+        activeTriangles[triangles[i]]++;
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + activeTriangles[v];
+    }
+    std::vector<uint32_t> adjacency(count);
+    {
+        std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < count; i++)
+        {
+            adjacency[cursor[triangles[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        vertexScores[v] = vertexScore(-1, activeTriangles[v]);
+    }
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    int bestTriangle = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScores[t] = vertexScores[triangles[t * 3]] + vertexScores[triangles[t * 3 + 1]] + vertexScores[triangles[t * 3 + 2]];
+        if (triangleScores[t] > triangleScores[bestTriangle])
+        {
+            bestTriangle = static_cast<int>(t);
+        }
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(count);
+    std::vector<uint32_t> cache, newCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+    size_t scanCursor = 0;
+
+    while (output.size() < triangleCount * 3)
+    {
+        if (bestTriangle < 0)
+        {
+            // nessun triangolo vicino ai vertici in cache: ripartiamo dal primo triangolo non ancora emesso
+            while (emitted[scanCursor])
+            {
+                scanCursor++;
+            }
+            bestTriangle = static_cast<int>(scanCursor);
+        }
+        const uint32_t *tri = triangles + bestTriangle * 3;
+        emitted[bestTriangle] = true;
+        output.insert(output.end(), tri, tri + 3);
+
+        // togliamo il triangolo dalle liste dei suoi vertici
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t v = tri[k];
+            uint32_t *list = adjacency.data() + adjacencyOffsets[v];
+            for (uint32_t j = 0; j < activeTriangles[v]; j++)
+            {
+                if (list[j] == static_cast<uint32_t>(bestTriangle))
+                {
+                    list[j] = list[activeTriangles[v] - 1];
+                    activeTriangles[v]--;
+                    break;
+                }
+            }
+        }
+
+        // i vertici del triangolo vanno in cima alla cache LRU, gli altri scendono
+        newCache.clear();
+        for (int k = 0; k < 3; k++)
+        {
+            if (std::find(newCache.begin(), newCache.end(), tri[k]) == newCache.end())
+            {
+                newCache.push_back(tri[k]);
+            }
+        }
+        for (uint32_t v : cache)
+        {
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+            {
+                newCache.push_back(v);
+            }
+        }
+
+        // aggiorniamo i punteggi dei vertici che hanno cambiato posizione (anche quelli appena usciti dalla cache) e dei loro triangoli
+        for (size_t i = 0; i < newCache.size(); i++)
+        {
+            uint32_t v = newCache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+            float score = vertexScore(cachePosition[v], activeTriangles[v]);
+            float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+            const uint32_t *list = adjacency.data() + adjacencyOffsets[v];
+            for (uint32_t j = 0; j < activeTriangles[v]; j++)
+            {
+                triangleScores[list[j]] += delta;
+            }
+        }
+        if (newCache.size() > FORSYTH_CACHE_SIZE)
+        {
+            newCache.resize(FORSYTH_CACHE_SIZE);
+        }
+        cache.swap(newCache);
+
+        // il prossimo triangolo è il migliore tra quelli che usano i vertici in cache
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (uint32_t v : cache)
+        {
+            const uint32_t *list = adjacency.data() + adjacencyOffsets[v];
+            for (uint32_t j = 0; j < activeTriangles[v]; j++)
+            {
+                if (triangleScores[list[j]] > bestScore)
+                {
+                    bestScore = triangleScores[list[j]];
+                    bestTriangle = static_cast<int>(list[j]);
+                }
+            }
+        }
+    }
+    std::copy(output.begin(), output.end(), indices.begin() + first);
+    // gli eventuali indici in più (se count non era multiplo di 3) restano dove sono
+}
+
+void optimizeOverdraw(MeshData &data, size_t first, size_t count)
+{
+    size_t triangleCount = count / 3;
+    if (triangleCount < 2)
+    {
+        return;
+    }
+    const uint32_t *triangles = data.indices.data() + first;
+
+    // dividiamo i triangoli in gruppi: un gruppo nuovo inizia quando un triangolo non trova nessuno dei suoi vertici nella cache,
+    // cioè nei punti in cui l'ordine ottimizzato ricomincia da capo, così spostare i gruppi non peggiora il riuso della cache
+    const unsigned int cacheSize = 16;
+    std::vector<uint32_t> timestamps(data.vertices.size(), 0);
+    uint32_t time = cacheSize + 1;
+    std::vector<size_t> clusterStarts;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        int misses = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t v = triangles[t * 3 + k];
+            if (time - timestamps[v] > cacheSize)
+            {
+                timestamps[v] = time++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3)
+        {
+            clusterStarts.push_back(t);
+        }
+    }
+    clusterStarts.push_back(triangleCount);
+    size_t clusterCount = clusterStarts.size() - 1;
+    if (clusterCount < 2)
+    {
+        return;
+    }
+
+    // per ogni gruppo calcoliamo baricentro e normale media (pesati per l'area), e il baricentro dell'intera sub-mesh
+    std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+    std::vector<float> clusterAreas(clusterCount, 0.0f);
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+        {
+            const glm::vec3 &a = data.vertices[triangles[t * 3]].pos;
+            const glm::vec3 &b = data.vertices[triangles[t * 3 + 1]].pos;
+            const glm::vec3 &d = data.vertices[triangles[t * 3 + 2]].pos;
+            glm::vec3 normal = glm::cross(b - a, d - a); // la sua lunghezza è il doppio dell'area
+            float area = glm::length(normal);
+            glm::vec3 centroid = (a + b + d) / 3.0f;
+            clusterCentroids[c] += centroid * area;
+            clusterNormals[c] += normal;
+            clusterAreas[c] += area;
+        }
+        meshCentroid += clusterCentroids[c];
+        meshArea += clusterAreas[c];
+        if (clusterAreas[c] > 0.0f)
+        {
+            clusterCentroids[c] /= clusterAreas[c];
+        }
+    }
+    if (meshArea > 0.0f)
+    {
+        meshCentroid /= meshArea;
+    }
+
+    // più un gruppo è lontano dal centro nella direzione in cui guarda, più è probabile che copra gli altri, quindi va disegnato prima
+    std::vector<float> sortKeys(clusterCount);
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        float length = glm::length(clusterNormals[c]);
+        glm::vec3 normal = length > 0.0f ? clusterNormals[c] / length : glm::vec3(0.0f);
+        sortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, normal);
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                     { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+    for (size_t c : order)
+    {
+        output.insert(output.end(), triangles + clusterStarts[c] * 3, triangles + clusterStarts[c + 1] * 3);
+    }
+    std::copy(output.begin(), output.end(), data.indices.begin() + first);
+}
+
+void optimizeVertexFetch(MeshData &data)
+{
+    // il nuovo indice di ogni vertice è l'ordine in cui viene incontrato per la prima volta negli indici
+    std::vector<uint32_t> remap(data.vertices.size(), UINT32_MAX);
+    std::vector<Vertex> vertices;
+    vertices.reserve(data.vertices.size());
+    for (uint32_t &index : data.indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(data.vertices[index]);
+        }
+        index = remap[index];
+    }
+    data.vertices.swap(vertices);
+}
+
+void optimizeMeshData(MeshData &data, unsigned int optimizations)
+{
+    for (const auto &[first, count] : indexRanges(data))
+    {
+        if (optimizations & MeshOptimize_VertexCache)
+        {
+            // Forsyth ottimizza per una cache LRU, ma le GPU si comportano più come una FIFO piccola:
+            // se su una FIFO da 16 il nuovo ordine è peggio di quello originale (succede con modelli già esportati a strisce) teniamo l'originale
+            std::vector<uint32_t> original(data.indices.begin() + first, data.indices.begin() + first + count);
+            optimizeVertexCache(data.indices, first, count, data.vertices.size());
+            std::vector<uint32_t> optimized(data.indices.begin() + first, data.indices.begin() + first + count);
+            if (analyzeVertexCache(optimized, data.vertices.size()).acmr > analyzeVertexCache(original, data.vertices.size()).acmr)
+            {
+                std::copy(original.begin(), original.end(), data.indices.begin() + first);
+            }
+        }
+        if (optimizations & MeshOptimize_Overdraw)
+        {
+            optimizeOverdraw(data, first, count);
+        }
+    }
+    if (optimizations & MeshOptimize_VertexFetch)
+    {
+        optimizeVertexFetch(data);
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "meshData.h"
+
+/**
+ * @brief Ottimizzazioni che si possono applicare a un modello dopo l'importazione, da combinare con l'operatore |.
+ */
+enum MeshOptimizeFlags : unsigned int
+{
+    MeshOptimize_None = 0,
+    MeshOptimize_VertexCache = 1 << 0, // riordina i triangoli per riusare i vertici già trasformati dalla GPU
+    MeshOptimize_VertexFetch = 1 << 1, // riordina i vertici nell'ordine in cui vengono letti dagli indici
+    MeshOptimize_Overdraw = 1 << 2     // riordina gruppi di triangoli per disegnare prima quelli più esterni
+};
+
+/**
+ * @brief Statistiche di riuso della cache dei vertici trasformati.
+ */
+struct VertexCacheStats
+{
+    float acmr; // average cache miss ratio: vertici trasformati per triangolo (minimo 0.5, pessimo 3)
+    float atvr; // average transformed vertex ratio: vertici trasformati diviso vertici distinti (ottimo 1)
+};
+
+/**
+ * @brief Simula una cache FIFO dei vertici trasformati e calcola ACMR e ATVR degli indici.
+ *
+ * @param indices Gli indici dei triangoli.
+ * @param vertexCount Il numero di vertici a cui fanno riferimento gli indici.
+ * @param cacheSize La dimensione della cache simulata.
+ * @return Le statistiche della cache.
+ */
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, unsigned int cacheSize = 16);
+
+/**
+ * @brief Riordina i triangoli di un intervallo di indici per migliorare il riuso della cache dei vertici.
+ *
+ * Usa l'algoritmo di Tom Forsyth ("Linear-Speed Vertex Cache Optimisation"): a ogni passo emette il triangolo con il punteggio più alto,
+ * dove il punteggio premia i vertici appena usati e quelli con pochi triangoli rimasti.
+ *
+ * @param indices Gli indici da riordinare.
+ * @param first Il primo indice dell'intervallo.
+ * @param count Il numero di indici dell'intervallo (multiplo di 3).
+ * @param vertexCount Il numero di vertici a cui fanno riferimento gli indici.
+ */
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t first, size_t count, size_t vertexCount);
+
+/**
+ * @brief Riordina i gruppi di triangoli di un intervallo di indici per ridurre l'overdraw.
+ *
+ * Va chiamata dopo optimizeVertexCache: divide l'intervallo in gruppi nei punti in cui la cache ricomincia da capo (quindi spostarli costa poco)
+ * e li ordina mettendo prima quelli sul lato esterno del modello, come nell'algoritmo Tipsify di Sander, Nehab e Barczak.
+ *
+ * @param data I dati del modello, servono le posizioni dei vertici.
+ * @param first Il primo indice dell'intervallo.
+ * @param count Il numero di indici dell'intervallo (multiplo di 3).
+ */
+void optimizeOverdraw(MeshData &data, size_t first, size_t count);
+
+/**
+ * @brief Riordina i vertici nell'ordine in cui vengono usati dagli indici ed elimina quelli non usati.
+ *
+ * @param data I dati del modello, vengono aggiornati sia i vertici che gli indici.
+ */
+void optimizeVertexFetch(MeshData &data);
+
+/**
+ * @brief Applica a un modello le ottimizzazioni richieste, sub-mesh per sub-mesh.
+ *
+ * @param data I dati del modello.
+ * @param optimizations Una combinazione di MeshOptimizeFlags.
+ */
+void optimizeMeshData(MeshData &data, unsigned int optimizations);
@@ -0,0 +1,540 @@
+#include "meshSimplifier.h"
+#include "meshOptimizer.h"
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+
+// errore massimo di un livello, in proporzione alla diagonale del bounding box del modello
+static const float LOD_MAX_RELATIVE_ERROR = 0.05f;
+// un livello viene tenuto solo se ha al massimo questa frazione dei triangoli del livello precedente
+static const float LOD_MIN_REDUCTION = 0.9f;
+// peso dei piani aggiunti lungo i bordi, serve a non far rientrare i contorni aperti del modello
+static const double BORDER_WEIGHT = 2.0;
+
+namespace
+{
+    // quadrica di errore: la somma dei quadrati delle distanze da un insieme di piani, pesati con l'area dei triangoli
+    // la matrice 4x4 è simmetrica, quindi ne teniamo solo 10 coefficienti
+    struct Quadric
+    {
+        double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+        double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+        double a22 = 0.0, a23 = 0.0;
+        double a33 = 0.0;
+        double weight = 0.0;
+
+        // aggiunge il piano a*x + b*y + c*z + d = 0, con (a, b, c) di lunghezza 1
+        void addPlane(double a, double b, double c, double d, double w)
+        {
+            a00 += w * a * a;
+            a01 += w * a * b;
+            a02 += w * a * c;
+            a03 += w * a * d;
+            a11 += w * b * b;
+            a12 += w * b * c;
+            a13 += w * b * d;
+            a22 += w * c * c;
+            a23 += w * c * d;
+            a33 += w * d * d;
+            weight += w;
+        }
+
+        void add(const Quadric &q)
+        {
+            a00 += q.a00;
+            a01 += q.a01;
+            a02 += q.a02;
+            a03 += q.a03;
+            a11 += q.a11;
+            a12 += q.a12;
+            a13 += q.a13;
+            a22 += q.a22;
+            a23 += q.a23;
+            a33 += q.a33;
+            weight += q.weight;
+        }
+
+        // distanza quadratica media dai piani della quadrica
+        double error(const glm::vec3 &p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double r = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x +
+                       a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y +
+                       a22 * z * z + 2.0 * a23 * z + a33;
+            return weight > 0.0 ? std::max(r, 0.0) / weight : 0.0;
+        }
+    };
+
+    enum VertexKind : uint8_t
+    {
+        Kind_Manifold, // vertice interno, può collassare su qualunque vicino
+        Kind_Border,   // vertice sul bordo, può collassare solo su un vicino lungo il bordo
+        Kind_Locked    // cuciture, vertici condivisi con altre sub-mesh e punti non manifold: non si spostano
+    };
+
+    struct Collapse
+    {
+        uint32_t v; // vertice che sparisce
+        uint32_t t; // vertice su cui viene spostato
+        float error;
+    };
+
+    struct PositionKey
+    {
+        uint32_t bits[3];
+        bool operator==(const PositionKey &other) const
+        {
+            return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+        }
+    };
+
+    struct PositionKeyHash
+    {
+        size_t operator()(const PositionKey &key) const
+        {
+            return (static_cast<size_t>(key.bits[0]) * 73856093u) ^ (static_cast<size_t>(key.bits[1]) * 19349663u) ^ (static_cast<size_t>(key.bits[2]) * 83492791u);
+        }
+    };
+
+    // lista di adiacenza compatta: per ogni vertice, gli elementi tra offsets[v] e offsets[v + 1] di items
+    struct Adjacency
+    {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> items;
+    };
+}
+
+static glm::vec3 triangleNormal(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+{
+    return glm::cross(b - a, c - a);
+}
+
+// per ogni vertice, gli spigoli orientati che partono da lui (in termini di posizioni, così le cuciture non contano come bordi)
+static void buildEdgeAdjacency(const std::vector<uint32_t> &indices, const std::vector<uint32_t> &position, size_t vertexCount, Adjacency &adjacency)
+{
+    adjacency.offsets.assign(vertexCount + 1, 0);
+    for (uint32_t index : indices)
+    {
+        adjacency.offsets[position[index] + 1]++;
+    }
+    std::partial_sum(adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin());
+    adjacency.items.resize(indices.size());
+    std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t a = position[indices[i + k]];
+            uint32_t b = position[indices[i + (k + 1) % 3]];
+            adjacency.items[fill[a]++] = b;
+        }
+    }
+}
+
+// per ogni vertice, i triangoli che lo usano
+static void buildTriangleAdjacency(const std::vector<uint32_t> &indices, size_t vertexCount, Adjacency &adjacency)
+{
+    adjacency.offsets.assign(vertexCount + 1, 0);
+    for (uint32_t index : indices)
+    {
+        adjacency.offsets[index + 1]++;
+    }
+    std::partial_sum(adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin());
+    adjacency.items.resize(indices.size());
+    std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        adjacency.items[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+}
+
+static bool hasEdge(const Adjacency &edges, uint32_t a, uint32_t b)
+{
+    for (uint32_t i = edges.offsets[a]; i < edges.offsets[a + 1]; i++)
+    {
+        if (edges.items[i] == b)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// classifica i vertici e trova, per quelli sul bordo, il vertice successivo e quello precedente lungo il bordo
+static void classifyVertices(const Adjacency &edges, const std::vector<uint8_t> &locked, std::vector<uint8_t> &kind,
+                             std::vector<uint32_t> &borderNext, std::vector<uint32_t> &borderPrev)
+{
+    size_t vertexCount = edges.offsets.size() - 1;
+    std::vector<uint8_t> borderOut(vertexCount, 0), borderIn(vertexCount, 0), nonManifold(vertexCount, 0);
+    for (uint32_t a = 0; a < vertexCount; a++)
+    {
+        for (uint32_t i = edges.offsets[a]; i < edges.offsets[a + 1]; i++)
+        {
+            uint32_t b = edges.items[i];
+            // lo stesso spigolo orientato usato da due triangoli: la superficie non è una varietà in quel punto
+            for (uint32_t j = edges.offsets[a]; j < i; j++)
+            {
+                if (edges.items[j] == b)
+                {
+                    nonManifold[a] = nonManifold[b] = 1;
+                }
+            }
+            // uno spigolo senza lo spigolo opposto appartiene a un solo triangolo, quindi è sul bordo
+            if (!hasEdge(edges, b, a))
+            {
+                borderOut[a] = static_cast<uint8_t>(std::min(borderOut[a] + 1, 2));
+                borderIn[b] = static_cast<uint8_t>(std::min(borderIn[b] + 1, 2));
+                borderNext[a] = b;
+                borderPrev[b] = a;
+            }
+        }
+    }
+    for (uint32_t v = 0; v < vertexCount; v++)
+    {
+        if (locked[v] || nonManifold[v])
+        {
+            kind[v] = Kind_Locked;
+        }
+        else if (borderOut[v] == 0 && borderIn[v] == 0)
+        {
+            kind[v] = Kind_Manifold;
+        }
+        else
+        {
+            // un vertice dove si incontrano più bordi non ha un'unica direzione in cui scorrere
+            kind[v] = borderOut[v] == 1 && borderIn[v] == 1 ? Kind_Border : Kind_Locked;
+        }
+    }
+}
+
+// controlla che spostare v su t non ribalti e non schiacci nessuno dei triangoli rimasti attorno a v
+static bool collapseKeepsTriangles(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, const std::vector<uint32_t> &position,
+                                   const Adjacency &triangles, uint32_t v, uint32_t t)
+{
+    const glm::vec3 &target = vertices[t].pos;
+    for (uint32_t i = triangles.offsets[v]; i < triangles.offsets[v + 1]; i++)
+    {
+        const uint32_t *corner = &indices[triangles.items[i] * 3];
+        if (corner[0] == t || corner[1] == t || corner[2] == t)
+        {
+            continue; // questo triangolo sparisce
+        }
+        if (position[corner[0]] == position[t] || position[corner[1]] == position[t] || position[corner[2]] == position[t])
+        {
+            return false; // il triangolo avrebbe area nulla senza essere eliminato
+        }
+        glm::vec3 p[3] = {vertices[corner[0]].pos, vertices[corner[1]].pos, vertices[corner[2]].pos};
+        glm::vec3 before = triangleNormal(p[0], p[1], p[2]);
+        for (int k = 0; k < 3; k++)
+        {
+            if (corner[k] == v)
+            {
+                p[k] = target;
+            }
+        }
+        glm::vec3 after = triangleNormal(p[0], p[1], p[2]);
+        double dot = static_cast<double>(glm::dot(before, after));
+        double lengths = std::sqrt(static_cast<double>(glm::dot(before, before)) * static_cast<double>(glm::dot(after, after)));
+        if (lengths == 0.0 || dot < 0.25 * lengths)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// semplifica gli indici fino a ognuno degli obiettivi (in ordine decrescente), restituendo una copia degli indici per ogni obiettivo
+// se la semplificazione si ferma prima (errore massimo raggiunto o nessuno spigolo collassabile) gli obiettivi rimanenti ricevono il risultato finale
+static std::vector<std::vector<uint32_t>> simplifyLevels(const std::vector<Vertex> &vertices, const uint32_t *indices, size_t indexCount,
+                                                         const std::vector<size_t> &targets, float maxError, const std::vector<bool> &lockedVertices,
+                                                         std::vector<float> &errors)
+{
+    size_t vertexCount = vertices.size();
+    std::vector<uint32_t> current(indices, indices + indexCount);
+    std::vector<std::vector<uint32_t>> levels;
+    errors.clear();
+
+    // i vertici con la stessa posizione vengono trattati come un unico punto della superficie, rappresentato dal primo incontrato
+    std::vector<uint32_t> position(vertexCount, 0);
+    std::vector<uint8_t> seen(vertexCount, 0);
+    std::vector<uint8_t> locked(vertexCount, 0);
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> positions;
+    positions.reserve(indexCount / 3);
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        uint32_t index = indices[i];
+        if (seen[index])
+        {
+            continue;
+        }
+        seen[index] = 1;
+        PositionKey key;
+        memcpy(key.bits, &vertices[index].pos, sizeof(key.bits));
+        auto inserted = positions.emplace(key, index);
+        position[index] = inserted.first->second;
+        if (!inserted.second)
+        {
+            locked[position[index]] = 1; // più vertici nella stessa posizione: è una cucitura delle coordinate texture o delle normali
+        }
+        if (!lockedVertices.empty() && lockedVertices[index])
+        {
+            locked[position[index]] = 1;
+        }
+    }
+
+    Adjacency edges, triangles;
+    std::vector<uint8_t> kind(vertexCount, Kind_Locked);
+    std::vector<uint32_t> borderNext(vertexCount, 0), borderPrev(vertexCount, 0);
+    buildEdgeAdjacency(current, position, vertexCount, edges);
+    classifyVertices(edges, locked, kind, borderNext, borderPrev);
+
+    // quadriche iniziali: i piani dei triangoli attorno a ogni punto, più un piano perpendicolare per ogni spigolo sul bordo
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < current.size(); i += 3)
+    {
+        uint32_t p[3] = {position[current[i]], position[current[i + 1]], position[current[i + 2]]};
+        glm::vec3 normal = triangleNormal(vertices[p[0]].pos, vertices[p[1]].pos, vertices[p[2]].pos);
+        double length = std::sqrt(static_cast<double>(glm::dot(normal, normal)));
+        if (length == 0.0)
+        {
+            continue;
+        }
+        double nx = normal.x / length, ny = normal.y / length, nz = normal.z / length;
+        double d = -(nx * vertices[p[0]].pos.x + ny * vertices[p[0]].pos.y + nz * vertices[p[0]].pos.z);
+        for (int k = 0; k < 3; k++)
+        {
+            quadrics[p[k]].addPlane(nx, ny, nz, d, length * 0.5);
+
+            uint32_t a = p[k], b = p[(k + 1) % 3];
+            if (hasEdge(edges, b, a))
+            {
+                continue;
+            }
+            glm::vec3 edge = vertices[b].pos - vertices[a].pos;
+            glm::vec3 side = glm::cross(edge, normal);
+            double sideLength = std::sqrt(static_cast<double>(glm::dot(side, side)));
+            if (sideLength == 0.0)
+            {
+                continue;
+            }
+            double sx = side.x / sideLength, sy = side.y / sideLength, sz = side.z / sideLength;
+            double sd = -(sx * vertices[a].pos.x + sy * vertices[a].pos.y + sz * vertices[a].pos.z);
+            double weight = static_cast<double>(glm::dot(edge, edge)) * BORDER_WEIGHT;
+            quadrics[a].addPlane(sx, sy, sz, sd, weight);
+            quadrics[b].addPlane(sx, sy, sz, sd, weight);
+        }
+    }
+
+    double maxErrorSquared = static_cast<double>(maxError) * maxError;
+    double reachedError = 0.0;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    size_t level = 0;
+    while (level < targets.size())
+    {
+        size_t triangleCount = current.size() / 3;
+        size_t goal = targets[level] / 3;
+        if (triangleCount <= goal)
+        {
+            levels.push_back(current);
+            errors.push_back(static_cast<float>(std::sqrt(reachedError)));
+            level++;
+            continue;
+        }
+
+        // tutti gli spigoli collassabili, in entrambe le direzioni, ordinati per errore
+        collapses.clear();
+        for (size_t i = 0; i < current.size(); i += 3)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t a = current[i + k], b = current[i + (k + 1) % 3];
+                uint32_t pair[2][2] = {{a, b}, {b, a}};
+                for (auto &candidate : pair)
+                {
+                    uint32_t v = candidate[0], t = candidate[1];
+                    uint32_t pv = position[v], pt = position[t];
+                    if (kind[pv] == Kind_Locked || pv == pt)
+                    {
+                        continue;
+                    }
+                    if (kind[pv] == Kind_Border && borderNext[pv] != pt && borderPrev[pv] != pt)
+                    {
+                        continue;
+                    }
+                    Quadric q = quadrics[pv];
+                    q.add(quadrics[pt]);
+                    collapses.push_back({v, t, static_cast<float>(q.error(vertices[t].pos))});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b)
+                  { return a.error < b.error; });
+
+        buildTriangleAdjacency(current, vertexCount, triangles);
+        std::iota(remap.begin(), remap.end(), 0u);
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t toRemove = triangleCount - goal, removed = 0, performed = 0;
+        // in una passata accettiamo solo collassi con un errore vicino a quello dei più economici,
+        // così quelli costosi vengono rivalutati nella passata successiva, dopo che i vicini sono già stati semplificati
+        double passLimit = std::min(maxErrorSquared, static_cast<double>(collapses.empty() ? 0.0f : collapses[std::min(collapses.size() - 1, toRemove)].error) * 1.5);
+        for (const Collapse &collapse : collapses)
+        {
+            if (removed >= toRemove || collapse.error > passLimit)
+            {
+                break;
+            }
+            uint32_t pv = position[collapse.v], pt = position[collapse.t];
+            // ogni vertice viene coinvolto in un solo collasso per passata, così i controlli restano validi
+            if (touched[pv] || touched[pt] || !collapseKeepsTriangles(vertices, current, position, triangles, collapse.v, collapse.t))
+            {
+                continue;
+            }
+            remap[collapse.v] = collapse.t;
+            quadrics[pt].add(quadrics[pv]);
+            touched[pv] = touched[pt] = 1;
+            for (uint32_t i = triangles.offsets[collapse.v]; i < triangles.offsets[collapse.v + 1]; i++)
+            {
+                const uint32_t *corner = &current[triangles.items[i] * 3];
+                touched[position[corner[0]]] = touched[position[corner[1]]] = touched[position[corner[2]]] = 1;
+                if (corner[0] == collapse.t || corner[1] == collapse.t || corner[2] == collapse.t)
+                {
+                    removed++;
+                }
+            }
+            reachedError = std::max(reachedError, static_cast<double>(collapse.error));
+            performed++;
+        }
+
+        // applichiamo i collassi ed eliminiamo i triangoli degeneri
+        size_t write = 0;
+        for (size_t i = 0; i < current.size(); i += 3)
+        {
+            uint32_t a = remap[current[i]], b = remap[current[i + 1]], c = remap[current[i + 2]];
+            if (a != b && b != c && a != c)
+            {
+                current[write++] = a;
+                current[write++] = b;
+                current[write++] = c;
+            }
+        }
+        current.resize(write);
+
+        if (performed == 0)
+        {
+            // non si può scendere oltre: gli obiettivi rimanenti ricevono il risultato attuale
+            while (level < targets.size())
+            {
+                levels.push_back(current);
+                errors.push_back(static_cast<float>(std::sqrt(reachedError)));
+                level++;
+            }
+            break;
+        }
+        // i collassi cambiano i bordi solo scorrendo lungo di essi, ma le adiacenze vanno ricostruite
+        buildEdgeAdjacency(current, position, vertexCount, edges);
+        classifyVertices(edges, locked, kind, borderNext, borderPrev);
+    }
+    return levels;
+}
+
+std::vector<uint32_t> simplifyIndices(const std::vector<Vertex> &vertices, const uint32_t *indices, size_t indexCount,
+                                      size_t targetIndexCount, float maxError, const std::vector<bool> &lockedVertices, float &resultError)
+{
+    std::vector<float> errors;
+    std::vector<std::vector<uint32_t>> levels = simplifyLevels(vertices, indices, indexCount, {targetIndexCount}, maxError, lockedVertices, errors);
+    resultError = errors.empty() ? 0.0f : errors[0];
+    return levels.empty() ? std::vector<uint32_t>(indices, indices + indexCount) : levels[0];
+}
+
+void generateMeshLods(MeshData &data, unsigned int levelCount, unsigned int optimizations)
+{
+    data.lods.clear();
+    if (levelCount == 0 || data.indices.empty())
+    {
+        return;
+    }
+    // un modello senza sub-mesh diventa un'unica sub-mesh senza materiale: gli indici dei livelli vanno in fondo al buffer,
+    // quindi serve un intervallo che dica dove finisce il modello completo
+    if (data.subMeshes.empty())
+    {
+        data.subMeshes.emplace_back(0, static_cast<uint32_t>(data.indices.size()), -1);
+        data.textureFiles.resize(1);
+    }
+    const std::vector<SubMesh> &subMeshes = data.subMeshes;
+
+    // i vertici usati da più sub-mesh restano fermi, altrimenti ogni sub-mesh li sposterebbe in modo diverso aprendo dei buchi
+    std::vector<bool> locked(data.vertices.size(), false);
+    std::vector<int32_t> owner(data.vertices.size(), -1);
+    for (size_t s = 0; s < subMeshes.size(); s++)
+    {
+        const SubMesh &sub = subMeshes[s];
+        for (uint32_t i = sub.indexOffset; i < sub.indexOffset + sub.indexCount; i++)
+        {
+            uint32_t index = data.indices[i];
+            if (owner[index] < 0)
+            {
+                owner[index] = static_cast<int32_t>(s);
+            }
+            else if (owner[index] != static_cast<int32_t>(s))
+            {
+                locked[index] = true;
+            }
+        }
+    }
+
+    float maxError = glm::length(data.boundsMax - data.boundsMin) * LOD_MAX_RELATIVE_ERROR;
+    std::vector<std::vector<std::vector<uint32_t>>> levels(subMeshes.size());
+    std::vector<std::vector<float>> errors(subMeshes.size());
+    for (size_t s = 0; s < subMeshes.size(); s++)
+    {
+        const SubMesh &sub = subMeshes[s];
+        // ogni livello dimezza i triangoli del precedente
+        std::vector<size_t> targets;
+        size_t triangles = sub.indexCount / 3;
+        for (unsigned int l = 0; l < levelCount; l++)
+        {
+            triangles /= 2;
+            targets.push_back(triangles * 3);
+        }
+        levels[s] = simplifyLevels(data.vertices, data.indices.data() + sub.indexOffset, sub.indexCount, targets, maxError, locked, errors[s]);
+    }
+
+    size_t previousCount = 0;
+    for (const SubMesh &sub : subMeshes)
+    {
+        previousCount += sub.indexCount;
+    }
+    for (unsigned int l = 0; l < levelCount; l++)
+    {
+        size_t count = 0;
+        float error = 0.0f;
+        for (size_t s = 0; s < subMeshes.size(); s++)
+        {
+            count += levels[s][l].size();
+            error = std::max(error, errors[s][l]);
+        }
+        if (count == 0 || static_cast<float>(count) > static_cast<float>(previousCount) * LOD_MIN_REDUCTION)
+        {
+            break; // il modello non si riduce più abbastanza, i livelli successivi sarebbero uguali
+        }
+
+        MeshLod lod;
+        lod.error = error;
+        for (size_t s = 0; s < subMeshes.size(); s++)
+        {
+            uint32_t offset = static_cast<uint32_t>(data.indices.size());
+            data.indices.insert(data.indices.end(), levels[s][l].begin(), levels[s][l].end());
+            if ((optimizations & MeshOptimize_VertexCache) && !levels[s][l].empty())
+            {
+                optimizeVertexCache(data.indices, offset, levels[s][l].size(), data.vertices.size());
+            }
+            lod.ranges.emplace_back(offset, static_cast<uint32_t>(levels[s][l].size()), -1);
+        }
+        data.lods.push_back(std::move(lod));
+        previousCount = count;
+    }
+}
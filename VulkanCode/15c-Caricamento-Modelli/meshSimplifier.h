@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "meshData.h"
+
+/**
+ * @brief Semplifica un intervallo di indici riducendo il numero di triangoli con il collasso degli spigoli.
+ *
+ * Usa le quadriche di errore di Garland e Heckbert ("Surface Simplification Using Quadric Error Metrics"): a ogni passo vengono collassati
+ * gli spigoli che spostano meno la superficie. Un vertice viene sempre collassato su uno dei suoi vicini e mai in una posizione nuova,
+ * così i vertici del modello restano gli stessi e cambia solo il buffer degli indici.
+ * I vertici sul bordo scorrono solo lungo il bordo, mentre quelli sulle cuciture delle coordinate texture (stessa posizione ma vertici diversi)
+ * e quelli indicati in lockedVertices restano fermi.
+ *
+ * @param vertices I vertici del modello.
+ * @param indices Gli indici da semplificare.
+ * @param indexCount Il numero di indici (multiplo di 3).
+ * @param targetIndexCount Il numero di indici da raggiungere, se l'errore massimo lo permette.
+ * @param maxError L'errore massimo ammesso, nelle unità del modello.
+ * @param lockedVertices Per ogni vertice del modello, true se non può essere spostato. Può essere vuoto.
+ * @param resultError L'errore raggiunto, nelle unità del modello.
+ * @return Gli indici semplificati.
+ */
+std::vector<uint32_t> simplifyIndices(const std::vector<Vertex> &vertices, const uint32_t *indices, size_t indexCount,
+                                      size_t targetIndexCount, float maxError, const std::vector<bool> &lockedVertices, float &resultError);
+
+/**
+ * @brief Genera i livelli di dettaglio di un modello e li aggiunge in fondo al buffer degli indici.
+ *
+ * Ogni livello ha circa la metà dei triangoli del precedente. Tutti i livelli vengono prodotti da un'unica semplificazione del modello completo,
+ * quindi l'errore di ogni livello è misurato rispetto all'originale. I vertici usati da più sub-mesh restano fermi, così tra le sub-mesh non si aprono buchi.
+ * La generazione si ferma prima se un livello non riesce più a ridurre i triangoli in modo significativo.
+ *
+ * @param data I dati del modello, vengono aggiornati gli indici e MeshData::lods.
+ * @param levelCount Il numero massimo di livelli da generare, oltre al modello completo.
+ * @param optimizations Le MeshOptimizeFlags applicate al modello: con MeshOptimize_VertexCache anche gli indici dei livelli vengono riordinati.
+ */
+void generateMeshLods(MeshData &data, unsigned int levelCount, unsigned int optimizations);
@@ -0,0 +1,201 @@
+// piccolo programma da riga di comando per misurare il caricamento dei modelli senza aprire la finestra né creare il dispositivo Vulkan
+// uso: meshbench.exe
+// stampa i tempi di caricamento senza e con la cache binaria, la velocità di lettura dei file .obj con Assimp e con il parser dedicato
+// il riuso della cache dei vertici (ACMR/ATVR) prima e dopo le ottimizzazioni di meshOptimizer.h
+// i triangoli e l'errore dei livelli di dettaglio generati da meshSimplifier.h e i meshlet generati da meshlet.h
+#include "meshData.h"
+#include "meshCache.h"
+#include "meshOptimizer.h"
+#include "meshSimplifier.h"
+#include "meshlet.h"
+#include "assimp/postprocess.h" // Assimp post processing flags
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <filesystem>
+#include <vector>
+#include <string>
+
+namespace fs = std::filesystem;
+
+struct BenchModel
+{
+    std::string path;
+    unsigned int flags;
+};
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int main()
+{
+    // stessi modelli e stessi flag usati da initializeMeshes in main.cpp
+    unsigned int flags = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_FlipUVs;
+    std::vector<BenchModel> models = {
+        {"models/teapot.obj", flags},
+        {"models/skull.obj", flags},
+        {"models/dragon.obj", flags},
+        {"models/boot/boot.obj", flags},
+        {"models/flower/flower.obj", flags},
+        {"models/marius/head.obj", aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals},
+        {"models/marius/eyelashesLower.obj", flags},
+        {"models/marius/eyelashesUpper.obj", flags},
+        {"models/marius/eyes.obj", flags},
+        {"models/marius/hair_plate.obj", flags},
+        {"models/marius/hair_vac.obj", flags},
+        {"models/marius/eyebrows.obj", flags},
+    };
+
+    std::cout << std::left << std::setw(36) << "modello" << std::right
+              << std::setw(10) << "vertici" << std::setw(12) << "cold (ms)" << std::setw(12) << "warm (ms)" << std::endl;
+
+    double totalCold = 0.0, totalWarm = 0.0;
+    for (const BenchModel &model : models)
+    {
+        if (!fs::exists(model.path))
+        {
+            std::cout << std::left << std::setw(36) << model.path << " mancante, saltato" << std::endl;
+            continue;
+        }
+        // cold: eliminiamo la cache, importiamo con Assimp e riscriviamo la cache, come al primo avvio
+        std::error_code ec;
+        fs::remove(meshCachePath(model.path), ec);
+        MeshData cold;
+        auto start = std::chrono::high_resolution_clock::now();
+        if (!importMeshData(model.path, model.flags, cold))
+        {
+            continue;
+        }
+        saveMeshCache(model.path, model.flags, cold);
+        double coldMs = elapsedMs(start);
+
+        // warm: leggiamo solo la cache appena scritta
+        MeshData warm;
+        start = std::chrono::high_resolution_clock::now();
+        bool hit = loadMeshCache(model.path, model.flags, warm);
+        double warmMs = elapsedMs(start);
+        if (!hit || warm.vertices.size() != cold.vertices.size() || warm.indices.size() != cold.indices.size())
+        {
+            std::cerr << "cache non valida per " << model.path << std::endl;
+            continue;
+        }
+
+        totalCold += coldMs;
+        totalWarm += warmMs;
+        std::cout << std::left << std::setw(36) << model.path << std::right << std::setw(10) << cold.vertices.size()
+                  << std::fixed << std::setprecision(2) << std::setw(12) << coldMs << std::setw(12) << warmMs << std::endl;
+    }
+    std::cout << std::left << std::setw(46) << "totale" << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << totalCold << std::setw(12) << totalWarm << std::endl;
+
+    // velocità di lettura dei file .obj: importatore di Assimp contro il parser dedicato, entrambi senza cache
+    std::cout << std::endl
+              << std::left << std::setw(36) << "modello" << std::right
+              << std::setw(10) << "MB" << std::setw(14) << "Assimp MB/s" << std::setw(14) << "OBJ MB/s" << std::setw(10) << "vertici" << std::endl;
+    double totalBytes = 0.0, totalAssimp = 0.0, totalNative = 0.0;
+    for (const BenchModel &model : models)
+    {
+        if (!fs::exists(model.path))
+        {
+            continue;
+        }
+        double megabytes = static_cast<double>(fs::file_size(model.path)) / (1024.0 * 1024.0);
+        MeshData assimpData, nativeData;
+        auto start = std::chrono::high_resolution_clock::now();
+        bool assimpOk = importMeshData(model.path, model.flags, assimpData, MeshImporter::Assimp);
+        double assimpMs = elapsedMs(start);
+        start = std::chrono::high_resolution_clock::now();
+        bool nativeOk = importMeshData(model.path, model.flags, nativeData, MeshImporter::NativeObj);
+        double nativeMs = elapsedMs(start);
+        if (!assimpOk || !nativeOk)
+        {
+            continue;
+        }
+        totalBytes += megabytes;
+        totalAssimp += assimpMs;
+        totalNative += nativeMs;
+        std::cout << std::left << std::setw(36) << model.path << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << megabytes << std::setw(14) << megabytes / (assimpMs / 1000.0) << std::setw(14) << megabytes / (nativeMs / 1000.0)
+                  << std::setw(10) << nativeData.vertices.size() << std::endl;
+    }
+    if (totalAssimp > 0.0 && totalNative > 0.0)
+    {
+        std::cout << std::left << std::setw(36) << "totale" << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << totalBytes << std::setw(14) << totalBytes / (totalAssimp / 1000.0) << std::setw(14) << totalBytes / (totalNative / 1000.0) << std::endl;
+    }
+
+    // ACMR e ATVR simulati su una cache FIFO da 16 vertici, prima e dopo le ottimizzazioni
+    std::cout << std::endl
+              << std::left << std::setw(36) << "modello" << std::right
+              << std::setw(12) << "ACMR prima" << std::setw(12) << "ACMR dopo" << std::setw(12) << "ATVR prima" << std::setw(12) << "ATVR dopo" << std::setw(10) << "ms" << std::endl;
+    for (const BenchModel &model : models)
+    {
+        MeshData data;
+        if (!fs::exists(model.path) || !importMeshData(model.path, model.flags, data))
+        {
+            continue;
+        }
+        VertexCacheStats before = analyzeVertexCache(data.indices, data.vertices.size());
+        auto start = std::chrono::high_resolution_clock::now();
+        optimizeMeshData(data, MeshOptimize_VertexCache | MeshOptimize_VertexFetch | MeshOptimize_Overdraw);
+        double optimizeMs = elapsedMs(start);
+        VertexCacheStats after = analyzeVertexCache(data.indices, data.vertices.size());
+        std::cout << std::left << std::setw(36) << model.path << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(12) << before.acmr << std::setw(12) << after.acmr << std::setw(12) << before.atvr << std::setw(12) << after.atvr
+                  << std::setprecision(2) << std::setw(10) << optimizeMs << std::endl;
+    }
+
+    // livelli di dettaglio: triangoli di ogni livello e il suo errore in percentuale della diagonale del bounding box
+    std::cout << std::endl
+              << std::left << std::setw(36) << "modello" << std::right << std::setw(10) << "ms" << "   triangoli (errore %) per livello" << std::endl;
+    for (const BenchModel &model : models)
+    {
+        MeshData data;
+        if (!fs::exists(model.path) || !importMeshData(model.path, model.flags, data))
+        {
+            continue;
+        }
+        optimizeMeshData(data, MeshOptimize_VertexCache | MeshOptimize_VertexFetch);
+        size_t fullTriangles = data.indices.size() / 3;
+        auto start = std::chrono::high_resolution_clock::now();
+        generateMeshLods(data, 4, MeshOptimize_VertexCache);
+        double lodMs = elapsedMs(start);
+        float diagonal = glm::length(data.boundsMax - data.boundsMin);
+        std::cout << std::left << std::setw(36) << model.path << std::right << std::fixed << std::setprecision(2) << std::setw(10) << lodMs << "   " << fullTriangles;
+        for (const MeshLod &lod : data.lods)
+        {
+            size_t triangles = 0;
+            for (const SubMesh &range : lod.ranges)
+            {
+                triangles += range.indexCount / 3;
+            }
+            std::cout << ", " << triangles << " (" << (diagonal > 0.0f ? lod.error / diagonal * 100.0f : 0.0f) << ")";
+        }
+        std::cout << std::endl;
+    }
+
+    // meshlet: quanti sono, quanti triangoli hanno in media e quanto peggiora il riuso della cache dei vertici dividendo il modello
+    std::cout << std::endl
+              << std::left << std::setw(36) << "modello" << std::right
+              << std::setw(10) << "meshlet" << std::setw(14) << "triangoli/m" << std::setw(12) << "ACMR prima" << std::setw(12) << "ACMR dopo" << std::setw(10) << "ms" << std::endl;
+    for (const BenchModel &model : models)
+    {
+        MeshData data;
+        if (!fs::exists(model.path) || !importMeshData(model.path, model.flags, data))
+        {
+            continue;
+        }
+        optimizeMeshData(data, MeshOptimize_VertexCache | MeshOptimize_VertexFetch);
+        VertexCacheStats before = analyzeVertexCache(data.indices, data.vertices.size());
+        auto start = std::chrono::high_resolution_clock::now();
+        buildMeshlets(data, MeshOptimize_VertexCache);
+        double meshletMs = elapsedMs(start);
+        VertexCacheStats after = analyzeVertexCache(data.indices, data.vertices.size());
+        std::cout << std::left << std::setw(36) << model.path << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << data.meshlets.size() << std::setw(14) << (data.meshlets.empty() ? 0.0 : data.indices.size() / 3.0 / data.meshlets.size())
+                  << std::setw(12) << before.acmr << std::setw(12) << after.acmr << std::setprecision(2) << std::setw(10) << meshletMs << std::endl;
+    }
+    return 0;
+}
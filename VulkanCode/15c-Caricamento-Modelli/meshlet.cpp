@@ -0,0 +1,249 @@
+#include "meshlet.h"
+#include "meshOptimizer.h"
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <limits>
+
+MeshletCulling makeMeshletCulling(const glm::mat4 &model, const glm::mat4 &viewProj, const glm::vec3 &cameraPos, bool backfaceCulling)
+{
+    MeshletCulling culling;
+    // metodo di Gribb e Hartmann: i piani del frustum si ricavano dalle righe della matrice che porta dallo spazio del modello a quello di clip
+    // usando viewProj * model i piani sono già nello spazio del modello
+    glm::mat4 m = viewProj * model;
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++)
+    {
+        row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    }
+    culling.planes[0] = row[3] + row[0]; // sinistra
+    culling.planes[1] = row[3] - row[0]; // destra
+    culling.planes[2] = row[3] + row[1]; // sotto
+    culling.planes[3] = row[3] - row[1]; // sopra
+    culling.planes[4] = row[2];          // vicino, con la profondità tra 0 e 1 di Vulkan
+    culling.planes[5] = row[3] - row[2]; // lontano
+    for (glm::vec4 &plane : culling.planes)
+    {
+        float length = glm::length(glm::vec3(plane));
+        if (length > 0.0f)
+        {
+            plane = plane * (1.0f / length);
+        }
+    }
+    culling.cameraPos = glm::vec3(glm::inverse(model) * glm::vec4(cameraPos, 1.0f));
+    culling.backfaceCulling = backfaceCulling;
+    return culling;
+}
+
+bool isMeshletVisible(const Meshlet &meshlet, const MeshletCulling &culling)
+{
+    for (const glm::vec4 &plane : culling.planes)
+    {
+        if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius)
+        {
+            return false; // la sfera è tutta dalla parte esterna di un piano
+        }
+    }
+
+    if (culling.backfaceCulling && meshlet.coneCutoff > 0.0f)
+    {
+        // un triangolo con normale n e un punto p è rivolto dall'altra parte se dot(n, p - camera) >= 0
+        // il caso peggiore tra le normali del cono e i punti della sfera è cos(theta + alfa) * distanza >= raggio,
+        // dove theta è l'angolo tra l'asse del cono e la direzione camera-centro e alfa è l'apertura del cono
+        glm::vec3 toCenter = meshlet.center - culling.cameraPos;
+        float distance = glm::length(toCenter);
+        if (distance > meshlet.radius)
+        {
+            float cosTheta = glm::dot(toCenter, meshlet.coneAxis) / distance;
+            float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+            float cosAlpha = meshlet.coneCutoff;
+            float sinAlpha = std::sqrt(std::max(0.0f, 1.0f - cosAlpha * cosAlpha));
+            if (cosTheta * cosAlpha - sinTheta * sinAlpha >= meshlet.radius / distance)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// calcola sfera e cono delle normali di un meshlet
+static void computeMeshletBounds(const MeshData &data, Meshlet &meshlet)
+{
+    glm::vec3 boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max());
+    for (uint32_t i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.indexCount; i++)
+    {
+        boundsMin = glm::min(boundsMin, data.vertices[data.indices[i]].pos);
+        boundsMax = glm::max(boundsMax, data.vertices[data.indices[i]].pos);
+    }
+    meshlet.center = (boundsMin + boundsMax) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (uint32_t i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.indexCount; i++)
+    {
+        meshlet.radius = std::max(meshlet.radius, glm::length(data.vertices[data.indices[i]].pos - meshlet.center));
+    }
+
+    // le normali usate per il cono sono quelle geometriche, perché sono quelle che decidono il culling delle facce posteriori
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.indexCount / 3);
+    glm::vec3 axis(0.0f);
+    for (uint32_t i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.indexCount; i += 3)
+    {
+        const glm::vec3 &a = data.vertices[data.indices[i]].pos;
+        const glm::vec3 &b = data.vertices[data.indices[i + 1]].pos;
+        const glm::vec3 &c = data.vertices[data.indices[i + 2]].pos;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if (length > 0.0f)
+        {
+            normals.push_back(normal * (1.0f / length));
+            axis += normals.back();
+        }
+    }
+    float axisLength = glm::length(axis);
+    if (normals.empty() || axisLength < 1e-6f)
+    {
+        meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.coneCutoff = -1.0f;
+        return;
+    }
+    meshlet.coneAxis = axis * (1.0f / axisLength);
+    meshlet.coneCutoff = 1.0f;
+    for (const glm::vec3 &normal : normals)
+    {
+        meshlet.coneCutoff = std::min(meshlet.coneCutoff, glm::dot(normal, meshlet.coneAxis));
+    }
+}
+
+// divide in meshlet un intervallo di indici, scrivendo i triangoli riordinati in output (che all'inizio è vuoto)
+static void buildSubMeshMeshlets(MeshData &data, uint32_t first, uint32_t count, std::vector<uint32_t> &output)
+{
+    const uint32_t *indices = data.indices.data() + first;
+    size_t triangleCount = count / 3;
+    size_t vertexCount = data.vertices.size();
+
+    // per ogni vertice, i triangoli che lo usano
+    std::vector<uint32_t> offsets(vertexCount + 1, 0), triangles(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        offsets[indices[i] + 1]++;
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        triangles[fill[indices[i]]++] = i / 3;
+    }
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> stamp(vertexCount, std::numeric_limits<uint32_t>::max()); // ultimo meshlet che ha usato il vertice
+    std::vector<uint32_t> meshletVertices;
+    uint32_t meshletId = 0;
+    size_t seed = 0;
+    size_t done = 0;
+    while (done < triangleCount)
+    {
+        // il primo triangolo non ancora usato, nell'ordine già ottimizzato, fa da seme del nuovo meshlet
+        while (emitted[seed])
+        {
+            seed++;
+        }
+        Meshlet meshlet{};
+        meshlet.indexOffset = first + static_cast<uint32_t>(output.size());
+        meshletVertices.clear();
+        size_t next = seed;
+        uint32_t meshletTriangles = 0;
+        while (true)
+        {
+            // aggiungiamo il triangolo scelto
+            emitted[next] = 1;
+            done++;
+            meshletTriangles++;
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t v = indices[next * 3 + k];
+                output.push_back(v);
+                if (stamp[v] != meshletId)
+                {
+                    stamp[v] = meshletId;
+                    meshletVertices.push_back(v);
+                }
+            }
+            if (meshletTriangles == MESHLET_MAX_TRIANGLES)
+            {
+                break;
+            }
+
+            // tra i triangoli vicini scegliamo quello che aggiunge meno vertici nuovi, a parità quello che viene prima nell'ordine originale
+            size_t best = triangleCount;
+            uint32_t bestNew = 4;
+            for (uint32_t v : meshletVertices)
+            {
+                for (uint32_t i = offsets[v]; i < offsets[v + 1]; i++)
+                {
+                    uint32_t t = triangles[i];
+                    if (emitted[t])
+                    {
+                        continue;
+                    }
+                    uint32_t newVertices = 0;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        newVertices += stamp[indices[t * 3 + k]] != meshletId ? 1 : 0;
+                    }
+                    if (meshletVertices.size() + newVertices > MESHLET_MAX_VERTICES)
+                    {
+                        continue;
+                    }
+                    if (newVertices < bestNew || (newVertices == bestNew && t < best))
+                    {
+                        best = t;
+                        bestNew = newVertices;
+                    }
+                }
+            }
+            if (best == triangleCount)
+            {
+                break; // nessun vicino ci sta più: il meshlet è completo
+            }
+            next = best;
+        }
+        meshlet.indexCount = meshletTriangles * 3;
+        data.meshlets.push_back(meshlet);
+        meshletId++;
+    }
+}
+
+void buildMeshlets(MeshData &data, unsigned int optimizations)
+{
+    data.meshlets.clear();
+    if (data.indices.empty())
+    {
+        return;
+    }
+    // come per i livelli di dettaglio, un modello senza sub-mesh diventa un'unica sub-mesh senza materiale
+    if (data.subMeshes.empty())
+    {
+        data.subMeshes.emplace_back(0, static_cast<uint32_t>(data.indices.size()), -1);
+        data.textureFiles.resize(1);
+    }
+
+    // i triangoli riordinati di ogni sub-mesh prendono il posto di quelli originali, i livelli di dettaglio in fondo al buffer restano uguali
+    std::vector<uint32_t> output;
+    for (const SubMesh &sub : data.subMeshes)
+    {
+        output.clear();
+        output.reserve(sub.indexCount);
+        buildSubMeshMeshlets(data, sub.indexOffset, sub.indexCount, output);
+        std::copy(output.begin(), output.end(), data.indices.begin() + sub.indexOffset);
+    }
+
+    for (Meshlet &meshlet : data.meshlets)
+    {
+        if (optimizations & MeshOptimize_VertexCache)
+        {
+            optimizeVertexCache(data.indices, meshlet.indexOffset, meshlet.indexCount, data.vertices.size());
+        }
+        computeMeshletBounds(data, meshlet);
+    }
+}
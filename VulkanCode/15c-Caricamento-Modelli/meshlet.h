@@ -0,0 +1,62 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include "meshData.h"
+
+// dimensione massima di un meshlet, come suggerito per le mesh shader di NVIDIA: 64 vertici e 124 triangoli
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+/**
+ * @brief Funzioni per dividere un modello in meshlet e scartare sulla CPU quelli che non si vedono.
+ *
+ * Un meshlet è un piccolo gruppo di triangoli vicini, con indici contigui nel buffer degli indici.
+ * Per ognuno teniamo una sfera che lo contiene e un cono che contiene le normali dei suoi triangoli:
+ * con la sfera si controlla se è fuori dal frustum, con il cono se tutti i suoi triangoli sono rivolti dall'altra parte rispetto alla camera.
+ */
+
+/**
+ * @brief Piani del frustum e posizione della camera nello spazio di un modello, calcolati una volta per frame.
+ */
+struct MeshletCulling
+{
+    glm::vec4 planes[6]; // normale rivolta verso l'interno del frustum (xyz) e distanza (w)
+    glm::vec3 cameraPos;
+    bool backfaceCulling;
+};
+
+/**
+ * @brief Prepara i dati per scartare i meshlet di una mesh in un frame.
+ *
+ * Piani del frustum e posizione della camera vengono portati nello spazio del modello, così i meshlet non vanno trasformati uno per uno.
+ * La trasformazione del modello può contenere solo rotazioni, traslazioni e scale uniformi.
+ *
+ * @param model La matrice di trasformazione del modello.
+ * @param viewProj Il prodotto delle matrici di proiezione e di vista.
+ * @param cameraPos La posizione della camera.
+ * @param backfaceCulling true se la pipeline scarta le facce posteriori, altrimenti il test del cono non si può usare.
+ * @return I dati per isMeshletVisible.
+ */
+MeshletCulling makeMeshletCulling(const glm::mat4 &model, const glm::mat4 &viewProj, const glm::vec3 &cameraPos, bool backfaceCulling);
+
+/**
+ * @brief Controlla se un meshlet può essere visibile.
+ *
+ * @param meshlet Il meshlet da controllare.
+ * @param culling I dati preparati con makeMeshletCulling.
+ * @return false se il meshlet è tutto fuori dal frustum o tutto rivolto dalla parte opposta alla camera.
+ */
+bool isMeshletVisible(const Meshlet &meshlet, const MeshletCulling &culling);
+
+/**
+ * @brief Divide le sub-mesh del modello completo in meshlet.
+ *
+ * Ogni meshlet viene fatto crescere a partire da un triangolo aggiungendo i triangoli vicini che portano meno vertici nuovi,
+ * finché non raggiunge MESHLET_MAX_VERTICES vertici o MESHLET_MAX_TRIANGLES triangoli. I triangoli di ogni sub-mesh vengono riordinati
+ * in modo che ogni meshlet sia un intervallo contiguo, i livelli di dettaglio non vengono toccati.
+ *
+ * @param data I dati del modello, vengono aggiornati gli indici e MeshData::meshlets.
+ * @param optimizations Le MeshOptimizeFlags applicate al modello: con MeshOptimize_VertexCache i triangoli di ogni meshlet vengono riordinati per la cache.
+ */
+void buildMeshlets(MeshData &data, unsigned int optimizations);
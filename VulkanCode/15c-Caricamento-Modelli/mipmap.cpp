@@ -0,0 +1,109 @@
+#include "mipmap.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // risoluzione della tabella da lineare a sRGB: con 4096 valori l'errore resta sotto mezzo passo degli 8 bit anche nei toni scuri
+    const int LINEAR_TO_SRGB_STEPS = 4096;
+
+    struct SrgbTables
+    {
+        float toLinear[256];
+        uint8_t toSrgb[LINEAR_TO_SRGB_STEPS + 1];
+
+        SrgbTables()
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                float c = i / 255.0f;
+                toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            for (int i = 0; i <= LINEAR_TO_SRGB_STEPS; i++)
+            {
+                float l = static_cast<float>(i) / LINEAR_TO_SRGB_STEPS;
+                float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                toSrgb[i] = static_cast<uint8_t>(std::min(255.0f, c * 255.0f + 0.5f));
+            }
+        }
+    };
+
+    const SrgbTables &srgbTables()
+    {
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    // dimezza un livello: le righe vengono elaborate per intero, così il compilatore può vettorizzare i cicli interni
+    void downsample(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight, uint8_t *dst, uint32_t dstWidth, uint32_t dstHeight, bool srgb)
+    {
+        const SrgbTables &tables = srgbTables();
+        std::vector<float> row(dstWidth * 4);
+        for (uint32_t y = 0; y < dstHeight; y++)
+        {
+            const uint8_t *row0 = src + static_cast<size_t>(std::min(2 * y, srcHeight - 1)) * srcWidth * 4;
+            const uint8_t *row1 = src + static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * 4;
+            for (uint32_t x = 0; x < dstWidth; x++)
+            {
+                uint32_t x0 = std::min(2 * x, srcWidth - 1) * 4;
+                uint32_t x1 = std::min(2 * x + 1, srcWidth - 1) * 4;
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    // l'alfa non è in sRGB
+                    if (srgb && c < 3)
+                    {
+                        row[x * 4 + c] = tables.toLinear[row0[x0 + c]] + tables.toLinear[row0[x1 + c]] +
+                                         tables.toLinear[row1[x0 + c]] + tables.toLinear[row1[x1 + c]];
+                    }
+                    else
+                    {
+                        row[x * 4 + c] = static_cast<float>(row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]);
+                    }
+                }
+            }
+            uint8_t *out = dst + static_cast<size_t>(y) * dstWidth * 4;
+            for (uint32_t i = 0; i < dstWidth * 4; i++)
+            {
+                if (srgb && i % 4 < 3)
+                {
+                    out[i] = tables.toSrgb[static_cast<int>(row[i] * 0.25f * LINEAR_TO_SRGB_STEPS + 0.5f)];
+                }
+                else
+                {
+                    out[i] = static_cast<uint8_t>(row[i] * 0.25f + 0.5f);
+                }
+            }
+        }
+    }
+}
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size /= 2)
+    {
+        levels++;
+    }
+    return levels;
+}
+
+std::vector<uint8_t> generateMipChain(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t mipLevels, bool srgb,
+                                      std::vector<size_t> &levelOffsets)
+{
+    levelOffsets.resize(mipLevels);
+    size_t totalSize = 0;
+    for (uint32_t level = 0; level < mipLevels; level++)
+    {
+        levelOffsets[level] = totalSize;
+        totalSize += static_cast<size_t>(std::max(1u, width >> level)) * std::max(1u, height >> level) * 4;
+    }
+
+    std::vector<uint8_t> chain(totalSize);
+    std::copy(pixels, pixels + static_cast<size_t>(width) * height * 4, chain.begin());
+    for (uint32_t level = 1; level < mipLevels; level++)
+    {
+        downsample(chain.data() + levelOffsets[level - 1], std::max(1u, width >> (level - 1)), std::max(1u, height >> (level - 1)),
+                   chain.data() + levelOffsets[level], std::max(1u, width >> level), std::max(1u, height >> level), srgb);
+    }
+    return chain;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Calcola il numero di livelli di mipmap di un'immagine, fino al livello di 1x1 pixel.
+ *
+ * @param width La larghezza dell'immagine.
+ * @param height L'altezza dell'immagine.
+ * @return Il numero di livelli, compreso quello a dimensione piena.
+ */
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+/**
+ * @brief Genera sulla CPU tutti i livelli di mipmap di un'immagine RGBA a 8 bit per canale.
+ *
+ * Ogni livello è la media di blocchi di 2x2 pixel del precedente (box filter); sui lati dispari l'ultimo pixel viene ripetuto.
+ * Con sRGB i colori vengono mediati in spazio lineare, come fa vkCmdBlitImage con i formati sRGB, altrimenti le texture diventano più scure da lontano.
+ * Serve quando il formato non supporta il filtro lineare nelle copie (vkCmdBlitImage) o quando l'immagine viene caricata dalla coda di trasferimento,
+ * che non può eseguire vkCmdBlitImage.
+ *
+ * @param pixels I pixel del livello 0, width * height * 4 byte.
+ * @param width La larghezza dell'immagine.
+ * @param height L'altezza dell'immagine.
+ * @param mipLevels Il numero di livelli da generare, compreso il livello 0.
+ * @param srgb true se i canali di colore sono in sRGB.
+ * @param levelOffsets La posizione di ogni livello nel risultato.
+ * @return Tutti i livelli, uno dopo l'altro a partire dal livello 0.
+ */
+std::vector<uint8_t> generateMipChain(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t mipLevels, bool srgb,
+                                      std::vector<size_t> &levelOffsets);
@@ -0,0 +1,582 @@
+#include "objParser.h"
+#include "meshCache.h"          // MappedFile
+#include "assimp/postprocess.h" // Assimp post processing flags
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+
+namespace
+{
+    // potenze di 10 rappresentabili esattamente in un double, per convertire la mantissa senza errori
+    const double powersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    inline bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline bool isDigit(char c)
+    {
+        return static_cast<unsigned char>(c - '0') < 10;
+    }
+
+    inline const char *skipSpaces(const char *p, const char *end)
+    {
+        while (p < end && isSpace(*p))
+        {
+            p++;
+        }
+        return p;
+    }
+
+    inline const char *skipToken(const char *p, const char *end)
+    {
+        while (p < end && !isSpace(*p))
+        {
+            p++;
+        }
+        return p;
+    }
+
+    // controlla con poche operazioni a 64 bit se gli 8 byte sono tutti cifre, invece di controllarli uno alla volta (tecnica SWAR)
+    inline bool isEightDigits(const char *p)
+    {
+        uint64_t val;
+        memcpy(&val, p, 8);
+        return (((val & 0xF0F0F0F0F0F0F0F0ull) | (((val + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull);
+    }
+
+    // converte 8 cifre in un numero con 3 moltiplicazioni invece di 8 (funziona sulle CPU little-endian, cioè x86 e ARM)
+    inline uint32_t parseEightDigits(const char *p)
+    {
+        uint64_t val;
+        memcpy(&val, p, 8);
+        const uint64_t mask = 0x000000FF000000FFull;
+        const uint64_t mul1 = 0x000F424000000064ull; // 100 + (1000000 << 32)
+        const uint64_t mul2 = 0x0000271000000001ull; // 1 + (10000 << 32)
+        val -= 0x3030303030303030ull;
+        val = (val * 10) + (val >> 8);
+        val = (((val & mask) * mul1) + (((val >> 16) & mask) * mul2)) >> 32;
+        return static_cast<uint32_t>(val);
+    }
+
+    // legge una sequenza di cifre nella mantissa; oltre le 19 cifre la mantissa non ci sta più in 64 bit, quindi le cifre in più vengono scartate correggendo l'esponente
+    inline const char *parseDigits(const char *p, const char *end, uint64_t &mantissa, int &digits, int &exponent, bool fraction)
+    {
+        while (digits <= 11 && end - p >= 8 && isEightDigits(p))
+        {
+            mantissa = mantissa * 100000000ull + parseEightDigits(p);
+            digits += 8;
+            if (fraction)
+            {
+                exponent -= 8;
+            }
+            p += 8;
+        }
+        while (p < end && isDigit(*p))
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                if (mantissa != 0)
+                {
+                    digits++; // gli zeri iniziali non contano
+                }
+                if (fraction)
+                {
+                    exponent--;
+                }
+            }
+            else if (!fraction)
+            {
+                exponent++;
+            }
+            p++;
+        }
+        return p;
+    }
+
+    // converte un numero decimale (es. "-1.25e-3") in float senza passare da strtof, che è molto più lenta perché gestisce il locale
+    const char *parseFloat(const char *p, const char *end, float &out)
+    {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negative = *p == '-';
+            p++;
+        }
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+        p = parseDigits(p, end, mantissa, digits, exponent, false);
+        if (p < end && *p == '.')
+        {
+            p = parseDigits(p + 1, end, mantissa, digits, exponent, true);
+        }
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            p++;
+            bool negativeExponent = false;
+            if (p < end && (*p == '-' || *p == '+'))
+            {
+                negativeExponent = *p == '-';
+                p++;
+            }
+            int e = 0;
+            while (p < end && isDigit(*p))
+            {
+                if (e < 10000)
+                {
+                    e = e * 10 + (*p - '0');
+                }
+                p++;
+            }
+            exponent += negativeExponent ? -e : e;
+        }
+        double value = static_cast<double>(mantissa);
+        if (exponent < 0)
+        {
+            value = -exponent <= 22 ? value / powersOf10[-exponent] : value * std::pow(10.0, exponent);
+        }
+        else if (exponent > 0)
+        {
+            value = exponent <= 22 ? value * powersOf10[exponent] : value * std::pow(10.0, exponent);
+        }
+        out = static_cast<float>(negative ? -value : value);
+        return p;
+    }
+
+    // legge un intero con segno, usato per gli indici delle facce
+    inline const char *parseInt(const char *p, const char *end, int64_t &out)
+    {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negative = *p == '-';
+            p++;
+        }
+        int64_t value = 0;
+        while (p < end && isDigit(*p))
+        {
+            value = value * 10 + (*p - '0');
+            p++;
+        }
+        out = negative ? -value : value;
+        return p;
+    }
+
+    // una terna di indici v/vt/vn già convertiti a base 0, -1 se manca
+    struct VertexKey
+    {
+        int32_t position;
+        int32_t texCoord;
+        int32_t normal;
+    };
+
+    /**
+     * Tabella hash a indirizzamento aperto (tutte le chiavi in un unico array) che associa a ogni terna v/vt/vn l'indice del vertice già creato.
+     * Rispetto a std::unordered_map non alloca un nodo per ogni elemento, quindi è molto più veloce con centinaia di migliaia di vertici.
+     */
+    class VertexHashTable
+    {
+    public:
+        explicit VertexHashTable(size_t expected)
+        {
+            size_t capacity = 1024;
+            while (capacity < expected * 2)
+            {
+                capacity *= 2;
+            }
+            keys.resize(capacity);
+            values.assign(capacity, EMPTY);
+        }
+
+        // restituisce l'indice del vertice con questa terna; se non c'è ancora lo inserisce con newIndex e imposta inserted a true
+        uint32_t findOrInsert(const VertexKey &key, uint32_t newIndex, bool &inserted)
+        {
+            if ((count + 1) * 2 > keys.size())
+            {
+                grow();
+            }
+            size_t mask = keys.size() - 1;
+            for (size_t slot = hash(key) & mask;; slot = (slot + 1) & mask)
+            {
+                if (values[slot] == EMPTY)
+                {
+                    keys[slot] = key;
+                    values[slot] = newIndex;
+                    count++;
+                    inserted = true;
+                    return newIndex;
+                }
+                if (keys[slot].position == key.position && keys[slot].texCoord == key.texCoord && keys[slot].normal == key.normal)
+                {
+                    inserted = false;
+                    return values[slot];
+                }
+            }
+        }
+
+    private:
+        static constexpr uint32_t EMPTY = UINT32_MAX;
+
+        static size_t hash(const VertexKey &key)
+        {
+            uint64_t h = static_cast<uint32_t>(key.position) * 0x9E3779B97F4A7C15ull;
+            h ^= static_cast<uint32_t>(key.texCoord) * 0xC2B2AE3D27D4EB4Full;
+            h ^= static_cast<uint32_t>(key.normal) * 0x165667B19E3779F9ull;
+            return static_cast<size_t>(h ^ (h >> 29));
+        }
+
+        void grow()
+        {
+            std::vector<VertexKey> oldKeys = std::move(keys);
+            std::vector<uint32_t> oldValues = std::move(values);
+            keys.assign(oldKeys.size() * 2, VertexKey{});
+            values.assign(oldKeys.size() * 2, EMPTY);
+            count = 0;
+            bool inserted;
+            for (size_t i = 0; i < oldKeys.size(); i++)
+            {
+                if (oldValues[i] != EMPTY)
+                {
+                    findOrInsert(oldKeys[i], oldValues[i], inserted);
+                }
+            }
+        }
+
+        std::vector<VertexKey> keys;
+        std::vector<uint32_t> values;
+        size_t count = 0;
+    };
+
+    // confronta due vertici bit per bit, così come fa aiProcess_JoinIdenticalVertices
+    inline bool sameVertex(const Vertex &a, const Vertex &b)
+    {
+        return memcmp(&a, &b, sizeof(Vertex)) == 0;
+    }
+
+    inline size_t hashVertex(const Vertex &v)
+    {
+        // FNV-1a sui byte del vertice
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&v);
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < sizeof(Vertex); i++)
+        {
+            h ^= bytes[i];
+            h *= 1099511628211ull;
+        }
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+
+    // unisce i vertici con gli stessi valori anche se nel file hanno indici diversi (molti esportatori scrivono un v/vt/vn diverso per ogni angolo di ogni faccia)
+    void weldIdenticalVertices(MeshData &data)
+    {
+        size_t capacity = 1024;
+        while (capacity < data.vertices.size() * 2)
+        {
+            capacity *= 2;
+        }
+        std::vector<uint32_t> table(capacity, UINT32_MAX); // indice del vertice già inserito in ogni posizione della tabella
+        std::vector<uint32_t> remap(data.vertices.size());
+        std::vector<Vertex> unique;
+        unique.reserve(data.vertices.size());
+        for (size_t i = 0; i < data.vertices.size(); i++)
+        {
+            const Vertex &vertex = data.vertices[i];
+            for (size_t slot = hashVertex(vertex) & (capacity - 1);; slot = (slot + 1) & (capacity - 1))
+            {
+                if (table[slot] == UINT32_MAX)
+                {
+                    table[slot] = static_cast<uint32_t>(unique.size());
+                    remap[i] = table[slot];
+                    unique.push_back(vertex);
+                    break;
+                }
+                if (sameVertex(unique[table[slot]], vertex))
+                {
+                    remap[i] = table[slot];
+                    break;
+                }
+            }
+        }
+        if (unique.size() == data.vertices.size())
+        {
+            return;
+        }
+        for (uint32_t &index : data.indices)
+        {
+            index = remap[index];
+        }
+        data.vertices.swap(unique);
+    }
+
+    // restituisce la cartella che contiene il file, con la "/" finale (stringa vuota se il file è nella cartella corrente)
+    std::string directoryOf(const std::string &path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    // legge un file .mtl e associa il nome di ogni materiale al percorso della sua texture diffusa
+    void parseMtl(const std::string &path, std::unordered_map<std::string, std::string> &textures)
+    {
+        MappedFile file;
+        if (!file.open(path))
+        {
+            std::cerr << "impossibile aprire il materiale " << path << std::endl;
+            return;
+        }
+        std::string directory = directoryOf(path);
+        const char *p = reinterpret_cast<const char *>(file.data());
+        const char *end = p + file.size();
+        std::string current;
+        while (p < end)
+        {
+            const char *lineEnd = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (!lineEnd)
+            {
+                lineEnd = end;
+            }
+            p = skipSpaces(p, lineEnd);
+            const char *keyEnd = skipToken(p, lineEnd);
+            std::string key(p, keyEnd);
+            if (key == "newmtl" || key == "map_Kd")
+            {
+                // il valore è l'ultima parola della riga (map_Kd può avere delle opzioni prima del nome del file)
+                const char *valueEnd = lineEnd;
+                while (valueEnd > keyEnd && isSpace(valueEnd[-1]))
+                {
+                    valueEnd--;
+                }
+                const char *valueStart = valueEnd;
+                while (valueStart > keyEnd && !isSpace(valueStart[-1]))
+                {
+                    valueStart--;
+                }
+                std::string value(valueStart, valueEnd);
+                if (key == "newmtl")
+                {
+                    current = value;
+                    textures[current]; // il materiale esiste anche se non ha una texture
+                }
+                else if (!current.empty() && !value.empty())
+                {
+                    textures[current] = directory + value;
+                }
+            }
+            p = lineEnd + 1;
+        }
+    }
+}
+
+bool parseObjMeshData(const std::string &filename, unsigned int flags, MeshData &out)
+{
+    MappedFile file;
+    if (!file.open(filename))
+    {
+        std::cerr << "ERROR::OBJ::impossibile aprire " << filename << std::endl;
+        return false;
+    }
+    const char *p = reinterpret_cast<const char *>(file.data());
+    const char *end = p + file.size();
+    std::string directory = directoryOf(filename);
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+    std::vector<int32_t> vertexPositions; // per ogni vertice creato, l'indice della sua posizione (serve per calcolare le normali)
+    std::unordered_map<std::string, std::string> materialTextures;
+    std::vector<std::string> subMeshMaterials;
+    uint32_t subMeshStart = 0;
+    std::string currentMaterial;
+    bool usesMaterials = false;
+
+    out.vertices.clear();
+    out.indices.clear();
+    out.subMeshes.clear();
+    out.textureFiles.clear();
+
+    // una riga di un file obj è lunga in media una trentina di byte, quindi stimiamo da lì il numero di vertici
+    VertexHashTable vertexTable(file.size() / 64);
+    std::vector<uint32_t> polygon;
+    size_t lineNumber = 0;
+
+    while (p < end)
+    {
+        lineNumber++;
+        // memchr è ottimizzata con istruzioni SIMD dalla libreria standard, quindi trovare la fine della riga costa pochissimo
+        const char *lineEnd = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!lineEnd)
+        {
+            lineEnd = end;
+        }
+        p = skipSpaces(p, lineEnd);
+        if (lineEnd - p >= 2 && p[0] == 'v' && isSpace(p[1]))
+        {
+            glm::vec3 v;
+            p = parseFloat(skipSpaces(p + 2, lineEnd), lineEnd, v.x);
+            p = parseFloat(skipSpaces(p, lineEnd), lineEnd, v.y);
+            p = parseFloat(skipSpaces(p, lineEnd), lineEnd, v.z);
+            positions.push_back(v);
+        }
+        else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 't' && isSpace(p[2]))
+        {
+            glm::vec2 t(0.0f);
+            p = parseFloat(skipSpaces(p + 3, lineEnd), lineEnd, t.x);
+            p = skipSpaces(p, lineEnd);
+            if (p < lineEnd)
+            {
+                p = parseFloat(p, lineEnd, t.y);
+            }
+            texCoords.push_back(t);
+        }
+        else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n' && isSpace(p[2]))
+        {
+            glm::vec3 n;
+            p = parseFloat(skipSpaces(p + 3, lineEnd), lineEnd, n.x);
+            p = parseFloat(skipSpaces(p, lineEnd), lineEnd, n.y);
+            p = parseFloat(skipSpaces(p, lineEnd), lineEnd, n.z);
+            normals.push_back(n);
+        }
+        else if (lineEnd - p >= 2 && p[0] == 'f' && isSpace(p[1]))
+        {
+            polygon.clear();
+            p = skipSpaces(p + 2, lineEnd);
+            while (p < lineEnd)
+            {
+                // ogni vertice della faccia può essere v, v/vt, v//vn oppure v/vt/vn, gli indici negativi contano a ritroso dall'ultimo elemento letto
+                int64_t index[3] = {0, 0, 0};
+                p = parseInt(p, lineEnd, index[0]);
+                for (int k = 1; k < 3 && p < lineEnd && *p == '/'; k++)
+                {
+                    p++;
+                    if (p < lineEnd && *p != '/')
+                    {
+                        p = parseInt(p, lineEnd, index[k]);
+                    }
+                }
+                const int64_t counts[3] = {static_cast<int64_t>(positions.size()), static_cast<int64_t>(texCoords.size()), static_cast<int64_t>(normals.size())};
+                int32_t resolved[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    int64_t i = index[k] < 0 ? counts[k] + index[k] : index[k] - 1;
+                    if (index[k] == 0)
+                    {
+                        i = -1;
+                    }
+                    else if (i < 0 || i >= counts[k])
+                    {
+                        std::cerr << "ERROR::OBJ::" << filename << ":" << lineNumber << ": indice fuori dal limite" << std::endl;
+                        return false;
+                    }
+                    resolved[k] = static_cast<int32_t>(i);
+                }
+                if (resolved[0] < 0)
+                {
+                    std::cerr << "ERROR::OBJ::" << filename << ":" << lineNumber << ": faccia senza posizione" << std::endl;
+                    return false;
+                }
+
+                bool inserted;
+                uint32_t vertexIndex = vertexTable.findOrInsert({resolved[0], resolved[1], resolved[2]}, static_cast<uint32_t>(out.vertices.size()), inserted);
+                if (inserted)
+                {
+                    Vertex vertex{};
+                    vertex.pos = positions[resolved[0]];
+                    vertex.normal = resolved[2] >= 0 ? normals[resolved[2]] : glm::vec3(0.0f);
+                    vertex.texCoord = resolved[1] >= 0 ? texCoords[resolved[1]] : glm::vec2(0.0f);
+                    if (flags & aiProcess_FlipUVs)
+                    {
+                        vertex.texCoord.y = 1.0f - vertex.texCoord.y;
+                    }
+                    out.vertices.push_back(vertex);
+                    vertexPositions.push_back(resolved[0]);
+                }
+                polygon.push_back(vertexIndex);
+                p = skipSpaces(skipToken(p, lineEnd), lineEnd);
+            }
+            // triangoliamo il poligono a ventaglio partendo dal primo vertice
+            for (size_t k = 2; k < polygon.size(); k++)
+            {
+                out.indices.push_back(polygon[0]);
+                out.indices.push_back(polygon[k - 1]);
+                out.indices.push_back(polygon[k]);
+            }
+        }
+        else if (lineEnd - p > 7 && memcmp(p, "usemtl", 6) == 0 && isSpace(p[6]))
+        {
+            const char *nameStart = skipSpaces(p + 7, lineEnd);
+            const char *nameEnd = lineEnd;
+            while (nameEnd > nameStart && isSpace(nameEnd[-1]))
+            {
+                nameEnd--;
+            }
+            // ogni cambio di materiale chiude la sub-mesh precedente
+            if (out.indices.size() > subMeshStart)
+            {
+                out.subMeshes.emplace_back(subMeshStart, static_cast<uint32_t>(out.indices.size()) - subMeshStart, -1);
+                subMeshMaterials.push_back(currentMaterial);
+                subMeshStart = static_cast<uint32_t>(out.indices.size());
+            }
+            currentMaterial.assign(nameStart, nameEnd);
+            usesMaterials = true;
+        }
+        else if (lineEnd - p > 7 && memcmp(p, "mtllib", 6) == 0 && isSpace(p[6]))
+        {
+            const char *nameStart = skipSpaces(p + 7, lineEnd);
+            const char *nameEnd = lineEnd;
+            while (nameEnd > nameStart && isSpace(nameEnd[-1]))
+            {
+                nameEnd--;
+            }
+            parseMtl(directory + std::string(nameStart, nameEnd), materialTextures);
+        }
+        // tutte le altre righe (commenti, o, g, s, ...) vengono ignorate
+        p = lineEnd + 1;
+    }
+
+    if (usesMaterials && out.indices.size() > subMeshStart)
+    {
+        out.subMeshes.emplace_back(subMeshStart, static_cast<uint32_t>(out.indices.size()) - subMeshStart, -1);
+        subMeshMaterials.push_back(currentMaterial);
+    }
+    for (const std::string &material : subMeshMaterials)
+    {
+        auto it = materialTextures.find(material);
+        out.textureFiles.push_back(it != materialTextures.end() ? it->second : std::string());
+    }
+
+    // se il file non ha le normali le calcoliamo come media delle normali delle facce che condividono la stessa posizione, come fa Assimp
+    if (normals.empty() && (flags & aiProcess_GenSmoothNormals))
+    {
+        std::vector<glm::vec3> positionNormals(positions.size(), glm::vec3(0.0f));
+        for (size_t i = 0; i + 2 < out.indices.size(); i += 3)
+        {
+            int32_t a = vertexPositions[out.indices[i]];
+            int32_t b = vertexPositions[out.indices[i + 1]];
+            int32_t c = vertexPositions[out.indices[i + 2]];
+            // il prodotto vettoriale non normalizzato pesa ogni faccia per la sua area
+            glm::vec3 faceNormal = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+            positionNormals[a] += faceNormal;
+            positionNormals[b] += faceNormal;
+            positionNormals[c] += faceNormal;
+        }
+        for (size_t i = 0; i < out.vertices.size(); i++)
+        {
+            glm::vec3 n = positionNormals[vertexPositions[i]];
+            float length = glm::length(n);
+            out.vertices[i].normal = length > 0.0f ? n / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    }
+
+    if (flags & aiProcess_JoinIdenticalVertices)
+    {
+        weldIdenticalVertices(out);
+    }
+
+    computeBounds(out);
+    return true;
+}
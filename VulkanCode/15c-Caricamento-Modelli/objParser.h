@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include "meshData.h"
+
+/**
+ * @brief Legge un file .obj (e il suo .mtl) senza passare da Assimp.
+ *
+ * Il file viene mappato in memoria e letto riga per riga con un parser scritto apposta per il formato OBJ:
+ * i numeri vengono convertiti senza strtof e le terne v/vt/vn già viste vengono riconosciute con una tabella hash,
+ * così ogni vertice diverso viene creato una volta sola. I poligoni con più di 3 lati vengono divisi in triangoli a ventaglio.
+ *
+ * Dei flag di Assimp vengono considerati solo aiProcess_FlipUVs, aiProcess_GenSmoothNormals (usato solo se il file non ha normali)
+ * e aiProcess_JoinIdenticalVertices (unisce anche i vertici con indici diversi ma valori uguali), la triangolazione viene fatta sempre.
+ * Ogni cambio di materiale (usemtl) crea una nuova sub-mesh, con il percorso della sua texture diffusa (map_Kd) in MeshData::textureFiles.
+ *
+ * @param filename Il percorso del file .obj.
+ * @param flags I flag di post-elaborazione di Assimp.
+ * @param out I dati del modello letto.
+ * @return true se il file è stato letto, false altrimenti.
+ */
+bool parseObjMeshData(const std::string &filename, unsigned int flags, MeshData &out);
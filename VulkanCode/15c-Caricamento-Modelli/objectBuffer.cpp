@@ -0,0 +1,73 @@
+#include "objectBuffer.h"
+#include "bufferUtils.h"
+#include <stdexcept>
+#include <algorithm>
+
+ObjectBuffer::ObjectBuffer(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t capacity, uint32_t frameCount, VkMemoryPropertyFlags memoryProperties)
+    : device(device), capacity(capacity)
+{
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 1);
+    frameSize = (sizeof(ObjectData) * capacity + alignment - 1) / alignment * alignment;
+
+    createBuffer(device, physicalDevice, frameSize * frameCount,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 memoryProperties, MemoryCategory::Uniform,
+                 buffer, bufferMemory);
+    mapped = static_cast<uint8_t *>(bufferMemory.mapped);
+    objects = reinterpret_cast<ObjectData *>(mapped);
+}
+
+ObjectBuffer::~ObjectBuffer()
+{
+    destroyBuffer(device, buffer, bufferMemory);
+}
+
+void ObjectBuffer::beginFrame(uint32_t frameIndex)
+{
+    objects = reinterpret_cast<ObjectData *>(mapped + getFrameOffset(frameIndex));
+    count = 0;
+}
+
+uint32_t ObjectBuffer::reserve(uint32_t objectCount)
+{
+    if (objectCount > capacity - count)
+    {
+        throw std::runtime_error("object buffer frame is full!");
+    }
+    uint32_t first = count;
+    count += objectCount;
+    peakCount = std::max(peakCount, count);
+    return first;
+}
+
+void ObjectBuffer::write(uint32_t index, const glm::mat4 &model, uint32_t textureIndex)
+{
+    // la memoria è write-combined: la struttura viene preparata qui e copiata con una sola scrittura
+    ObjectData data{};
+    data.model = model;
+    data.normalMatrix = glm::transpose(glm::inverse(model));
+    data.textureIndex = textureIndex;
+    objects[index] = data;
+}
+
+uint32_t ObjectBuffer::getFrameOffset(uint32_t frameIndex) const
+{
+    return static_cast<uint32_t>(frameSize * frameIndex);
+}
+
+VkBuffer ObjectBuffer::getBuffer() const
+{
+    return buffer;
+}
+
+VkDeviceSize ObjectBuffer::getRange() const
+{
+    return sizeof(ObjectData) * capacity;
+}
+
+uint32_t ObjectBuffer::getPeakObjectCount() const
+{
+    return peakCount;
+}
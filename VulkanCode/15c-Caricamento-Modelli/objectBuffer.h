@@ -0,0 +1,135 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "deviceAllocator.h"
+
+/**
+ * @brief Dati di un oggetto disegnato, letti dalla vertex shader con gl_InstanceIndex.
+ *
+ * La matrice delle normali viene calcolata una volta sola sulla CPU, invece di invertire la matrice del modello per ogni vertice.
+ * Ha lo stesso layout (std430) della struttura ObjectData in 14.vert.
+ */
+struct ObjectData
+{
+    glm::mat4 model;        // matrice di trasformazione del modello
+    glm::mat4 normalMatrix; // trasposta dell'inversa di model, la shader usa solo la parte 3x3
+    uint32_t textureIndex;  // posto della texture nella tabella, OBJECT_MESH_TEXTURE per usare quelle della mesh
+    uint32_t _pad[3];       // in modo da allineare a 16 byte, come l'array in std430
+};
+
+// valore di ObjectData::textureIndex per gli oggetti che usano le texture della loro mesh (e delle sue sub-mesh)
+const uint32_t OBJECT_MESH_TEXTURE = UINT32_MAX;
+
+/**
+ * @brief Una copia di una mesh disegnata con l'instancing (vedi Mesh::draw con instanceCount).
+ */
+struct MeshInstance
+{
+    glm::mat4 transform = glm::mat4(1.0f); // trasformazione della copia, applicata prima di quella dell'oggetto
+    int32_t textureIndex = -1;             // posto della texture nella tabella, -1 per usare quelle della mesh
+};
+
+/**
+ * @brief Storage buffer con un array di ObjectData per ogni frame in volo.
+ *
+ * Ogni oggetto disegnato nel frame ha un posto nell'array del frame: il suo indice viene passato come firstInstance
+ * al comando di disegno e la vertex shader lo legge come gl_InstanceIndex.
+ * Le copie di una mesh disegnata con l'instancing hanno posti consecutivi, così la copia i di un solo comando di disegno legge l'elemento firstInstance + i.
+ * L'array del frame viene scelto con l'offset dinamico di un descriptor VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC (vedi getFrameOffset),
+ * quindi basta un solo descriptor set per tutti gli oggetti e tutti i frame.
+ * Per registrare i comandi su più thread i posti vengono prima riservati con reserve, dal thread principale,
+ * e poi scritti con write da qualsiasi thread, purché ogni posto sia scritto da un solo thread.
+ * Le altre funzioni vanno usate solo dal thread principale.
+ */
+class ObjectBuffer
+{
+public:
+    /**
+     * @brief Costruttore della classe ObjectBuffer.
+     *
+     * Crea il buffer, con un array di capacity oggetti per ogni frame in volo, e lo mappa.
+     *
+     * @param device Il dispositivo Vulkan su cui operare.
+     * @param physicalDevice Il dispositivo fisico Vulkan, per l'allineamento degli offset.
+     * @param capacity Il numero massimo di oggetti disegnati in un frame.
+     * @param frameCount Il numero di frame in volo.
+     * @param memoryProperties Le proprietà della memoria, devono comprendere host visible e host coherent.
+     */
+    ObjectBuffer(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t capacity, uint32_t frameCount, VkMemoryPropertyFlags memoryProperties);
+
+    /**
+     * @brief Distruttore della classe ObjectBuffer.
+     *
+     * Distrugge il buffer: la GPU non deve più usarlo.
+     */
+    ~ObjectBuffer();
+
+    /**
+     * @brief Svuota l'array di un frame, che diventa quello in cui reserve e write lavorano.
+     *
+     * Va chiamato dopo aver aspettato la fence del frame, perché gli oggetti scritti nel suo giro precedente vengono sovrascritti.
+     *
+     * @param frameIndex Il frame in volo.
+     */
+    void beginFrame(uint32_t frameIndex);
+
+    /**
+     * @brief Riserva dei posti consecutivi nell'array del frame corrente, senza scriverli.
+     *
+     * @param objectCount Il numero di posti.
+     * @return L'indice del primo posto.
+     * @throws std::runtime_error Se i posti non entrano nell'array del frame.
+     */
+    uint32_t reserve(uint32_t objectCount);
+
+    /**
+     * @brief Scrive i dati di un oggetto, calcolando la sua matrice delle normali, in un posto riservato con reserve.
+     *
+     * Può essere chiamata da più thread insieme, su posti diversi.
+     *
+     * @param index Il posto dell'oggetto.
+     * @param model La matrice di trasformazione dell'oggetto.
+     * @param textureIndex Il posto della texture nella tabella, OBJECT_MESH_TEXTURE per usare quelle della mesh.
+     */
+    void write(uint32_t index, const glm::mat4 &model, uint32_t textureIndex = OBJECT_MESH_TEXTURE);
+
+    /**
+     * @brief Restituisce l'offset dinamico dell'array di un frame, da passare a vkCmdBindDescriptorSets.
+     * @param frameIndex Il frame in volo.
+     * @return L'offset in byte dell'array del frame.
+     */
+    uint32_t getFrameOffset(uint32_t frameIndex) const;
+
+    /**
+     * @brief Restituisce il buffer, da scrivere nel descriptor set con offset 0.
+     * @return Lo storage buffer.
+     */
+    VkBuffer getBuffer() const;
+
+    /**
+     * @brief Restituisce la dimensione dell'array di un frame, da usare come range del descriptor.
+     * @return La dimensione in byte di capacity oggetti.
+     */
+    VkDeviceSize getRange() const;
+
+    /**
+     * @brief Restituisce il numero massimo di oggetti aggiunti in un frame, per dimensionare l'array.
+     * @return Il picco degli oggetti di un frame.
+     */
+    uint32_t getPeakObjectCount() const;
+
+private:
+    VkDevice device;
+    uint32_t capacity;
+    VkDeviceSize frameSize; // dimensione dell'array di ogni frame, multipla di minStorageBufferOffsetAlignment
+
+    VkBuffer buffer;
+    DeviceAllocation bufferMemory;
+    ObjectData *objects = nullptr; // array del frame corrente nella memoria mappata dall'allocatore
+
+    uint8_t *mapped;
+    uint32_t count = 0; // oggetti aggiunti nel frame corrente
+    uint32_t peakCount = 0;
+};
@@ -0,0 +1,83 @@
+#include "samplerCache.h"
+#include <stdexcept>
+#include <tuple>
+#include <algorithm>
+
+bool SamplerState::operator<(const SamplerState &other) const
+{
+    return std::tie(magFilter, minFilter, mipmapMode, addressModeU, addressModeV, addressModeW, maxAnisotropy, mipLodBias, minLod, maxLod) <
+           std::tie(other.magFilter, other.minFilter, other.mipmapMode, other.addressModeU, other.addressModeV, other.addressModeW,
+                    other.maxAnisotropy, other.mipLodBias, other.minLod, other.maxLod);
+}
+
+SamplerCache::SamplerCache(VkDevice device, VkPhysicalDevice physicalDevice) : device(device)
+{
+    // nelle proprietà del dispositivo fisico ci sono i limiti del dispositivo, ci serve il massimo valore di anisotropia supportato
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    maxSamplerAnisotropy = properties.limits.maxSamplerAnisotropy;
+}
+
+SamplerCache::~SamplerCache()
+{
+    for (auto &[state, sampler] : samplers)
+    {
+        vkDestroySampler(device, sampler, nullptr);
+    }
+}
+
+VkSampler SamplerCache::get(const SamplerState &state)
+{
+    auto it = samplers.find(state);
+    if (it != samplers.end())
+    {
+        return it->second;
+    }
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = state.magFilter;
+    samplerInfo.minFilter = state.minFilter;
+    /*
+    VK_SAMPLER_ADDRESS_MODE_REPEAT: Ripete la texture quando si superano le dimensioni dell'immagine.
+    VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT: Come repeat, ma inverte le coordinate per specchiare l'immagine quando si superano le dimensioni.
+    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE: Prende il colore del bordo più vicino alla coordinata oltre i limiti dell'immagine.
+    VK_SAMPLER_ADDRESS_MODE_MIRROR_CLAMP_TO_EDGE: Come clamp to edge, ma usa il bordo opposto a quello più vicino.
+    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER: Restituisce un colore solido quando si campiona oltre le dimensioni dell'immagine.
+    */
+    samplerInfo.addressModeU = state.addressModeU;
+    samplerInfo.addressModeV = state.addressModeV;
+    samplerInfo.addressModeW = state.addressModeW;
+    samplerInfo.anisotropyEnable = state.maxAnisotropy > 0.0f ? VK_TRUE : VK_FALSE;
+    samplerInfo.maxAnisotropy = std::min(state.maxAnisotropy, maxSamplerAnisotropy); // più basso è il valore, più bassa è la qualità ma più alta la performance
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;  // usato solo con VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;              // se è true, le coordinate non sono normalizzate, quindi vanno da 0 a 1
+    samplerInfo.compareEnable = VK_FALSE;                        // se fosse true, i texel verrebbero confrontati con un valore
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+
+    // per il mipmapping
+    samplerInfo.mipmapMode = state.mipmapMode;
+    samplerInfo.mipLodBias = state.mipLodBias;
+    samplerInfo.minLod = state.minLod;
+    samplerInfo.maxLod = state.maxLod;
+
+    VkSampler sampler;
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create texture sampler!");
+    }
+    samplers[state] = sampler;
+    return sampler;
+}
+
+SamplerState SamplerCache::textureState() const
+{
+    SamplerState state;
+    state.maxAnisotropy = maxSamplerAnisotropy;
+    return state;
+}
+
+size_t SamplerCache::size() const
+{
+    return samplers.size();
+}
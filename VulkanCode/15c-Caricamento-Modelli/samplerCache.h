@@ -0,0 +1,79 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <map>
+#include <cstddef>
+
+/**
+ * @brief Stato completo di un sampler, usato come chiave della cache dei sampler.
+ */
+struct SamplerState
+{
+    VkFilter magFilter = VK_FILTER_LINEAR;
+    VkFilter minFilter = VK_FILTER_LINEAR;
+    VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    VkSamplerAddressMode addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    VkSamplerAddressMode addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    VkSamplerAddressMode addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    float maxAnisotropy = 0.0f; // 0 disattiva il filtro anisotropico, valori più alti vengono limitati a quello massimo del dispositivo
+    float mipLodBias = 0.0f;
+    float minLod = 0.0f;
+    float maxLod = VK_LOD_CLAMP_NONE; // senza limite il sampler usa tutti i livelli della view, quindi va bene per texture con qualunque numero di mipmap
+
+    bool operator<(const SamplerState &other) const;
+};
+
+/**
+ * @brief Cache dei sampler: crea un solo VkSampler per ogni stato diverso e lo condivide tra tutte le texture.
+ *
+ * Il sampler non dipende dall'immagine, quindi texture con lo stesso filtro e lo stesso indirizzamento possono usare lo stesso oggetto:
+ * il numero di sampler resta fisso anche con centinaia di texture, lontano dal limite maxSamplerAllocationCount del dispositivo.
+ * I sampler restano validi finché esiste la cache, quindi possono essere usati anche come immutable sampler nei descriptor set layout.
+ * Non è thread safe: va usata solo dal thread principale.
+ */
+class SamplerCache
+{
+public:
+    /**
+     * @brief Costruttore della classe SamplerCache.
+     *
+     * Legge una volta sola i limiti del dispositivo che servono ai sampler.
+     *
+     * @param device Il dispositivo Vulkan su cui operare.
+     * @param physicalDevice Il dispositivo fisico Vulkan.
+     */
+    SamplerCache(VkDevice device, VkPhysicalDevice physicalDevice);
+
+    /**
+     * @brief Distruttore della classe SamplerCache.
+     *
+     * Distrugge tutti i sampler: nessun descriptor set layout o comando ancora in uso deve riferirsi a loro.
+     */
+    ~SamplerCache();
+
+    /**
+     * @brief Restituisce il sampler con lo stato indicato, creandolo se non esiste ancora.
+     *
+     * @param state Lo stato del sampler.
+     * @return Il sampler, da non distruggere: appartiene alla cache.
+     * @throws std::runtime_error Se il sampler non può essere creato.
+     */
+    VkSampler get(const SamplerState &state);
+
+    /**
+     * @brief Restituisce lo stato usato per le texture dei modelli: filtro lineare, ripetizione e il massimo filtro anisotropico del dispositivo.
+     * @return Lo stato del sampler delle texture.
+     */
+    SamplerState textureState() const;
+
+    /**
+     * @brief Restituisce il numero di sampler creati.
+     * @return Il numero di sampler diversi nella cache.
+     */
+    size_t size() const;
+
+private:
+    VkDevice device;
+    float maxSamplerAnisotropy; // limite del dispositivo, letto una volta sola invece che per ogni texture
+
+    std::map<SamplerState, VkSampler> samplers;
+};
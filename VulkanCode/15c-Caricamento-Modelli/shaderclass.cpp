@@ -8,6 +8,9 @@
 #include <fstream>
 namespace fs = std::filesystem;
 
+// varianti delle fragment shader che compile.bat (o compile.sh) compila accanto a quella normale, con un #define diverso
+static const char *FRAGMENT_VARIANTS[] = {"uniform"};
+
 static std::vector<char> readFile(const std::string &filename)
 {
     // std::ios::ate ci permette di posizionare il puntatore alla fine del file, così possiamo ottenere la dimensione del file in un colpo solo così da allocare la memoria necessaria
@@ -54,7 +57,7 @@ bool ShaderClass::init()
     return true;
 }
 
-void ShaderClass::enable()
+void ShaderClass::enable(const std::string &fragmentVariant)
 {
     // Abilita gli shader compilati
     if (vertShaderModule != VK_NULL_HANDLE)
@@ -70,7 +73,12 @@ void ShaderClass::enable()
         if (shader.type == "vertex")
             vertShaderModule = createShaderModule(readFile(shader.compiledPath));
         else if (shader.type == "fragment")
-            fragShaderModule = createShaderModule(readFile(shader.compiledPath));
+        {
+            std::string path = shader.compiledPath;
+            if (!fragmentVariant.empty())
+                path.replace(path.size() - 4, 4, "." + fragmentVariant + ".spv"); // es. 14.frag.spv -> 14.frag.uniform.spv
+            fragShaderModule = createShaderModule(readFile(path));
+        }
     }
 }
 
@@ -123,7 +131,14 @@ bool ShaderClass::compileAllIfNeeded()
         std::string baseName = entry.path().filename().string(); // es. triangle.vert
         std::string outputPath = "compiled/" + baseName + ".spv";
 
-        if (needsRecompile(path, outputPath))
+        bool recompile = needsRecompile(path, outputPath);
+        if (ext == ".frag")
+        {
+            for (const char *variant : FRAGMENT_VARIANTS)
+                recompile |= needsRecompile(path, "compiled/" + baseName + "." + variant + ".spv");
+        }
+
+        if (recompile)
         {
             std::cout << "Compilazione necessaria per: " << baseName << "\n";
             allCompiled = false;
@@ -131,10 +146,18 @@ bool ShaderClass::compileAllIfNeeded()
     }
     if (!allCompiled)
     {
+#ifdef _WIN32
         std::system("start cmd /K compile.bat");
         // essendo che l'applicazione è da riavviare per forza, non ha senso continuare
         std::cerr << "[INFO] Shader compilati. Riavvia manualmente l'applicazione." << std::endl;
         throw std::runtime_error("riavvio necessario per la compilazione delle shader");
+#else
+        // compile.sh finisce prima di restituire il controllo, quindi si possono caricare subito gli shader compilati
+        if (std::system("sh compile.sh") != 0)
+        {
+            return false;
+        }
+#endif
     }
 
     shaders.clear();
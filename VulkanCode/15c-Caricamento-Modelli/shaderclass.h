@@ -71,8 +71,9 @@ public:
 
     /**
      * @brief Abilita i moduli shader e crea i moduli shader Vulkan.
+     * @param fragmentVariant La variante della fragment shader creata da compile.bat (per esempio "uniform" per 14.frag.uniform.spv), vuota per quella normale.
      */
-    void enable();
+    void enable(const std::string &fragmentVariant = "");
 
     /**
      * @brief Disabilita i moduli shader e rilascia le risorse Vulkan.
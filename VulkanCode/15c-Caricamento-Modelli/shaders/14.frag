@@ -1,16 +1,22 @@
 #version 450
 
+// la texture cambia da una copia all'altra dentro lo stesso disegno, quindi l'indice va marcato come non uniforme;
+// compile.bat crea anche una variante con UNIFORM_TEXTURE_INDEX per i dispositivi senza shaderSampledImageArrayNonUniformIndexing,
+// che usa solo la texture della push constant (uguale per tutto il disegno)
+#ifndef UNIFORM_TEXTURE_INDEX
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
 //input della shader
 layout(location = 0) in vec3 fragNormal;
 layout(location = 1) in vec3 fragPos;
 layout(location = 2) in vec2 fragTextCoord;
-layout(location = 3) flat in uint textureIndex;
+layout(location = 3) flat in uint textureIndex; // texture della copia dell'oggetto, 0xFFFFFFFF se usa quella della sub-mesh
 
 //output della shader
 layout(location = 0) out vec4 outColor;  
 
 struct SceneMatrices {
-    mat4 transform;
     mat4 view;
     mat4 proj;
 };
@@ -51,10 +57,18 @@ layout(push_constant) uniform PushConstants {
     uint textureIndex;
 } push;
 
-layout(binding = 1) uniform sampler2D textures[8];
+// numero di posti della tabella delle texture, impostato dalla pipeline con una specialization constant (vedi textureTable.h)
+layout(constant_id = 1) const uint TEXTURE_TABLE_SIZE = 16;
+// tabella globale delle texture nel set 1, il set 0 contiene il buffer uniforme del frame e i dati degli oggetti
+layout(set = 1, binding = 0) uniform sampler2D textures[TEXTURE_TABLE_SIZE];
 
 void main() {
+#ifdef UNIFORM_TEXTURE_INDEX
 	vec4 material_color = texture(textures[push.textureIndex], fragTextCoord);
+#else
+	uint texture_index = textureIndex != 0xFFFFFFFFu ? textureIndex : push.textureIndex;
+	vec4 material_color = texture(textures[nonuniformEXT(texture_index)], fragTextCoord);
+#endif
 
 	vec3 normal = normalize(fragNormal);
 	vec3 lightDir = normalize(ubo.pointLight.position - fragPos); 
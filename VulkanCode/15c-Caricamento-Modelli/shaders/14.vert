@@ -1,64 +1,71 @@
 #version 450
 
 //input della shader
-layout(location = 0) in vec3 inPosition;
+// con i formati compressi (vedi vertexFormat.h) la posizione arriva come unorm16 relativa al bounding box
+// e la normale come 2 valori snorm16 in codifica ottaedrica, la terza componente vale 0
+layout(location = 0) in vec4 inPosition;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec2 texCoord;
 
+// vale true quando la pipeline usa un formato compresso, viene impostata con una specialization constant
+layout(constant_id = 0) const bool PACKED_NORMALS = false;
+
 //output della shader
 layout(location = 0) out vec3 fragNormal;
 layout(location = 1) out vec3 fragPos;
 layout(location = 2) out vec2 fragTextCoord;
+layout(location = 3) flat out uint textureIndex;
 
+// i primi 16 byte delle push constant sono per la fragment shader (indice della texture)
 layout(push_constant) uniform PushConstants {
-    uint textureIndex;
+    layout(offset = 16) vec4 positionScale;
+    vec4 positionOffset;
+    vec4 texCoordScaleOffset;
 } push;
 
 struct SceneMatrices {
-    mat4 transform;
     mat4 view;
     mat4 proj;
 };
 
-struct AmbientLight {
-    vec3 color;
-    float intensity;
-};
-
-// Struttura dati di lavoro per contenere le informazioni sulla luce
-// diffusiva
-struct DiffusiveLightStruct {
-	float intensity;
-};
+// dati comuni a tutto il frame: la vertex shader legge solo le matrici all'inizio del blocco, le luci servono alla fragment shader
+layout(set = 0, binding = 0) uniform UniformBufferObject{
+    SceneMatrices scene;
+} ubo;
 
-// Struttura dati di lavoro per contenere le informazioni sulla luce
-// speculare
-struct SpecularLightStruct {
-	float intensity;
-	float shininess;
+// dati di ogni oggetto, la matrice delle normali è già calcolata sulla CPU (vedi objectBuffer.h)
+struct ObjectData {
+    mat4 model;
+    mat4 normalMatrix;
+    uint textureIndex; // posto della texture nella tabella, 0xFFFFFFFF per usare quella della sub-mesh
 };
 
-// Struttura dati di lavoro per contenere le informazioni sulla luce
-// puntiforme
-struct PointLightStruct {
-	vec3 color;
-	vec3 position;
-};
+// un elemento per ogni oggetto disegnato nel frame, scelto da firstInstance del comando di disegno;
+// le copie di un disegno con l'instancing sono elementi consecutivi, quindi gl_InstanceIndex sceglie anche la copia
+layout(std430, set = 0, binding = 1) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
 
-layout(binding = 0) uniform UniformBufferObject{
-    SceneMatrices scene;
-    AmbientLight ambientLight;
-    PointLightStruct pointLight;
-    DiffusiveLightStruct diffusiveLight;
-	SpecularLightStruct specularLight;
-	uint textureOffset;
-    vec4 cameraPos;
-} ubo;
+// decodifica una normale in codifica ottaedrica
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main()
 {
-    gl_Position = ubo.scene.proj * ubo.scene.view * ubo.scene.transform * vec4(inPosition, 1.0);
-    fragTextCoord = texCoord;
-    fragNormal = (transpose(inverse(ubo.scene.transform)) * vec4(normal,0.0)).xyz;
-    fragPos = (ubo.scene.transform * vec4(inPosition,1.0)).xyz;
+    // con il formato Full scala e offset sono l'identità
+    vec3 position = push.positionOffset.xyz + inPosition.xyz * push.positionScale.xyz;
+    vec3 vertexNormal = PACKED_NORMALS ? octDecode(normal.xy) : normal;
+    ObjectData object = objectBuffer.objects[gl_InstanceIndex];
+    vec4 worldPos = object.model * vec4(position, 1.0);
+    gl_Position = ubo.scene.proj * ubo.scene.view * worldPos;
+    fragTextCoord = texCoord * push.texCoordScaleOffset.xy + push.texCoordScaleOffset.zw;
+    fragNormal = mat3(object.normalMatrix) * vertexNormal;
+    fragPos = worldPos.xyz;
+    textureIndex = object.textureIndex;
 }
\ No newline at end of file
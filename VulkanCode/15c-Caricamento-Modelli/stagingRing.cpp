@@ -0,0 +1,201 @@
+#include "stagingRing.h"
+#include "bufferUtils.h"
+#include <stdexcept>
+#include <algorithm>
+
+StagingRing::StagingRing(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size)
+    : device(device), size(size)
+{
+    // le copie verso le immagini vogliono un offset multiplo della dimensione del texel (4 byte per RGBA8),
+    // e il dispositivo indica un allineamento con cui le copie sono più veloci
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    alignment = std::max<VkDeviceSize>(16, properties.limits.optimalBufferCopyOffsetAlignment);
+
+    // la memoria è coerente, quindi quello che scriviamo è visibile alla GPU senza vkFlushMappedMemoryRanges
+    createBuffer(device, physicalDevice, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging, buffer, memory);
+    // la memoria host visible viene mappata dall'allocatore
+    mapped = static_cast<uint8_t *>(memory.mapped);
+}
+
+StagingRing::~StagingRing()
+{
+    flush();
+    for (VkFence fence : freeFences)
+    {
+        vkDestroyFence(device, fence, nullptr);
+    }
+    destroyBuffer(device, buffer, memory);
+}
+
+StagingAllocation StagingRing::allocate(VkDeviceSize bytes)
+{
+    StagingAllocation allocation;
+    if (!tryAllocate(bytes, allocation))
+    {
+        throw std::runtime_error("staging ring full: submit the pending uploads before allocating more!");
+    }
+    return allocation;
+}
+
+bool StagingRing::tryAllocate(VkDeviceSize bytes, StagingAllocation &allocation)
+{
+    if (bytes > size)
+    {
+        throw std::runtime_error("staging ring too small for upload!");
+    }
+    bytes = std::max<VkDeviceSize>(bytes, 1); // anche una porzione vuota deve occupare spazio, altrimenti sembrerebbe un errore
+    reclaim();
+    while (true)
+    {
+        if (usedBytes == 0)
+        {
+            // buffer vuoto: ripartiamo dall'inizio
+            head = 0;
+            tail = 0;
+        }
+        // la parte libera va da head a tail, facendo il giro del buffer se serve
+        VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+        VkDeviceSize consumed = 0;
+        if (usedBytes == 0 || head > tail)
+        {
+            if (offset + bytes <= size)
+            {
+                consumed = offset + bytes - head;
+            }
+            else if (bytes <= tail)
+            {
+                // non c'è spazio fino alla fine: ricominciamo dall'inizio e lo spazio in fondo resta inutilizzato fino al prossimo giro
+                offset = 0;
+                consumed = size - head + bytes;
+            }
+        }
+        else if (head < tail && offset + bytes <= tail)
+        {
+            consumed = offset + bytes - head;
+        }
+
+        if (consumed > 0)
+        {
+            head = (offset + bytes) % size;
+            usedBytes += consumed;
+            openBytes += consumed;
+            peakUsedBytes = std::max(peakUsedBytes, usedBytes);
+            allocation = StagingAllocation{buffer, offset, mapped + offset};
+            return true;
+        }
+        // non c'è spazio: aspettiamo il caricamento più vecchio, se non ce ne sono lo spazio è tutto preso da porzioni non ancora inviate
+        if (pending.empty())
+        {
+            return false;
+        }
+        releaseOldest(true);
+    }
+}
+
+uint64_t StagingRing::submit(VkQueue queue, VkCommandPool commandPool, VkCommandBuffer commandBuffer,
+                             VkSemaphore signalSemaphore, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage)
+{
+    vkEndCommandBuffer(commandBuffer);
+
+    VkFence fence;
+    if (!freeFences.empty())
+    {
+        fence = freeFences.back();
+        freeFences.pop_back();
+    }
+    else
+    {
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create staging fence!");
+        }
+    }
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    if (signalSemaphore != VK_NULL_HANDLE)
+    {
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &signalSemaphore;
+    }
+    if (waitSemaphore != VK_NULL_HANDLE)
+    {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &waitSemaphore;
+        submitInfo.pWaitDstStageMask = &waitStage;
+    }
+    if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to submit upload command buffer!");
+    }
+
+    pending.push_back(PendingUpload{fence, commandPool, commandBuffer, openBytes, ++lastSubmission});
+    openBytes = 0;
+    return lastSubmission;
+}
+
+void StagingRing::wait(uint64_t submission)
+{
+    while (!pending.empty() && pending.front().submission <= submission)
+    {
+        releaseOldest(true);
+    }
+}
+
+bool StagingRing::isComplete(uint64_t submission)
+{
+    reclaim();
+    return pending.empty() || pending.front().submission > submission;
+}
+
+bool StagingRing::releaseOldest(bool wait)
+{
+    PendingUpload &upload = pending.front();
+    if (wait)
+    {
+        vkWaitForFences(device, 1, &upload.fence, VK_TRUE, UINT64_MAX);
+    }
+    else if (vkGetFenceStatus(device, upload.fence) != VK_SUCCESS)
+    {
+        return false;
+    }
+    vkResetFences(device, 1, &upload.fence);
+    freeFences.push_back(upload.fence);
+    vkFreeCommandBuffers(device, upload.commandPool, 1, &upload.commandBuffer);
+    tail = (tail + upload.bytes) % size;
+    usedBytes -= upload.bytes;
+    pending.pop_front();
+    return true;
+}
+
+void StagingRing::reclaim()
+{
+    // i caricamenti finiscono nell'ordine in cui sono stati inviati, quindi basta guardare il più vecchio
+    while (!pending.empty() && releaseOldest(false))
+    {
+    }
+}
+
+void StagingRing::flush()
+{
+    while (!pending.empty())
+    {
+        releaseOldest(true);
+    }
+}
+
+VkDeviceSize StagingRing::getSize() const
+{
+    return size;
+}
+
+VkDeviceSize StagingRing::getPeakUsedBytes() const
+{
+    return peakUsedBytes;
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include "deviceAllocator.h"
+
+/**
+ * @brief Una porzione del buffer di staging, già mappata e pronta per essere scritta dalla CPU.
+ */
+struct StagingAllocation
+{
+    VkBuffer buffer;     // il buffer di staging, da usare come sorgente della copia
+    VkDeviceSize offset; // la posizione dei dati nel buffer
+    void *data;          // il puntatore in cui scrivere i dati
+};
+
+/**
+ * @brief Buffer di staging circolare condiviso da tutti i caricamenti sulla GPU.
+ *
+ * Invece di creare e distruggere un buffer di staging per ogni vertex buffer, index buffer e texture,
+ * viene allocato un solo buffer host visible, mappato una volta sola per tutta la vita dell'applicazione.
+ * Ogni caricamento prende una porzione del buffer con allocate, ci scrive i dati e registra la copia in un command buffer,
+ * che viene inviato con submit: la porzione torna libera solo quando la fence di quell'invio è segnalata,
+ * quindi la CPU non deve più aspettare la GPU dopo ogni copia.
+ */
+class StagingRing
+{
+public:
+    /**
+     * @brief Costruttore della classe StagingRing.
+     *
+     * Crea il buffer di staging e lo mappa.
+     *
+     * @param device Il dispositivo Vulkan su cui operare.
+     * @param physicalDevice Il dispositivo fisico Vulkan.
+     * @param size La dimensione del buffer, deve contenere il caricamento più grande (per esempio la texture più grande).
+     */
+    StagingRing(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size);
+
+    /**
+     * @brief Distruttore della classe StagingRing.
+     *
+     * Aspetta i caricamenti ancora in corso e rilascia buffer, memoria e fence.
+     */
+    ~StagingRing();
+
+    /**
+     * @brief Prende una porzione libera del buffer di staging.
+     *
+     * Se non c'è abbastanza spazio aspetta i caricamenti più vecchi finché non se ne libera abbastanza.
+     * La porzione appartiene al prossimo submit.
+     *
+     * @param size La dimensione della porzione in byte.
+     * @return La porzione, con offset allineato per le copie verso buffer e immagini.
+     * @throws std::runtime_error Se la porzione è più grande dell'intero buffer o se lo spazio è occupato da porzioni non ancora inviate.
+     */
+    StagingAllocation allocate(VkDeviceSize size);
+
+    /**
+     * @brief Come allocate, ma se lo spazio è occupato da porzioni non ancora inviate ritorna false invece di lanciare un'eccezione.
+     *
+     * @param size La dimensione della porzione in byte.
+     * @param allocation La porzione presa, se la funzione ritorna true.
+     * @return false se serve un submit prima di poter prendere la porzione.
+     * @throws std::runtime_error Se la porzione è più grande dell'intero buffer.
+     */
+    bool tryAllocate(VkDeviceSize size, StagingAllocation &allocation);
+
+    /**
+     * @brief Termina e invia un command buffer che copia dalle porzioni prese con allocate.
+     *
+     * Non aspetta la GPU: il command buffer viene liberato e le porzioni tornano disponibili quando la sua fence è segnalata.
+     * I semafori servono a passare i dati da una coda all'altra, per esempio dalla coda di trasferimento a quella grafica.
+     *
+     * @param queue La coda su cui inviare i comandi.
+     * @param commandPool Il command pool da cui è stato allocato il command buffer.
+     * @param commandBuffer Il command buffer da inviare, iniziato con beginSingleTimeCommands.
+     * @param signalSemaphore Il semaforo da segnalare alla fine dei comandi, VK_NULL_HANDLE se non serve.
+     * @param waitSemaphore Il semaforo da aspettare prima di eseguire i comandi, VK_NULL_HANDLE se non serve.
+     * @param waitStage Le fasi della pipeline che devono aspettare waitSemaphore.
+     * @return Il numero dell'invio, da passare a wait o isComplete.
+     */
+    uint64_t submit(VkQueue queue, VkCommandPool commandPool, VkCommandBuffer commandBuffer,
+                    VkSemaphore signalSemaphore = VK_NULL_HANDLE, VkSemaphore waitSemaphore = VK_NULL_HANDLE, VkPipelineStageFlags waitStage = 0);
+
+    /**
+     * @brief Aspetta che un invio sia completato dalla GPU.
+     * @param submission Il numero restituito da submit.
+     */
+    void wait(uint64_t submission);
+
+    /**
+     * @brief Controlla, senza aspettare, se un invio è stato completato dalla GPU.
+     * @param submission Il numero restituito da submit.
+     * @return true se l'invio è completato.
+     */
+    bool isComplete(uint64_t submission);
+
+    /**
+     * @brief Libera lo spazio dei caricamenti già completati, senza aspettare.
+     */
+    void reclaim();
+
+    /**
+     * @brief Aspetta tutti i caricamenti inviati e libera il loro spazio.
+     */
+    void flush();
+
+    /**
+     * @brief Restituisce la dimensione del buffer di staging.
+     * @return La dimensione in byte.
+     */
+    VkDeviceSize getSize() const;
+
+    /**
+     * @brief Restituisce il massimo di byte occupati contemporaneamente, dalla creazione del buffer.
+     * @return I byte occupati nel momento di massimo, compreso lo spazio perso per allineamento.
+     */
+    VkDeviceSize getPeakUsedBytes() const;
+
+private:
+    // un invio ancora in corso, con la parte del buffer che usa
+    struct PendingUpload
+    {
+        VkFence fence;
+        VkCommandPool commandPool;
+        VkCommandBuffer commandBuffer;
+        VkDeviceSize bytes; // byte occupati a partire dalla coda, compreso lo spazio perso per allineamento e giro del buffer
+        uint64_t submission;
+    };
+
+    // libera il caricamento più vecchio, aspettandolo se wait è true; ritorna false se non è ancora completato
+    bool releaseOldest(bool wait);
+
+    VkDevice device;
+    VkBuffer buffer;
+    DeviceAllocation memory;
+    uint8_t *mapped;
+    VkDeviceSize size;
+    VkDeviceSize alignment;
+
+    VkDeviceSize head = 0;      // dove inizia la prossima porzione
+    VkDeviceSize tail = 0;      // dove inizia la porzione più vecchia ancora in uso
+    VkDeviceSize usedBytes = 0; // byte in uso tra tail e head
+    VkDeviceSize peakUsedBytes = 0;
+    VkDeviceSize openBytes = 0; // byte presi dopo l'ultimo submit
+    uint64_t lastSubmission = 0; // numero dell'ultimo invio, il primo è 1
+
+    std::deque<PendingUpload> pending;
+    std::vector<VkFence> freeFences; // fence già segnalate e resettate, pronte per un nuovo invio
+};
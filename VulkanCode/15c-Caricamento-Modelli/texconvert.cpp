@@ -0,0 +1,142 @@
+// programma da riga di comando che comprime le texture in BC1/BC3/BC7 e le salva come file KTX2 accanto all'originale (stesso nome, estensione .ktx2)
+// uso: texconvert.exe [auto|bc1|bc3|bc7] [file...]
+// senza file converte le texture usate da initializeTextures in main.cpp; con auto usa BC1 per le immagini opache e BC7 per quelle con trasparenza
+// ogni file contiene tutti i livelli di mipmap, che l'applicazione carica sulla GPU così come sono
+// stampa la memoria occupata con e senza compressione e l'errore (PSNR) del livello 0
+#include "textureCompression.h"
+#include "mipmap.h"
+#include "ktx2.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static VkFormat srgbFormat(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+    case BlockFormat::BC3:
+        return VK_FORMAT_BC3_SRGB_BLOCK;
+    default:
+        return VK_FORMAT_BC7_SRGB_BLOCK;
+    }
+}
+
+// errore della compressione in decibel, sui canali di colore e sull'alfa insieme
+static double psnr(const uint8_t *original, const uint8_t *decoded, size_t pixelCount)
+{
+    double squaredError = 0.0;
+    for (size_t i = 0; i < pixelCount * 4; i++)
+    {
+        double d = static_cast<double>(original[i]) - decoded[i];
+        squaredError += d * d;
+    }
+    if (squaredError == 0.0)
+    {
+        return INFINITY;
+    }
+    return 10.0 * std::log10(255.0 * 255.0 / (squaredError / (pixelCount * 4)));
+}
+
+int main(int argc, char **argv)
+{
+    std::string mode = argc > 1 ? argv[1] : "auto";
+    if (mode != "auto" && mode != "bc1" && mode != "bc3" && mode != "bc7")
+    {
+        std::cerr << "uso: texconvert.exe [auto|bc1|bc3|bc7] [file...]" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> files(argv + std::min(argc, 2), argv + argc);
+    if (files.empty())
+    {
+        // stesse texture caricate da initializeTextures in main.cpp
+        files = {
+            "moreTextures/white.png",
+            "models/boot/d-1.png",
+            "models/flower/12301_Flower_diff.jpg",
+            "models/marius/mrus_eyeball_iris_diffout.png",
+            "models/marius/mrus_eyelash_diffout.png",
+            "models/marius/mrus_hair_plate_diffout.png",
+            "models/marius/mrus_hair_vac_diffout.png",
+            "models/marius/mrus_head_clean_diffout.png",
+        };
+    }
+
+    std::cout << std::left << std::setw(48) << "texture" << std::right << std::setw(8) << "formato"
+              << std::setw(14) << "RGBA8 (KB)" << std::setw(14) << "BC (KB)" << std::setw(12) << "PSNR (dB)" << std::endl;
+    size_t totalRgba = 0, totalCompressed = 0;
+    for (const std::string &file : files)
+    {
+        if (!fs::exists(file))
+        {
+            std::cout << std::left << std::setw(48) << file << " mancante, saltata" << std::endl;
+            continue;
+        }
+        int width, height, channels;
+        stbi_uc *pixels = stbi_load(file.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if (pixels == nullptr)
+        {
+            std::cout << std::left << std::setw(48) << file << " non leggibile, saltata" << std::endl;
+            continue;
+        }
+        size_t pixelCount = static_cast<size_t>(width) * height;
+        BlockFormat format = hasTransparentPixels(pixels, pixelCount) ? BlockFormat::BC7 : BlockFormat::BC1;
+        if (mode == "bc1")
+        {
+            format = BlockFormat::BC1;
+        }
+        else if (mode == "bc3")
+        {
+            format = BlockFormat::BC3;
+        }
+        else if (mode == "bc7")
+        {
+            format = BlockFormat::BC7;
+        }
+
+        // le mipmap vengono generate prima della compressione, con lo stesso filtro usato dall'applicazione per le texture non compresse
+        uint32_t mipLevels = mipLevelCount(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+        std::vector<size_t> levelOffsets;
+        std::vector<uint8_t> chain = generateMipChain(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), mipLevels, true, levelOffsets);
+
+        Ktx2Image image;
+        image.format = srgbFormat(format);
+        image.width = static_cast<uint32_t>(width);
+        image.height = static_cast<uint32_t>(height);
+        double quality = 0.0;
+        for (uint32_t level = 0; level < mipLevels; level++)
+        {
+            uint32_t levelWidth = std::max(1u, image.width >> level), levelHeight = std::max(1u, image.height >> level);
+            std::vector<uint8_t> blocks = compressImage(chain.data() + levelOffsets[level], levelWidth, levelHeight, format);
+            if (level == 0)
+            {
+                std::vector<uint8_t> decoded = decompressImage(blocks.data(), levelWidth, levelHeight, format);
+                quality = psnr(pixels, decoded.data(), pixelCount);
+            }
+            image.levels.push_back({image.data.size(), blocks.size(), levelWidth, levelHeight});
+            image.data.insert(image.data.end(), blocks.begin(), blocks.end());
+        }
+        stbi_image_free(pixels);
+
+        std::string output = fs::path(file).replace_extension(".ktx2").string();
+        writeKtx2(output, image);
+
+        totalRgba += chain.size();
+        totalCompressed += image.data.size();
+        std::cout << std::left << std::setw(48) << file << std::right << std::setw(8) << blockFormatName(format)
+                  << std::setw(14) << chain.size() / 1024 << std::setw(14) << image.data.size() / 1024
+                  << std::setw(12) << std::fixed << std::setprecision(2) << quality << std::endl;
+    }
+    std::cout << "totale: " << totalRgba / 1024 << " KB in RGBA8, " << totalCompressed / 1024 << " KB compresse ("
+              << (totalRgba > 0 ? 100.0 * (totalRgba - totalCompressed) / totalRgba : 0.0) << "% risparmiato)" << std::endl;
+    return 0;
+}
@@ -1,26 +1,36 @@
 #include "texture.h"
 #include "bufferUtils.h"
 #include "shaderclass.h"
+#include "mipmap.h"
+#include "ktx2.h"
+#include <filesystem>
+#include <algorithm>
 #include <iostream>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 Texture::Texture(VkDevice device, VkPhysicalDevice physicalDevice,
-                 VkCommandPool commandPool, VkQueue graphicsQueue,
-                 const std::string &filename)
+                 VkCommandPool commandPool, VkQueue graphicsQueue, UploadBatch *uploadBatch, SamplerCache *samplerCache,
+                 const std::string &filename, bool compressed)
+    : Texture(device, physicalDevice, commandPool, graphicsQueue, uploadBatch, samplerCache,
+              loadImageData(filename, compressed, uploadBatch->generatesMipmaps(VK_FORMAT_R8G8B8A8_SRGB)))
+{
+}
+
+Texture::Texture(VkDevice device, VkPhysicalDevice physicalDevice,
+                 VkCommandPool commandPool, VkQueue graphicsQueue, UploadBatch *uploadBatch, SamplerCache *samplerCache,
+                 const TextureData &data)
     : device(device), physicalDevice(physicalDevice),
-      commandPool(commandPool), graphicsQueue(graphicsQueue)
+      commandPool(commandPool), graphicsQueue(graphicsQueue), uploadBatch(uploadBatch), samplerCache(samplerCache), path(data.path)
 {
-    createTextureImage(filename.c_str());
+    createTextureImage(data);
     createTextureImageView();
     createSampler();
 }
 
 Texture::~Texture()
 {
-    vkDestroySampler(device, textureSampler, nullptr);
     vkDestroyImageView(device, textureImageView, nullptr);
-    vkDestroyImage(device, textureImage, nullptr);
-    vkFreeMemory(device, textureImageMemory, nullptr);
+    destroyImage(device, textureImage, textureImageMemory);
 }
 
 VkDescriptorImageInfo Texture::getDescriptorInfo() const
@@ -32,30 +42,74 @@ VkDescriptorImageInfo Texture::getDescriptorInfo() const
     return descriptorInfo;
 }
 
-void Texture::createTextureImage(const char *filename)
+TextureData Texture::loadImageData(const std::string &filename, bool compressed, bool gpuMipmaps)
 {
-    int texWidth, texHeight, texChannels;
-    stbi_uc *pixels = stbi_load(filename, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
+    TextureData data;
+    data.path = filename;
+
+    // il file .ktx2 viene usato solo se non è più vecchio dell'immagine, altrimenti va rigenerato con texconvert
+    std::filesystem::path compressedPath = std::filesystem::path(filename).replace_extension(".ktx2");
+    std::error_code ec;
+    bool upToDate = !std::filesystem::exists(filename, ec) ||
+                    std::filesystem::last_write_time(compressedPath, ec) >= std::filesystem::last_write_time(filename, ec);
+    Ktx2Image image;
+    if (compressed && upToDate && readKtx2(compressedPath.string(), image))
+    {
+        // i blocchi compressi vengono copiati così come sono, le mipmap sono già nel file
+        data.format = image.format;
+        data.width = image.width;
+        data.height = image.height;
+        data.mipLevels = static_cast<uint32_t>(image.levels.size());
+        for (const Ktx2Level &level : image.levels)
+        {
+            data.levels.push_back({level.offset, level.width, level.height});
+            data.uncompressedBytes += static_cast<VkDeviceSize>(level.width) * level.height * 4;
+        }
+        data.pixels = std::move(image.data);
+        return data;
+    }
 
+    int texWidth, texHeight, texChannels;
+    stbi_uc *pixels = stbi_load(filename.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
     if (!pixels)
     {
-        throw std::runtime_error("failed to load texture image!");
+        throw std::runtime_error("failed to load texture image: " + filename);
+    }
+    data.width = static_cast<uint32_t>(texWidth);
+    data.height = static_cast<uint32_t>(texHeight);
+    // la catena di mipmap arriva fino a 1x1: da lontano la GPU legge i livelli piccoli, che stanno nella cache delle texture
+    data.mipLevels = mipLevelCount(data.width, data.height);
+    for (uint32_t level = 0; level < data.mipLevels; level++)
+    {
+        data.uncompressedBytes += static_cast<VkDeviceSize>(std::max(1u, data.width >> level)) * std::max(1u, data.height >> level) * 4;
     }
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-
-    createBuffer(device, physicalDevice,
-                 imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingBuffer, stagingBufferMemory);
-    void *data;
-    vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(device, stagingBufferMemory);
+    if (gpuMipmaps || data.mipLevels == 1)
+    {
+        data.pixels.assign(pixels, pixels + static_cast<size_t>(data.width) * data.height * 4);
+    }
+    else
+    {
+        // senza vkCmdBlitImage le mipmap vengono generate qui, sul thread che decodifica, invece che durante il caricamento
+        std::vector<size_t> levelOffsets;
+        data.pixels = generateMipChain(pixels, data.width, data.height, data.mipLevels, true, levelOffsets);
+        for (uint32_t level = 0; level < data.mipLevels; level++)
+        {
+            data.levels.push_back({levelOffsets[level], std::max(1u, data.width >> level), std::max(1u, data.height >> level)});
+        }
+    }
 
     // puliamo i pixel
     stbi_image_free(pixels);
+    return data;
+}
+
+void Texture::createTextureImage(const TextureData &data)
+{
+    format = data.format;
+    mipLevels = data.mipLevels;
+    imageBytes = data.levels.empty() ? data.uncompressedBytes : data.pixels.size();
+    uncompressedBytes = data.uncompressedBytes;
 
     /*
     A differenza del layout di un'immagine, la modalità di tiling non può essere modificata successivamente.
@@ -63,75 +117,38 @@ void Texture::createTextureImage(const char *filename)
     Tuttavia, utilizzeremo un buffer di staging invece di un'immagine di staging, quindi questo non sarà necessario.
     Useremo VK_IMAGE_TILING_OPTIMAL per un accesso efficiente dallo shader.
     */
+    // le copie tra livelli di vkCmdBlitImage leggono dall'immagine stessa, quindi serve anche come sorgente se le mipmap le genera la GPU
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (data.levels.empty())
+    {
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
     createImage(device, physicalDevice,
-                texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB,
-                VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                data.width, data.height, mipLevels, format,
+                VK_IMAGE_TILING_OPTIMAL, usage,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::Texture,
                 textureImage, textureImageMemory);
 
-    transitionImageLayout(device, commandPool, graphicsQueue,
-                          textureImage, VK_FORMAT_R8G8B8A8_SRGB,
-                          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL); // teniamo il layout undefined perché non ci interessa prima del trasferimento
-
-    // copiamo i dati dal buffer di staging all'immagine
-    copyBufferToImage(device, commandPool, graphicsQueue,
-                      stagingBuffer, textureImage,
-                      static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-
-    transitionImageLayout(device, commandPool, graphicsQueue,
-                          textureImage, VK_FORMAT_R8G8B8A8_SRGB,
-                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-    // distruggiamo il buffer di staging
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    // transizioni e copia vengono registrate nel batch insieme agli altri caricamenti, i pixel vengono copiati subito nel buffer di staging
+    if (data.levels.empty())
+    {
+        uploadBatch->uploadImage(textureImage, format, data.pixels.data(), data.pixels.size(), data.width, data.height, mipLevels);
+    }
+    else
+    {
+        uploadBatch->uploadImageLevels(textureImage, data.pixels.data(), data.pixels.size(), data.levels);
+    }
 }
 
 void Texture::createTextureImageView()
 {
-    textureImageView = createImageView(device, textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+    textureImageView = createImageView(device, textureImage, format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
 }
 
 void Texture::createSampler()
 {
-    VkSamplerCreateInfo samplerInfo{};
-    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    samplerInfo.magFilter = VK_FILTER_LINEAR;
-    samplerInfo.minFilter = VK_FILTER_LINEAR;
-
-    /*
-    VK_SAMPLER_ADDRESS_MODE_REPEAT: Ripete la texture quando si superano le dimensioni dell'immagine.
-    VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT: Come repeat, ma inverte le coordinate per specchiare l'immagine quando si superano le dimensioni.
-    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE: Prende il colore del bordo più vicino alla coordinata oltre i limiti dell'immagine.
-    VK_SAMPLER_ADDRESS_MODE_MIRROR_CLAMP_TO_EDGE: Come clamp to edge, ma usa il bordo opposto a quello più vicino.
-    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER: Restituisce un colore solido quando si campiona oltre le dimensioni dell'immagine.
-    */
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-
-    samplerInfo.anisotropyEnable = VK_TRUE;
-    VkPhysicalDeviceProperties properties{};
-    vkGetPhysicalDeviceProperties(physicalDevice, &properties); // nelle proprietà del dispositivo fisico c'è uno spazio che indica i limiti del dispositivo,
-    // ci servono per sapere il massimo valore di anisotropia supportato
-
-    samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy; // più basso è il valore, più bassa è la qualità ma più alta la performance
-    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;         // colore del bordo, non ci interessa in questo caso
-    samplerInfo.unnormalizedCoordinates = VK_FALSE;                     // se è true, le coordinate non sono normalizzate, quindi vanno da 0 a 1
-    samplerInfo.compareEnable = VK_FALSE;                               // non ci interessa in questo caso ma se fosse true, i texel verrebbero confrontati con un valore
-    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;                       // non ci interessa in questo caso
-
-    // per il mipmapping
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerInfo.mipLodBias = 0.0f;
-    samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
-
-    // ora che abbiamo settato tutto, possiamo creare il sampler
-    if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to create texture sampler!");
-    }
+    // il sampler non dipende dall'immagine: tutte le texture usano quello condiviso della cache, senza limite sui livelli di mipmap
+    textureSampler = samplerCache->get(samplerCache->textureState());
 }
 
 void Texture::setIndex(int index)
@@ -142,4 +159,24 @@ void Texture::setIndex(int index)
 int Texture::getIndex() const
 {
     return index; // ritorniamo l'indice della texture
+}
+
+const std::string &Texture::getPath() const
+{
+    return path; // ritorniamo il percorso del file della texture
+}
+
+VkDeviceSize Texture::getImageBytes() const
+{
+    return imageBytes;
+}
+
+VkDeviceSize Texture::getUncompressedBytes() const
+{
+    return uncompressedBytes;
+}
+
+bool Texture::isCompressed() const
+{
+    return format != VK_FORMAT_R8G8B8A8_SRGB;
 }
\ No newline at end of file
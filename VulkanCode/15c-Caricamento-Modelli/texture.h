@@ -3,6 +3,26 @@
 #include <string>
 #include <vector>
 #include "bufferUtils.h"
+#include "uploadBatch.h"
+#include "samplerCache.h"
+
+/**
+ * @brief Immagine di una texture già letta e decodificata dalla CPU, pronta per essere caricata sulla GPU.
+ *
+ * Viene prodotta da Texture::loadImageData, che non usa Vulkan e può essere chiamata da più thread insieme.
+ */
+struct TextureData
+{
+    std::string path;                          // percorso del file immagine originale
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB; // formato dei pixel, BC se letti da un file KTX2
+    uint32_t width = 0;                        // larghezza del livello 0
+    uint32_t height = 0;                       // altezza del livello 0
+    uint32_t mipLevels = 1;                    // livelli di mipmap dell'immagine
+    std::vector<uint8_t> pixels;               // solo il livello 0 se levels è vuoto, altrimenti tutti i livelli
+    std::vector<ImageLevel> levels;            // livelli già pronti in pixels, vuoto se le mipmap vengono generate dalla GPU
+    VkDeviceSize uncompressedBytes = 0;        // byte che servirebbero in RGBA8 con tutti i livelli
+};
+
 class Texture
 {
 public:
@@ -15,20 +35,58 @@ public:
      * @param physicalDevice Il dispositivo fisico Vulkan.
      * @param commandPool Il command pool per le operazioni di copia.
      * @param graphicsQueue La coda grafica per l'esecuzione dei comandi
+     * @param uploadBatch Il batch in cui viene registrata la copia dei pixel.
+     * @param samplerCache La cache da cui prendere il sampler, condiviso con le altre texture.
      * @param filename Il percorso del file immagine da caricare come texture.
+     * @param compressed true se il dispositivo supporta i formati BC: in quel caso, se accanto all'immagine c'è un file .ktx2
+     *                   creato da texconvert, viene caricato quello (già compresso e con le mipmap) al posto dell'immagine.
      * @note Questo costruttore carica l'immagine della texture, crea la view dell'immagine e il sampler.
      *       Assicurarsi che il file immagine sia accessibile e valido.
      * @throws std::runtime_error Se si verifica un errore durante il caricamento dell'immagine o la creazione delle risorse Vulkan.
-     * @see createTextureImage, createTextureImageView, createSampler
+     * @see loadImageData, createTextureImage, createTextureImageView, createSampler
      */
     Texture(VkDevice device, VkPhysicalDevice physicalDevice,
-            VkCommandPool commandPool, VkQueue graphicsQueue,
-            const std::string &filename);
+            VkCommandPool commandPool, VkQueue graphicsQueue, UploadBatch *uploadBatch, SamplerCache *samplerCache,
+            const std::string &filename, bool compressed);
+
+    /**
+     * @brief Costruttore della classe Texture a partire da un'immagine già decodificata.
+     *
+     * Crea l'immagine Vulkan, registra la copia dei pixel nel batch e crea view e sampler: la lettura del file è già stata fatta da loadImageData,
+     * magari su un altro thread.
+     *
+     * @param device Il dispositivo Vulkan su cui operare.
+     * @param physicalDevice Il dispositivo fisico Vulkan.
+     * @param commandPool Il command pool per le operazioni di copia.
+     * @param graphicsQueue La coda grafica per l'esecuzione dei comandi
+     * @param uploadBatch Il batch in cui viene registrata la copia dei pixel.
+     * @param samplerCache La cache da cui prendere il sampler, condiviso con le altre texture.
+     * @param data L'immagine decodificata, i pixel vengono copiati subito nel buffer di staging.
+     * @throws std::runtime_error Se si verifica un errore durante la creazione delle risorse Vulkan.
+     */
+    Texture(VkDevice device, VkPhysicalDevice physicalDevice,
+            VkCommandPool commandPool, VkQueue graphicsQueue, UploadBatch *uploadBatch, SamplerCache *samplerCache,
+            const TextureData &data);
+
+    /**
+     * @brief Legge e decodifica l'immagine di una texture, senza usare Vulkan.
+     *
+     * Se compressed è true e accanto all'immagine c'è un file .ktx2 aggiornato creato da texconvert, legge quello.
+     * Altrimenti decodifica l'immagine in RGBA8 con stb_image e, se gpuMipmaps è false, genera anche le mipmap sulla CPU.
+     * Può essere chiamata da più thread contemporaneamente, per decodificare più texture in parallelo.
+     *
+     * @param filename Il percorso del file immagine.
+     * @param compressed true se il dispositivo supporta i formati BC.
+     * @param gpuMipmaps true se le mipmap vengono generate dalla GPU (vedi UploadBatch::generatesMipmaps).
+     * @return L'immagine decodificata.
+     * @throws std::runtime_error Se l'immagine non può essere letta.
+     */
+    static TextureData loadImageData(const std::string &filename, bool compressed, bool gpuMipmaps);
 
     /**
      * @brief Distruttore della classe Texture.
      *
-     * Questo distruttore rilascia le risorse Vulkan allocate per la texture.
+     * Questo distruttore rilascia le risorse Vulkan allocate per la texture, tranne il sampler che appartiene alla cache.
      */
     ~Texture();
 
@@ -53,16 +111,43 @@ public:
      */
     int getIndex() const;
 
+    /**
+     * @brief Ottiene il percorso del file da cui è stata caricata la texture.
+     *
+     * @return const std::string& Il percorso del file immagine.
+     */
+    const std::string &getPath() const;
+
+    /**
+     * @brief Ottiene la dimensione dei dati dell'immagine sulla GPU, con tutti i livelli di mipmap.
+     *
+     * @return VkDeviceSize I byte dei dati, compressi se la texture è stata caricata da un file KTX2.
+     */
+    VkDeviceSize getImageBytes() const;
+
+    /**
+     * @brief Ottiene la dimensione che avrebbero i dati dell'immagine senza compressione (RGBA a 8 bit), con tutti i livelli di mipmap.
+     *
+     * @return VkDeviceSize I byte dei dati in RGBA8.
+     */
+    VkDeviceSize getUncompressedBytes() const;
+
+    /**
+     * @brief Indica se la texture è compressa in un formato BC.
+     *
+     * @return bool true se la texture è stata caricata da un file KTX2.
+     */
+    bool isCompressed() const;
+
 private:
     /**
-     * @brief Crea l'immagine della texture a partire da un file.
+     * @brief Crea l'immagine della texture a partire da un'immagine decodificata.
      *
-     * Carica l'immagine da un file e crea un'immagine Vulkan per la texture.
-     * @param filename Il percorso del file immagine da caricare.
-     * @throws std::runtime_error Se si verifica un errore durante il caricamento dell'immagine o la creazione dell'immagine Vulkan.
-     * @note Assicurarsi che il file immagine sia accessibile e valido.
+     * Crea un'immagine Vulkan per la texture e registra nel batch la copia dei pixel, con le mipmap già pronte o generate dalla GPU.
+     * @param data L'immagine decodificata.
+     * @throws std::runtime_error Se si verifica un errore durante la creazione dell'immagine Vulkan.
      */
-    void createTextureImage(const char *filename);
+    void createTextureImage(const TextureData &data);
 
     /**
      * @brief Crea la view dell'immagine della texture.
@@ -73,9 +158,9 @@ private:
     void createTextureImageView();
 
     /**
-     * @brief Crea il sampler per la texture.
+     * @brief Prende il sampler per la texture dalla cache.
      *
-     * Crea un VkSampler per la texture, che controlla come la texture viene campionata.
+     * Il VkSampler controlla come la texture viene campionata e non viene distrutto dalla texture: appartiene alla cache.
      */
     void createSampler();
 
@@ -83,11 +168,18 @@ private:
     VkPhysicalDevice physicalDevice;
     VkCommandPool commandPool;
     VkQueue graphicsQueue;
+    UploadBatch *uploadBatch;
+    SamplerCache *samplerCache;
 
     VkImage textureImage;
-    VkDeviceMemory textureImageMemory;
+    DeviceAllocation textureImageMemory;
     VkImageView textureImageView;
     VkSampler textureSampler;
+    uint32_t mipLevels = 1; // livelli di mipmap dell'immagine
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB; // formato dell'immagine, BC se caricata da un file KTX2
+    VkDeviceSize imageBytes = 0;               // byte dei dati dell'immagine con tutti i livelli
+    VkDeviceSize uncompressedBytes = 0;        // byte che servirebbero in RGBA8
 
+    std::string path; // percorso del file immagine, serve per associare la texture ai materiali dei modelli
     int index; // indice della texture nell'array di texture (serve alla mesh per far sì che ogni texture sappia dove si trova nell'array)
 };
\ No newline at end of file
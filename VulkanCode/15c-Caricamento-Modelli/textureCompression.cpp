@@ -0,0 +1,526 @@
+#include "textureCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // pesi di interpolazione di BC7 con indici a 4 bit, in sessantaquattresimi
+    const int BC7_WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+    // iterazioni del metodo delle potenze per la direzione principale, bastano poche per un blocco di 16 pixel
+    const int PCA_ITERATIONS = 8;
+
+    typedef uint8_t Block[16][4];
+
+    // copia un blocco di 4x4 pixel, ripetendo l'ultima riga e colonna sui bordi
+    void fetchBlock(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, Block block)
+    {
+        for (uint32_t y = 0; y < 4; y++)
+        {
+            for (uint32_t x = 0; x < 4; x++)
+            {
+                uint32_t px = std::min(bx * 4 + x, width - 1);
+                uint32_t py = std::min(by * 4 + y, height - 1);
+                std::memcpy(block[y * 4 + x], pixels + (static_cast<size_t>(py) * width + px) * 4, 4);
+            }
+        }
+    }
+
+    void storeBlock(const Block block, uint8_t *pixels, uint32_t width, uint32_t height, uint32_t bx, uint32_t by)
+    {
+        for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+        {
+            for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+            {
+                std::memcpy(pixels + (static_cast<size_t>(by * 4 + y) * width + bx * 4 + x) * 4, block[y * 4 + x], 4);
+            }
+        }
+    }
+
+    // estremi del segmento lungo la direzione principale dei primi channels canali del blocco
+    void principalEndpoints(const Block block, int channels, float low[4], float high[4])
+    {
+        float mean[4] = {0, 0, 0, 0};
+        for (int i = 0; i < 16; i++)
+        {
+            for (int c = 0; c < channels; c++)
+            {
+                mean[c] += block[i][c] / 16.0f;
+            }
+        }
+        float covariance[4][4] = {};
+        float axis[4] = {0, 0, 0, 0};
+        float minimum[4] = {255, 255, 255, 255}, maximum[4] = {0, 0, 0, 0};
+        for (int i = 0; i < 16; i++)
+        {
+            for (int a = 0; a < channels; a++)
+            {
+                float da = block[i][a] - mean[a];
+                minimum[a] = std::min(minimum[a], static_cast<float>(block[i][a]));
+                maximum[a] = std::max(maximum[a], static_cast<float>(block[i][a]));
+                for (int b = 0; b < channels; b++)
+                {
+                    covariance[a][b] += da * (block[i][b] - mean[b]);
+                }
+            }
+        }
+        // partiamo dalla diagonale del riquadro che contiene i colori, poi il metodo delle potenze la porta verso l'autovettore principale
+        for (int c = 0; c < channels; c++)
+        {
+            axis[c] = maximum[c] - minimum[c];
+        }
+        for (int iteration = 0; iteration < PCA_ITERATIONS; iteration++)
+        {
+            float next[4] = {0, 0, 0, 0};
+            float largest = 0.0f;
+            for (int a = 0; a < channels; a++)
+            {
+                for (int b = 0; b < channels; b++)
+                {
+                    next[a] += covariance[a][b] * axis[b];
+                }
+                largest = std::max(largest, std::fabs(next[a]));
+            }
+            if (largest == 0.0f)
+            {
+                break;
+            }
+            for (int c = 0; c < channels; c++)
+            {
+                axis[c] = next[c] / largest;
+            }
+        }
+        float length = 0.0f;
+        for (int c = 0; c < channels; c++)
+        {
+            length += axis[c] * axis[c];
+        }
+        float tMin = 0.0f, tMax = 0.0f;
+        if (length > 0.0f)
+        {
+            length = std::sqrt(length);
+            for (int c = 0; c < channels; c++)
+            {
+                axis[c] /= length;
+            }
+            tMin = 1e9f;
+            tMax = -1e9f;
+            for (int i = 0; i < 16; i++)
+            {
+                float t = 0.0f;
+                for (int c = 0; c < channels; c++)
+                {
+                    t += (block[i][c] - mean[c]) * axis[c];
+                }
+                tMin = std::min(tMin, t);
+                tMax = std::max(tMax, t);
+            }
+        }
+        for (int c = 0; c < channels; c++)
+        {
+            low[c] = std::clamp(mean[c] + tMin * axis[c], 0.0f, 255.0f);
+            high[c] = std::clamp(mean[c] + tMax * axis[c], 0.0f, 255.0f);
+        }
+    }
+
+    // indice del colore della tavolozza più vicino al pixel
+    int nearestIndex(const uint8_t pixel[4], const int palette[][4], int paletteSize, int channels)
+    {
+        int best = 0, bestError = 1 << 30;
+        for (int i = 0; i < paletteSize; i++)
+        {
+            int error = 0;
+            for (int c = 0; c < channels; c++)
+            {
+                int d = pixel[c] - palette[i][c];
+                error += d * d;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    uint16_t to565(const float color[3])
+    {
+        int r = static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f);
+        int g = static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f);
+        int b = static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f);
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    void from565(uint16_t value, int color[4])
+    {
+        int r = (value >> 11) & 31, g = (value >> 5) & 63, b = value & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+        color[3] = 255;
+    }
+
+    // blocco del colore di BC1 e BC3, sempre nella modalità a 4 colori (il primo estremo maggiore del secondo)
+    void encodeColorBlock(const Block block, uint8_t out[8])
+    {
+        float low[4], high[4];
+        principalEndpoints(block, 3, low, high);
+        uint16_t c0 = to565(high), c1 = to565(low);
+        if (c0 < c1)
+        {
+            std::swap(c0, c1);
+        }
+        uint32_t indices = 0;
+        if (c0 != c1)
+        {
+            int palette[4][4];
+            from565(c0, palette[0]);
+            from565(c1, palette[1]);
+            for (int c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            for (int i = 0; i < 16; i++)
+            {
+                indices |= static_cast<uint32_t>(nearestIndex(block[i], palette, 4, 3)) << (2 * i);
+            }
+        }
+        out[0] = c0 & 0xFF;
+        out[1] = c0 >> 8;
+        out[2] = c1 & 0xFF;
+        out[3] = c1 >> 8;
+        for (int i = 0; i < 4; i++)
+        {
+            out[4 + i] = (indices >> (8 * i)) & 0xFF;
+        }
+    }
+
+    void decodeColorBlock(const uint8_t in[8], bool allowTransparent, Block block)
+    {
+        uint16_t c0 = in[0] | (in[1] << 8), c1 = in[2] | (in[3] << 8);
+        int palette[4][4];
+        from565(c0, palette[0]);
+        from565(c1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            if (c0 > c1 || !allowTransparent)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            else
+            {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+        palette[2][3] = 255;
+        palette[3][3] = (c0 > c1 || !allowTransparent) ? 255 : 0;
+        uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | (static_cast<uint32_t>(in[7]) << 24);
+        for (int i = 0; i < 16; i++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                block[i][c] = static_cast<uint8_t>(palette[(indices >> (2 * i)) & 3][c]);
+            }
+        }
+    }
+
+    // blocco dell'alfa di BC3, nella modalità a 8 livelli (il primo estremo maggiore del secondo)
+    void encodeAlphaBlock(const Block block, uint8_t out[8])
+    {
+        int alphaMin = 255, alphaMax = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            alphaMin = std::min(alphaMin, static_cast<int>(block[i][3]));
+            alphaMax = std::max(alphaMax, static_cast<int>(block[i][3]));
+        }
+        out[0] = static_cast<uint8_t>(alphaMax);
+        out[1] = static_cast<uint8_t>(alphaMin);
+        uint64_t indices = 0;
+        if (alphaMax != alphaMin)
+        {
+            int palette[8][4] = {};
+            palette[0][0] = alphaMax;
+            palette[1][0] = alphaMin;
+            for (int i = 2; i < 8; i++)
+            {
+                palette[i][0] = ((8 - i) * alphaMax + (i - 1) * alphaMin) / 7;
+            }
+            for (int i = 0; i < 16; i++)
+            {
+                uint8_t alpha[4] = {block[i][3], 0, 0, 0};
+                indices |= static_cast<uint64_t>(nearestIndex(alpha, palette, 8, 1)) << (3 * i);
+            }
+        }
+        for (int i = 0; i < 6; i++)
+        {
+            out[2 + i] = (indices >> (8 * i)) & 0xFF;
+        }
+    }
+
+    void decodeAlphaBlock(const uint8_t in[8], Block block)
+    {
+        int palette[8];
+        palette[0] = in[0];
+        palette[1] = in[1];
+        for (int i = 2; i < 8; i++)
+        {
+            if (palette[0] > palette[1])
+            {
+                palette[i] = ((8 - i) * palette[0] + (i - 1) * palette[1]) / 7;
+            }
+            else if (i < 6)
+            {
+                palette[i] = ((6 - i) * palette[0] + (i - 1) * palette[1]) / 5;
+            }
+            else
+            {
+                palette[i] = i == 6 ? 0 : 255;
+            }
+        }
+        uint64_t indices = 0;
+        for (int i = 0; i < 6; i++)
+        {
+            indices |= static_cast<uint64_t>(in[2 + i]) << (8 * i);
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            block[i][3] = static_cast<uint8_t>(palette[(indices >> (3 * i)) & 7]);
+        }
+    }
+
+    // scrive e legge i bit di un blocco BC7, a partire dal bit meno significativo del primo byte
+    struct BitStream
+    {
+        uint8_t *bytes;
+        int position = 0;
+
+        void write(uint32_t value, int count)
+        {
+            for (int i = 0; i < count; i++, position++)
+            {
+                bytes[position / 8] |= ((value >> i) & 1) << (position % 8);
+            }
+        }
+
+        uint32_t read(int count)
+        {
+            uint32_t value = 0;
+            for (int i = 0; i < count; i++, position++)
+            {
+                value |= static_cast<uint32_t>((bytes[position / 8] >> (position % 8)) & 1) << i;
+            }
+            return value;
+        }
+    };
+
+    // quantizza un estremo a 7 bit per canale più il bit p condiviso, scegliendo il bit p con l'errore minore
+    void quantizeBc7Endpoint(const float endpoint[4], int quantized[4], int &pBit)
+    {
+        float bestError = 1e30f;
+        for (int p = 0; p < 2; p++)
+        {
+            int candidate[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; c++)
+            {
+                candidate[c] = std::clamp(static_cast<int>(std::floor((endpoint[c] - p) / 2.0f + 0.5f)), 0, 127);
+                float d = ((candidate[c] << 1) | p) - endpoint[c];
+                error += d * d;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                pBit = p;
+                std::copy(candidate, candidate + 4, quantized);
+            }
+        }
+    }
+
+    // blocco BC7 in modo 6: estremi RGBA a 7 bit più un bit p ciascuno, 16 indici a 4 bit
+    void encodeBc7Block(const Block block, uint8_t out[16])
+    {
+        float low[4], high[4];
+        principalEndpoints(block, 4, low, high);
+        int q0[4], q1[4], p0, p1;
+        quantizeBc7Endpoint(low, q0, p0);
+        quantizeBc7Endpoint(high, q1, p1);
+
+        int palette[16][4];
+        for (int i = 0; i < 16; i++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                int e0 = (q0[c] << 1) | p0, e1 = (q1[c] << 1) | p1;
+                palette[i][c] = ((64 - BC7_WEIGHTS4[i]) * e0 + BC7_WEIGHTS4[i] * e1 + 32) >> 6;
+            }
+        }
+        int indices[16];
+        for (int i = 0; i < 16; i++)
+        {
+            indices[i] = nearestIndex(block[i], palette, 16, 4);
+        }
+        // il bit più significativo dell'indice del primo pixel non viene scritto: deve essere 0, altrimenti scambiamo gli estremi
+        if (indices[0] >= 8)
+        {
+            std::swap(q0, q1);
+            std::swap(p0, p1);
+            for (int &index : indices)
+            {
+                index = 15 - index;
+            }
+        }
+
+        std::memset(out, 0, 16);
+        BitStream bits{out};
+        bits.write(1 << 6, 7); // modo 6: sei bit a 0 e poi un bit a 1
+        for (int c = 0; c < 4; c++)
+        {
+            bits.write(q0[c], 7);
+            bits.write(q1[c], 7);
+        }
+        bits.write(p0, 1);
+        bits.write(p1, 1);
+        bits.write(indices[0], 3);
+        for (int i = 1; i < 16; i++)
+        {
+            bits.write(indices[i], 4);
+        }
+    }
+
+    void decodeBc7Block(const uint8_t in[16], Block block)
+    {
+        uint8_t bytes[16];
+        std::memcpy(bytes, in, 16);
+        BitStream bits{bytes};
+        if (bits.read(7) != (1u << 6))
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                block[i][0] = 255;
+                block[i][1] = 0;
+                block[i][2] = 255;
+                block[i][3] = 255;
+            }
+            return;
+        }
+        int e0[4], e1[4];
+        for (int c = 0; c < 4; c++)
+        {
+            e0[c] = bits.read(7) << 1;
+            e1[c] = bits.read(7) << 1;
+        }
+        int p0 = bits.read(1), p1 = bits.read(1);
+        for (int c = 0; c < 4; c++)
+        {
+            e0[c] |= p0;
+            e1[c] |= p1;
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            int weight = BC7_WEIGHTS4[bits.read(i == 0 ? 3 : 4)];
+            for (int c = 0; c < 4; c++)
+            {
+                block[i][c] = static_cast<uint8_t>(((64 - weight) * e0[c] + weight * e1[c] + 32) >> 6);
+            }
+        }
+    }
+
+    size_t blockSize(BlockFormat format)
+    {
+        return format == BlockFormat::BC1 ? 8 : 16;
+    }
+}
+
+const char *blockFormatName(BlockFormat format)
+{
+    switch (format)
+    {
+    case BlockFormat::BC1:
+        return "BC1";
+    case BlockFormat::BC3:
+        return "BC3";
+    case BlockFormat::BC7:
+        return "BC7";
+    default:
+        return "sconosciuto";
+    }
+}
+
+size_t compressedImageSize(uint32_t width, uint32_t height, BlockFormat format)
+{
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockSize(format);
+}
+
+bool hasTransparentPixels(const uint8_t *pixels, size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        if (pixels[i * 4 + 3] != 255)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<uint8_t> compressImage(const uint8_t *pixels, uint32_t width, uint32_t height, BlockFormat format)
+{
+    std::vector<uint8_t> blocks(compressedImageSize(width, height, format));
+    uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    Block block;
+    for (uint32_t by = 0; by < blocksY; by++)
+    {
+        for (uint32_t bx = 0; bx < blocksX; bx++)
+        {
+            fetchBlock(pixels, width, height, bx, by, block);
+            uint8_t *out = blocks.data() + (static_cast<size_t>(by) * blocksX + bx) * blockSize(format);
+            switch (format)
+            {
+            case BlockFormat::BC1:
+                encodeColorBlock(block, out);
+                break;
+            case BlockFormat::BC3:
+                encodeAlphaBlock(block, out);
+                encodeColorBlock(block, out + 8);
+                break;
+            case BlockFormat::BC7:
+                encodeBc7Block(block, out);
+                break;
+            }
+        }
+    }
+    return blocks;
+}
+
+std::vector<uint8_t> decompressImage(const uint8_t *blocks, uint32_t width, uint32_t height, BlockFormat format)
+{
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+    uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    Block block;
+    for (uint32_t by = 0; by < blocksY; by++)
+    {
+        for (uint32_t bx = 0; bx < blocksX; bx++)
+        {
+            const uint8_t *in = blocks + (static_cast<size_t>(by) * blocksX + bx) * blockSize(format);
+            switch (format)
+            {
+            case BlockFormat::BC1:
+                decodeColorBlock(in, true, block);
+                break;
+            case BlockFormat::BC3:
+                decodeColorBlock(in + 8, false, block);
+                decodeAlphaBlock(in, block);
+                break;
+            case BlockFormat::BC7:
+                decodeBc7Block(in, block);
+                break;
+            }
+            storeBlock(block, pixels.data(), width, height, bx, by);
+        }
+    }
+    return pixels;
+}
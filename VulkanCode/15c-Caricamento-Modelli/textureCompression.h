@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Formati a blocchi in cui si possono comprimere le texture, tutti con blocchi di 4x4 pixel.
+ */
+enum class BlockFormat
+{
+    BC1, // 8 byte per blocco (0.5 byte per pixel), solo colore senza trasparenza
+    BC3, // 16 byte per blocco, colore come BC1 più un canale alfa a 8 livelli
+    BC7  // 16 byte per blocco, colore e alfa insieme con 16 livelli di interpolazione, la qualità migliore
+};
+
+/**
+ * @brief Restituisce il nome di un formato, usato nei messaggi.
+ * @param format Il formato.
+ * @return Il nome del formato.
+ */
+const char *blockFormatName(BlockFormat format);
+
+/**
+ * @brief Calcola la dimensione di un'immagine compressa.
+ *
+ * @param width La larghezza dell'immagine.
+ * @param height L'altezza dell'immagine.
+ * @param format Il formato.
+ * @return La dimensione in byte, con i blocchi incompleti sui bordi contati interi.
+ */
+size_t compressedImageSize(uint32_t width, uint32_t height, BlockFormat format);
+
+/**
+ * @brief Controlla se un'immagine RGBA ha pixel trasparenti, per scegliere tra BC1 e un formato con alfa.
+ *
+ * @param pixels I pixel, 4 byte ciascuno.
+ * @param pixelCount Il numero di pixel.
+ * @return true se almeno un pixel ha alfa diverso da 255.
+ */
+bool hasTransparentPixels(const uint8_t *pixels, size_t pixelCount);
+
+/**
+ * @brief Comprime un'immagine RGBA a 8 bit per canale in un formato a blocchi.
+ *
+ * Gli estremi di ogni blocco sono presi lungo la direzione principale dei colori del blocco (PCA), poi ogni pixel usa il colore interpolato più vicino.
+ * Per BC7 viene usato solo il modo 6 (un solo gruppo di pixel, colore e alfa insieme): è il più semplice e va bene per le texture dei modelli.
+ * Sui bordi delle immagini con lati non multipli di 4 i blocchi ripetono l'ultimo pixel.
+ *
+ * @param pixels I pixel, width * height * 4 byte.
+ * @param width La larghezza dell'immagine.
+ * @param height L'altezza dell'immagine.
+ * @param format Il formato.
+ * @return I blocchi compressi, riga per riga.
+ */
+std::vector<uint8_t> compressImage(const uint8_t *pixels, uint32_t width, uint32_t height, BlockFormat format);
+
+/**
+ * @brief Decomprime un'immagine compressa con compressImage, per misurare l'errore della compressione.
+ *
+ * Per BC7 decodifica solo i blocchi in modo 6, gli altri diventano magenta.
+ *
+ * @param blocks I blocchi compressi.
+ * @param width La larghezza dell'immagine.
+ * @param height L'altezza dell'immagine.
+ * @param format Il formato.
+ * @return I pixel RGBA, width * height * 4 byte.
+ */
+std::vector<uint8_t> decompressImage(const uint8_t *blocks, uint32_t width, uint32_t height, BlockFormat format);
@@ -0,0 +1,164 @@
+#include "textureTable.h"
+#include <stdexcept>
+#include <algorithm>
+
+TextureTable::TextureTable(VkDevice device, uint32_t capacity, uint32_t frameCount, bool bindless, VkSampler immutableSampler)
+    : device(device), capacity(capacity), bindless(bindless), slots(capacity), dirtyFrames(bindless ? 1 : frameCount, false)
+{
+    // un solo binding con tutti i posti della tabella
+    std::vector<VkSampler> immutableSamplers(capacity, immutableSampler);
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = capacity;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    // con gli immutable sampler il sampler fa parte del layout: il driver può metterlo direttamente nello shader
+    // e il sampler scritto nei descriptor insieme alle texture viene ignorato
+    binding.pImmutableSamplers = immutableSampler != VK_NULL_HANDLE ? immutableSamplers.data() : nullptr;
+
+    // PARTIALLY_BOUND: i posti che la shader non legge possono restare vuoti
+    // UPDATE_AFTER_BIND e UPDATE_UNUSED_WHILE_PENDING: i posti non usati possono essere scritti anche mentre i frame in volo usano il set
+    VkDescriptorBindingFlagsEXT bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                                               VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                                               VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsInfo.bindingCount = 1;
+    bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = bindless ? &bindingFlagsInfo : nullptr;
+    layoutInfo.flags = bindless ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT : 0;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create texture table layout!");
+    }
+
+    uint32_t setCount = static_cast<uint32_t>(dirtyFrames.size());
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = capacity * setCount;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = bindless ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT : 0; // obbligatorio per i set con layout UPDATE_AFTER_BIND_POOL
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = setCount;
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+    {
+        vkDestroyDescriptorSetLayout(device, layout, nullptr);
+        throw std::runtime_error("failed to create texture table descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(setCount, layout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = pool;
+    allocInfo.descriptorSetCount = setCount;
+    allocInfo.pSetLayouts = layouts.data();
+    sets.resize(setCount);
+    if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS)
+    {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+        vkDestroyDescriptorSetLayout(device, layout, nullptr);
+        throw std::runtime_error("failed to allocate texture table descriptor sets!");
+    }
+}
+
+TextureTable::~TextureTable()
+{
+    vkDestroyDescriptorPool(device, pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, layout, nullptr);
+}
+
+uint32_t TextureTable::add(const VkDescriptorImageInfo &imageInfo)
+{
+    if (nextSlot >= capacity)
+    {
+        throw std::runtime_error("texture table is full!");
+    }
+    uint32_t slot = nextSlot++;
+    slots[slot] = imageInfo;
+    usedSlots++;
+
+    if (bindless)
+    {
+        // il posto non è mai stato usato, quindi nessun frame in volo lo legge e può essere scritto subito
+        write(sets[0], {slot});
+    }
+    else
+    {
+        std::fill(dirtyFrames.begin(), dirtyFrames.end(), true);
+    }
+    return slot;
+}
+
+bool TextureTable::update(uint32_t frameIndex)
+{
+    if (bindless || !dirtyFrames[frameIndex] || usedSlots == 0)
+    {
+        return false;
+    }
+    // senza descriptor indexing la tabella è piccola (MAX_TEXTURES posti), quindi la riscriviamo tutta
+    std::vector<uint32_t> allSlots(capacity);
+    for (uint32_t slot = 0; slot < capacity; slot++)
+    {
+        allSlots[slot] = slot;
+    }
+    write(sets[frameIndex], allSlots);
+    dirtyFrames[frameIndex] = false;
+    return true;
+}
+
+void TextureTable::write(VkDescriptorSet set, const std::vector<uint32_t> &slotsToWrite)
+{
+    // senza PARTIALLY_BOUND tutti i posti devono contenere una texture valida, quelli vuoti ripetono la prima texture della tabella
+    auto filler = std::find_if(slots.begin(), slots.end(), [](const VkDescriptorImageInfo &info)
+                               { return info.imageView != VK_NULL_HANDLE; });
+    std::vector<VkDescriptorImageInfo> imageInfos;
+    std::vector<VkWriteDescriptorSet> writes;
+    imageInfos.reserve(slotsToWrite.size());
+    writes.reserve(slotsToWrite.size());
+    for (uint32_t slot : slotsToWrite)
+    {
+        imageInfos.push_back(slots[slot].imageView != VK_NULL_HANDLE ? slots[slot] : *filler);
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = set;
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = slot;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = &imageInfos.back();
+        writes.push_back(descriptorWrite);
+    }
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+VkDescriptorSetLayout TextureTable::getLayout() const
+{
+    return layout;
+}
+
+VkDescriptorSet TextureTable::getDescriptorSet(uint32_t frameIndex) const
+{
+    return sets[bindless ? 0 : frameIndex];
+}
+
+uint32_t TextureTable::getCapacity() const
+{
+    return capacity;
+}
+
+uint32_t TextureTable::size() const
+{
+    return usedSlots;
+}
+
+bool TextureTable::isBindless() const
+{
+    return bindless;
+}
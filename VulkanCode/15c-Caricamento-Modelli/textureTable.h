@@ -0,0 +1,111 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+/**
+ * @brief Tabella globale delle texture: un solo descriptor set con un array di texture, in cui ogni texture ha un posto fisso.
+ *
+ * Le shader ricevono l'indice del posto con una push constant, quindi le mesh non hanno bisogno di un loro array di texture
+ * e aggiungere una texture vuol dire scrivere un solo descriptor, senza ricreare né riscrivere i descriptor set delle mesh.
+ * I posti non vengono mai liberati né riusati, quindi l'indice di una texture non cambia mai e un posto nuovo non è mai letto dai frame in volo.
+ *
+ * Con VK_EXT_descriptor_indexing (bindless) c'è un solo descriptor set, creato con UPDATE_AFTER_BIND e PARTIALLY_BOUND:
+ *  - i posti vuoti possono restare senza descriptor, quindi la tabella può avere migliaia di posti senza doverli riempire
+ *  - i descriptor dei posti nuovi vengono scritti subito, anche mentre il set è usato dai frame in volo (UPDATE_UNUSED_WHILE_PENDING)
+ * Senza l'estensione ogni frame in volo ha la sua copia della tabella, con tutti i posti vuoti riempiti con la prima texture,
+ * e le modifiche vengono scritte nella copia di un frame con update, quando la GPU ha finito di usarla.
+ * Non è thread safe: va usata solo dal thread che disegna i frame.
+ */
+class TextureTable
+{
+public:
+    /**
+     * @brief Costruttore della classe TextureTable.
+     *
+     * Crea il layout, il descriptor pool e i descriptor set della tabella.
+     *
+     * @param device Il dispositivo Vulkan su cui operare.
+     * @param capacity Il numero di posti della tabella, deve essere lo stesso dell'array di texture nella fragment shader.
+     * @param frameCount Il numero di frame in volo, serve solo senza descriptor indexing.
+     * @param bindless true se il dispositivo ha VK_EXT_descriptor_indexing con le feature per le texture attive.
+     * @param immutableSampler Il sampler da mettere nel layout come immutable sampler, VK_NULL_HANDLE per usare quello delle texture.
+     * @throws std::runtime_error Se non è possibile creare le risorse Vulkan.
+     */
+    TextureTable(VkDevice device, uint32_t capacity, uint32_t frameCount, bool bindless, VkSampler immutableSampler);
+
+    /**
+     * @brief Distruttore della classe TextureTable.
+     *
+     * Distrugge il descriptor pool, con tutti i suoi set, e il layout.
+     */
+    ~TextureTable();
+
+    /**
+     * @brief Aggiunge una texture alla tabella.
+     *
+     * @param imageInfo Il descriptor della texture (vedi Texture::getDescriptorInfo).
+     * @return Il posto della texture, da passare alla shader come indice.
+     * @throws std::runtime_error Se la tabella è piena.
+     */
+    uint32_t add(const VkDescriptorImageInfo &imageInfo);
+
+    /**
+     * @brief Scrive nella copia della tabella di un frame le modifiche fatte dopo il suo ultimo aggiornamento.
+     *
+     * Serve solo senza descriptor indexing, con bindless non fa niente. Va chiamato dopo aver aspettato la fence del frame,
+     * prima di registrare i suoi comandi.
+     *
+     * @param frameIndex Il frame in volo.
+     * @return true se la copia del frame è stata riscritta: i command buffer già registrati che la usano non sono più validi.
+     */
+    bool update(uint32_t frameIndex);
+
+    /**
+     * @brief Restituisce il layout della tabella, da mettere nel pipeline layout.
+     * @return Il layout del descriptor set.
+     */
+    VkDescriptorSetLayout getLayout() const;
+
+    /**
+     * @brief Restituisce il descriptor set da collegare per disegnare un frame.
+     * @param frameIndex Il frame in volo.
+     * @return Il descriptor set della tabella, lo stesso per tutti i frame con bindless.
+     */
+    VkDescriptorSet getDescriptorSet(uint32_t frameIndex) const;
+
+    /**
+     * @brief Restituisce il numero di posti della tabella.
+     * @return Il numero massimo di texture.
+     */
+    uint32_t getCapacity() const;
+
+    /**
+     * @brief Restituisce il numero di posti occupati.
+     * @return Il numero di texture nella tabella.
+     */
+    uint32_t size() const;
+
+    /**
+     * @brief Indica se la tabella usa VK_EXT_descriptor_indexing.
+     * @return true se c'è un solo descriptor set aggiornato subito.
+     */
+    bool isBindless() const;
+
+private:
+    // scrive i posti indicati nel descriptor set, i posti vuoti prendono la prima texture
+    void write(VkDescriptorSet set, const std::vector<uint32_t> &slotsToWrite);
+
+    VkDevice device;
+    uint32_t capacity;
+    bool bindless;
+
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> sets; // uno solo con bindless, uno per frame in volo altrimenti
+
+    std::vector<VkDescriptorImageInfo> slots; // descriptor di ogni posto, imageView VK_NULL_HANDLE se il posto è libero
+    uint32_t usedSlots = 0;                   // posti occupati
+    uint32_t nextSlot = 0;                    // primo posto mai usato
+    std::vector<bool> dirtyFrames;            // frame la cui copia della tabella va riscritta, solo senza bindless
+};
@@ -0,0 +1,54 @@
+#include "uniformRing.h"
+#include "bufferUtils.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+UniformRing::UniformRing(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize, uint32_t blocksPerFrame, uint32_t frameCount, VkMemoryPropertyFlags memoryProperties)
+    : device(device)
+{
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+    frameSize = (blockSize + alignment - 1) / alignment * alignment * blocksPerFrame;
+
+    createBuffer(device, physicalDevice, frameSize * frameCount,
+                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                 memoryProperties, MemoryCategory::Uniform,
+                 buffer, bufferMemory);
+    mapped = static_cast<uint8_t *>(bufferMemory.mapped);
+}
+
+UniformRing::~UniformRing()
+{
+    destroyBuffer(device, buffer, bufferMemory);
+}
+
+void UniformRing::beginFrame(uint32_t frameIndex)
+{
+    frameBegin = frameSize * frameIndex;
+    head = 0;
+}
+
+uint32_t UniformRing::push(const void *data, VkDeviceSize size)
+{
+    if (head + size > frameSize)
+    {
+        throw std::runtime_error("uniform ring frame is full!");
+    }
+    VkDeviceSize offset = frameBegin + head;
+    memcpy(mapped + offset, data, size);
+    head += (size + alignment - 1) / alignment * alignment;
+    peakUsedBytes = std::max(peakUsedBytes, head);
+    return static_cast<uint32_t>(offset);
+}
+
+VkBuffer UniformRing::getBuffer() const
+{
+    return buffer;
+}
+
+VkDeviceSize UniformRing::getPeakUsedBytes() const
+{
+    return peakUsedBytes;
+}
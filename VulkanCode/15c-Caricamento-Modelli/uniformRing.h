@@ -0,0 +1,83 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include "deviceAllocator.h"
+
+/**
+ * @brief Buffer uniforme diviso in una zona per ogni frame in volo, in cui ogni oggetto disegnato scrive i suoi dati.
+ *
+ * Ogni oggetto prende con push un blocco nuovo della zona del frame, allineato a minUniformBufferOffsetAlignment,
+ * e il blocco viene scelto al momento del disegno con l'offset dinamico di un descriptor VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC.
+ * Così ogni comando di disegno legge i dati del suo oggetto, invece di quelli scritti per ultimi, e basta un solo descriptor set per tutto:
+ * anche la zona del frame viene scelta dall'offset dinamico.
+ * La zona di un frame viene riusata dall'inizio con beginFrame, quando la GPU ha finito il frame che la usava.
+ * Non è thread safe: va usata solo dal thread che registra i comandi.
+ */
+class UniformRing
+{
+public:
+    /**
+     * @brief Costruttore della classe UniformRing.
+     *
+     * Crea il buffer, con una zona per ogni frame in volo, e lo mappa.
+     *
+     * @param device Il dispositivo Vulkan su cui operare.
+     * @param physicalDevice Il dispositivo fisico Vulkan, per l'allineamento degli offset.
+     * @param blockSize La dimensione dei dati di un oggetto, ogni blocco viene arrotondato all'allineamento.
+     * @param blocksPerFrame Il numero massimo di oggetti disegnati in un frame.
+     * @param frameCount Il numero di frame in volo.
+     * @param memoryProperties Le proprietà della memoria, devono comprendere host visible e host coherent.
+     */
+    UniformRing(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize, uint32_t blocksPerFrame, uint32_t frameCount, VkMemoryPropertyFlags memoryProperties);
+
+    /**
+     * @brief Distruttore della classe UniformRing.
+     *
+     * Distrugge il buffer: la GPU non deve più usarlo.
+     */
+    ~UniformRing();
+
+    /**
+     * @brief Inizia a scrivere i blocchi di un frame, dall'inizio della sua zona.
+     *
+     * Va chiamato dopo aver aspettato la fence del frame, perché i blocchi scritti nel suo giro precedente vengono sovrascritti.
+     *
+     * @param frameIndex Il frame in volo.
+     */
+    void beginFrame(uint32_t frameIndex);
+
+    /**
+     * @brief Copia i dati di un oggetto in un blocco nuovo della zona del frame corrente.
+     *
+     * @param data I dati da copiare.
+     * @param size La dimensione dei dati, al massimo quella indicata nel descriptor.
+     * @return L'offset dinamico del blocco, da passare a vkCmdBindDescriptorSets.
+     * @throws std::runtime_error Se la zona del frame è piena.
+     */
+    uint32_t push(const void *data, VkDeviceSize size);
+
+    /**
+     * @brief Restituisce il buffer, da scrivere nel descriptor set con offset 0.
+     * @return Il buffer uniforme.
+     */
+    VkBuffer getBuffer() const;
+
+    /**
+     * @brief Restituisce il numero massimo di byte usati in un frame, per dimensionare la zona di ogni frame.
+     * @return Il picco dei byte usati.
+     */
+    VkDeviceSize getPeakUsedBytes() const;
+
+private:
+    VkDevice device;
+    VkDeviceSize alignment; // minUniformBufferOffsetAlignment del dispositivo
+    VkDeviceSize frameSize; // dimensione della zona di ogni frame, multipla dell'allineamento
+
+    VkBuffer buffer;
+    DeviceAllocation bufferMemory;
+    uint8_t *mapped; // la memoria host visible è già mappata dall'allocatore
+
+    VkDeviceSize frameBegin = 0; // inizio della zona del frame corrente
+    VkDeviceSize head = 0;       // prossimo byte libero della zona, relativo a frameBegin
+    VkDeviceSize peakUsedBytes = 0;
+};
@@ -0,0 +1,321 @@
+#include "uploadBatch.h"
+#include "bufferUtils.h"
+#include "mipmap.h"
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+// le fasi e gli accessi con cui i comandi di disegno leggono buffer e texture caricati
+const VkPipelineStageFlags UPLOAD_CONSUMER_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+const VkAccessFlags UPLOAD_BUFFER_CONSUMER_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+
+UploadBatch::UploadBatch(VkDevice device, VkPhysicalDevice physicalDevice, bool directUploads,
+                         VkCommandPool transferCommandPool, VkQueue transferQueue, uint32_t transferFamily,
+                         VkCommandPool graphicsCommandPool, VkQueue graphicsQueue, uint32_t graphicsFamily, StagingRing *stagingRing)
+    : device(device), physicalDevice(physicalDevice), directUploads(directUploads), transferCommandPool(transferCommandPool), transferQueue(transferQueue), transferFamily(transferFamily),
+      graphicsCommandPool(graphicsCommandPool), graphicsQueue(graphicsQueue), graphicsFamily(graphicsFamily), stagingRing(stagingRing)
+{
+}
+
+UploadBatch::~UploadBatch()
+{
+    submit();
+    stagingRing->flush();
+    // le acquisizioni non ancora inviate non servono più: le copie sono finite, quindi i loro semafori possono essere distrutti
+    for (auto &pendingAcquire : pendingAcquires)
+    {
+        vkFreeCommandBuffers(device, graphicsCommandPool, 1, &pendingAcquire.commandBuffer);
+        vkDestroySemaphore(device, pendingAcquire.semaphore, nullptr);
+    }
+    for (auto &used : usedSemaphores)
+    {
+        vkDestroySemaphore(device, used.second, nullptr);
+    }
+    for (VkSemaphore semaphore : freeSemaphores)
+    {
+        vkDestroySemaphore(device, semaphore, nullptr);
+    }
+}
+
+bool UploadBatch::separateQueues() const
+{
+    return transferFamily != graphicsFamily;
+}
+
+VkCommandBuffer UploadBatch::commandBuffer()
+{
+    if (currentCommandBuffer == VK_NULL_HANDLE)
+    {
+        currentCommandBuffer = beginSingleTimeCommands(device, transferCommandPool);
+    }
+    return currentCommandBuffer;
+}
+
+StagingAllocation UploadBatch::stage(const void *data, VkDeviceSize size)
+{
+    StagingAllocation staging;
+    if (!stagingRing->tryAllocate(size, staging))
+    {
+        // il buffer di staging è pieno di dati che aspettano ancora questo command buffer: lo inviamo e ne iniziamo un altro
+        submit();
+        staging = stagingRing->allocate(size);
+    }
+    memcpy(staging.data, data, static_cast<size_t>(size));
+    return staging;
+}
+
+void UploadBatch::createDeviceBuffer(const void *data, VkDeviceSize size, VkBufferUsageFlags usage, MemoryCategory category, VkBuffer &buffer, DeviceAllocation &bufferMemory)
+{
+    if (directUploads)
+    {
+        // la memoria è coerente e le scritture della CPU fatte prima di vkQueueSubmit sono visibili ai comandi inviati,
+        // quindi non servono né copie né barriere
+        createBuffer(device, physicalDevice, size, usage,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     category, buffer, bufferMemory);
+        memcpy(bufferMemory.mapped, data, static_cast<size_t>(size));
+        return;
+    }
+    createBuffer(device, physicalDevice, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, category, buffer, bufferMemory);
+    uploadBuffer(buffer, data, size);
+}
+
+void UploadBatch::uploadBuffer(VkBuffer dstBuffer, const void *data, VkDeviceSize size)
+{
+    StagingAllocation staging = stage(data, size);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = staging.offset;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(commandBuffer(), staging.buffer, dstBuffer, 1, &copyRegion);
+    pendingBufferCopies = true;
+
+    if (separateQueues())
+    {
+        VkBufferMemoryBarrier transfer{};
+        transfer.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        transfer.srcQueueFamilyIndex = transferFamily;
+        transfer.dstQueueFamilyIndex = graphicsFamily;
+        transfer.buffer = dstBuffer;
+        transfer.offset = 0;
+        transfer.size = VK_WHOLE_SIZE;
+        bufferTransfers.push_back(transfer);
+    }
+}
+
+void UploadBatch::uploadImage(VkImage image, VkFormat format, const void *pixels, VkDeviceSize size, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    // vkCmdBlitImage funziona solo sulle code grafiche, quindi con la coda di trasferimento le mipmap vengono generate sulla CPU
+    bool blitMipmaps = mipLevels > 1 && generatesMipmaps(format);
+    if (mipLevels > 1 && !blitMipmaps)
+    {
+        bool srgb = format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_B8G8R8A8_SRGB;
+        std::vector<size_t> levelOffsets;
+        std::vector<uint8_t> chain = generateMipChain(static_cast<const uint8_t *>(pixels), width, height, mipLevels, srgb, levelOffsets);
+        std::vector<ImageLevel> levels(mipLevels);
+        for (uint32_t level = 0; level < mipLevels; level++)
+        {
+            levels[level] = {levelOffsets[level], std::max(1u, width >> level), std::max(1u, height >> level)};
+        }
+        uploadImageLevels(image, chain.data(), chain.size(), levels);
+        return;
+    }
+
+    StagingAllocation staging = stage(pixels, size);
+    VkCommandBuffer cmd = commandBuffer();
+    recordTransitionImageLayout(cmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels); // teniamo il layout undefined perché non ci interessa prima del trasferimento
+    recordCopyBufferToImage(cmd, staging.buffer, staging.offset, image, width, height, 0);
+    if (blitMipmaps)
+    {
+        recordGenerateMipmaps(cmd, image, width, height, mipLevels);
+        return;
+    }
+    finishImageUpload(cmd, image, mipLevels);
+}
+
+bool UploadBatch::generatesMipmaps(VkFormat format) const
+{
+    return !separateQueues() && supportsLinearBlit(physicalDevice, format);
+}
+
+void UploadBatch::uploadImageLevels(VkImage image, const void *data, VkDeviceSize size, const std::vector<ImageLevel> &levels)
+{
+    uint32_t mipLevels = static_cast<uint32_t>(levels.size());
+    StagingAllocation staging = stage(data, size);
+    VkCommandBuffer cmd = commandBuffer();
+    recordTransitionImageLayout(cmd, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+    for (uint32_t level = 0; level < mipLevels; level++)
+    {
+        recordCopyBufferToImage(cmd, staging.buffer, staging.offset + levels[level].offset, image, levels[level].width, levels[level].height, level);
+    }
+    finishImageUpload(cmd, image, mipLevels);
+}
+
+void UploadBatch::finishImageUpload(VkCommandBuffer cmd, VkImage image, uint32_t mipLevels)
+{
+    if (!separateQueues())
+    {
+        recordTransitionImageLayout(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+        return;
+    }
+    // la transizione verso SHADER_READ_ONLY viene fatta dal passaggio tra le famiglie di code, che deve indicare gli stessi layout in rilascio e acquisizione
+    VkImageMemoryBarrier transfer{};
+    transfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    transfer.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    transfer.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    transfer.srcQueueFamilyIndex = transferFamily;
+    transfer.dstQueueFamilyIndex = graphicsFamily;
+    transfer.image = image;
+    transfer.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    transfer.subresourceRange.baseMipLevel = 0;
+    transfer.subresourceRange.levelCount = mipLevels;
+    transfer.subresourceRange.baseArrayLayer = 0;
+    transfer.subresourceRange.layerCount = 1;
+    imageTransfers.push_back(transfer);
+}
+
+uint64_t UploadBatch::submit()
+{
+    if (currentCommandBuffer == VK_NULL_HANDLE)
+    {
+        submitAcquires(0, false);
+        return 0;
+    }
+    if (separateQueues())
+    {
+        // rilascio: le barriere sulla coda di trasferimento rendono disponibili le scritture delle copie,
+        // gli accessi di destinazione vengono ignorati perché appartengono all'acquisizione
+        for (auto &transfer : bufferTransfers)
+        {
+            transfer.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            transfer.dstAccessMask = 0;
+        }
+        for (auto &transfer : imageTransfers)
+        {
+            transfer.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            transfer.dstAccessMask = 0;
+        }
+        vkCmdPipelineBarrier(currentCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr, static_cast<uint32_t>(bufferTransfers.size()), bufferTransfers.data(),
+                             static_cast<uint32_t>(imageTransfers.size()), imageTransfers.data());
+
+        // acquisizione: le stesse barriere sulla coda grafica, registrate subito ma inviate solo quando serve
+        for (auto &transfer : bufferTransfers)
+        {
+            transfer.srcAccessMask = 0;
+            transfer.dstAccessMask = UPLOAD_BUFFER_CONSUMER_ACCESS;
+        }
+        for (auto &transfer : imageTransfers)
+        {
+            transfer.srcAccessMask = 0;
+            transfer.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        }
+        VkCommandBuffer acquireCommandBuffer = beginSingleTimeCommands(device, graphicsCommandPool);
+        vkCmdPipelineBarrier(acquireCommandBuffer, UPLOAD_CONSUMER_STAGES, UPLOAD_CONSUMER_STAGES, 0,
+                             0, nullptr, static_cast<uint32_t>(bufferTransfers.size()), bufferTransfers.data(),
+                             static_cast<uint32_t>(imageTransfers.size()), imageTransfers.data());
+        bufferTransfers.clear();
+        imageTransfers.clear();
+        pendingBufferCopies = false;
+
+        VkSemaphore semaphore;
+        if (!freeSemaphores.empty())
+        {
+            semaphore = freeSemaphores.back();
+            freeSemaphores.pop_back();
+        }
+        else
+        {
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create upload semaphore!");
+            }
+        }
+        uint64_t submission = stagingRing->submit(transferQueue, transferCommandPool, currentCommandBuffer, semaphore);
+        currentCommandBuffer = VK_NULL_HANDLE;
+        submitCount++;
+        pendingAcquires.push_back(PendingAcquire{submission, acquireCommandBuffer, semaphore});
+        submitAcquires(0, false);
+        return submission;
+    }
+    if (pendingBufferCopies)
+    {
+        // una sola barriera per tutte le copie nei buffer: la CPU non aspetta la fine delle copie,
+        // quindi è la barriera a garantire che i draw inviati dopo leggano i dati già copiati
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+        vkCmdPipelineBarrier(currentCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+        pendingBufferCopies = false;
+    }
+    uint64_t submission = stagingRing->submit(transferQueue, transferCommandPool, currentCommandBuffer);
+    currentCommandBuffer = VK_NULL_HANDLE;
+    submitCount++;
+    // con una sola coda i comandi di disegno inviati dopo vedono già i dati
+    lastAcquired = submission;
+    return submission;
+}
+
+void UploadBatch::submitAcquires(uint64_t submission, bool force)
+{
+    // i semafori aspettati da acquisizioni già finite possono essere riusati
+    while (!usedSemaphores.empty() && stagingRing->isComplete(usedSemaphores.front().first))
+    {
+        freeSemaphores.push_back(usedSemaphores.front().second);
+        usedSemaphores.pop_front();
+    }
+    // le acquisizioni vengono inviate nell'ordine delle copie, così lastAcquired vale per tutti gli invii precedenti
+    // vengono inviate solo subito dopo un invio di copie: il buffer di staging non ha porzioni aperte da attribuire al command buffer di acquisizione
+    while (!pendingAcquires.empty())
+    {
+        PendingAcquire &pendingAcquire = pendingAcquires.front();
+        if (!(force && pendingAcquire.submission <= submission) && !stagingRing->isComplete(pendingAcquire.submission))
+        {
+            break;
+        }
+        uint64_t acquireSubmission = stagingRing->submit(graphicsQueue, graphicsCommandPool, pendingAcquire.commandBuffer,
+                                                         VK_NULL_HANDLE, pendingAcquire.semaphore, UPLOAD_CONSUMER_STAGES);
+        usedSemaphores.emplace_back(acquireSubmission, pendingAcquire.semaphore);
+        lastAcquired = pendingAcquire.submission;
+        pendingAcquires.pop_front();
+    }
+}
+
+void UploadBatch::acquire(uint64_t submission)
+{
+    if (submission == 0)
+    {
+        return;
+    }
+    // se ci sono copie registrate ma non inviate, l'invio le manda prima delle acquisizioni
+    submit();
+    submitAcquires(submission, true);
+}
+
+bool UploadBatch::isReady(uint64_t submission) const
+{
+    return submission <= lastAcquired;
+}
+
+void UploadBatch::wait(uint64_t submission)
+{
+    if (submission > 0)
+    {
+        stagingRing->wait(submission);
+    }
+}
+
+uint32_t UploadBatch::getSubmitCount() const
+{
+    return submitCount;
+}
+
+bool UploadBatch::usesDirectUploads() const
+{
+    return directUploads;
+}
@@ -0,0 +1,221 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include "stagingRing.h"
+
+/**
+ * @brief Posizione e dimensioni di un livello di mipmap nei dati passati a UploadBatch::uploadImageLevels.
+ */
+struct ImageLevel
+{
+    VkDeviceSize offset; // posizione dei dati del livello, multipla della dimensione di un texel o di un blocco compresso
+    uint32_t width;      // larghezza del livello in pixel
+    uint32_t height;     // altezza del livello in pixel
+};
+
+/**
+ * @brief Raccoglie più caricamenti sulla GPU in un solo command buffer.
+ *
+ * Ogni caricamento (buffer o texture) copia i dati nel buffer di staging e registra copia e barriere nel command buffer corrente,
+ * che viene creato al primo caricamento. Con submit il command buffer viene inviato una sola volta, con una sola fence,
+ * e la CPU aspetta solo se chiama wait: i comandi di disegno inviati dopo sulla stessa coda vedono comunque i dati,
+ * grazie alle barriere registrate alla fine del command buffer.
+ *
+ * Se il dispositivo ha una coda di trasferimento dedicata le copie vengono fatte lì, senza rubare tempo al rendering.
+ * In questo caso buffer e immagini appartengono alla famiglia di code di trasferimento finché non vengono passati a quella grafica:
+ * il command buffer delle copie finisce con le barriere di rilascio e segnala un semaforo, e sulla coda grafica viene inviato
+ * un piccolo command buffer con le barriere di acquisizione, che aspetta quel semaforo.
+ *
+ * Sui dispositivi in cui la memoria device local è anche host visible (vedi supportsDirectUploads) i buffer creati con
+ * createDeviceBuffer vengono scritti direttamente dalla CPU, senza staging né copie: solo le texture passano ancora dalla GPU.
+ */
+class UploadBatch
+{
+public:
+    /**
+     * @brief Costruttore della classe UploadBatch.
+     *
+     * Se la famiglia di trasferimento è la stessa di quella grafica i caricamenti vengono inviati direttamente alla coda grafica.
+     *
+     * @param device Il dispositivo Vulkan su cui operare.
+     * @param physicalDevice Il dispositivo fisico Vulkan, per creare i buffer con createDeviceBuffer.
+     * @param directUploads true per scrivere i buffer direttamente nella memoria device local, va usato solo se supportsDirectUploads è true.
+     * @param transferCommandPool Il command pool della famiglia di trasferimento, da cui allocare i command buffer delle copie.
+     * @param transferQueue La coda su cui inviare le copie.
+     * @param transferFamily La famiglia di code di transferQueue.
+     * @param graphicsCommandPool Il command pool della famiglia grafica, da cui allocare i command buffer delle acquisizioni.
+     * @param graphicsQueue La coda su cui vengono usati buffer e immagini caricati.
+     * @param graphicsFamily La famiglia di code di graphicsQueue.
+     * @param stagingRing Il buffer di staging da cui passano i dati.
+     */
+    UploadBatch(VkDevice device, VkPhysicalDevice physicalDevice, bool directUploads, VkCommandPool transferCommandPool, VkQueue transferQueue, uint32_t transferFamily,
+                VkCommandPool graphicsCommandPool, VkQueue graphicsQueue, uint32_t graphicsFamily, StagingRing *stagingRing);
+
+    /**
+     * @brief Distruttore della classe UploadBatch.
+     *
+     * Invia i caricamenti registrati e non ancora inviati, aspetta che finiscano e distrugge i semafori.
+     */
+    ~UploadBatch();
+
+    /**
+     * @brief Crea un buffer device local con dentro i dati indicati.
+     *
+     * Se i caricamenti diretti sono attivi il buffer viene creato in memoria host visible e i dati ci vengono copiati subito dalla CPU,
+     * quindi può essere usato da tutti i comandi inviati da ora in poi. Altrimenti i dati passano dal buffer di staging con uploadBuffer.
+     *
+     * @param data I dati da copiare nel buffer.
+     * @param size La dimensione dei dati.
+     * @param usage L'uso del buffer (vertex buffer, index buffer...), VK_BUFFER_USAGE_TRANSFER_DST_BIT viene aggiunto se serve.
+     * @param category A cosa serve il buffer, per la contabilità della memoria.
+     * @param buffer Il buffer creato.
+     * @param bufferMemory La memoria del buffer, da liberare con destroyBuffer.
+     */
+    void createDeviceBuffer(const void *data, VkDeviceSize size, VkBufferUsageFlags usage, MemoryCategory category, VkBuffer &buffer, DeviceAllocation &bufferMemory);
+
+    /**
+     * @brief Registra la copia di dati in un buffer device local.
+     *
+     * Il buffer può essere letto come vertex buffer, index buffer o uniform buffer da tutti i comandi inviati dopo che il suo invio è pronto (vedi isReady).
+     *
+     * @param dstBuffer Il buffer di destinazione, creato con VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+     * @param data I dati da copiare, vengono copiati subito nel buffer di staging.
+     * @param size La dimensione dei dati.
+     */
+    void uploadBuffer(VkBuffer dstBuffer, const void *data, VkDeviceSize size);
+
+    /**
+     * @brief Registra la copia dei pixel in un'immagine, la generazione delle mipmap e le transizioni di layout.
+     *
+     * Tutti i livelli dell'immagine passano da VK_IMAGE_LAYOUT_UNDEFINED a VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+     * Le mipmap vengono generate con vkCmdBlitImage se il formato supporta il filtro lineare e le copie vanno sulla coda grafica,
+     * altrimenti vengono generate sulla CPU (vedi mipmap.h) e copiate insieme al livello 0.
+     *
+     * @param image L'immagine di destinazione, creata con VK_IMAGE_USAGE_TRANSFER_SRC_BIT e VK_IMAGE_USAGE_TRANSFER_DST_BIT.
+     * @param format Il formato dell'immagine, a 8 bit per canale RGBA.
+     * @param pixels I pixel del livello 0, vengono copiati subito nel buffer di staging.
+     * @param size La dimensione dei pixel del livello 0 in byte.
+     * @param width La larghezza dell'immagine.
+     * @param height L'altezza dell'immagine.
+     * @param mipLevels Il numero di livelli di mipmap dell'immagine.
+     */
+    void uploadImage(VkImage image, VkFormat format, const void *pixels, VkDeviceSize size, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+    /**
+     * @brief Indica se uploadImage genera le mipmap di un formato sulla GPU.
+     *
+     * Se è false le mipmap vanno generate sulla CPU: chi decodifica le immagini su altri thread può farlo lì (vedi Texture::loadImageData)
+     * e caricarle già pronte con uploadImageLevels, invece di lasciare il lavoro a uploadImage sul thread principale.
+     *
+     * @param format Il formato dell'immagine.
+     * @return true se le mipmap vengono generate con vkCmdBlitImage.
+     */
+    bool generatesMipmaps(VkFormat format) const;
+
+    /**
+     * @brief Registra la copia di tutti i livelli di mipmap di un'immagine già pronti, per esempio compressi e letti da un file KTX2.
+     *
+     * I dati vengono copiati così come sono, quindi vanno bene anche per i formati compressi a blocchi.
+     * Tutti i livelli passano da VK_IMAGE_LAYOUT_UNDEFINED a VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+     *
+     * @param image L'immagine di destinazione, creata con VK_IMAGE_USAGE_TRANSFER_DST_BIT e un livello di mipmap per ogni elemento di levels.
+     * @param data I dati di tutti i livelli, vengono copiati subito nel buffer di staging.
+     * @param size La dimensione dei dati in byte.
+     * @param levels La posizione e le dimensioni di ogni livello nei dati, dal livello 0 in poi.
+     */
+    void uploadImageLevels(VkImage image, const void *data, VkDeviceSize size, const std::vector<ImageLevel> &levels);
+
+    /**
+     * @brief Invia i caricamenti registrati fino ad ora, senza aspettarli.
+     *
+     * Con la coda di trasferimento dedicata invia anche le acquisizioni dei caricamenti precedenti che la GPU ha già finito:
+     * la coda grafica non deve aspettare il semaforo, quindi i frame in corso non vengono rallentati.
+     *
+     * @return Il numero dell'invio da passare a wait, acquire o isReady, 0 se non c'era niente da inviare.
+     */
+    uint64_t submit();
+
+    /**
+     * @brief Invia subito le acquisizioni dei caricamenti fino a quello indicato, anche se le copie non sono ancora finite.
+     *
+     * La CPU non aspetta: è la coda grafica ad aspettare il semaforo, quindi i comandi di disegno inviati dopo vedono i dati.
+     * Serve all'avvio, quando i primi frame hanno bisogno di tutti i modelli e le texture.
+     *
+     * @param submission Il numero restituito da submit, 0 non fa niente.
+     */
+    void acquire(uint64_t submission);
+
+    /**
+     * @brief Indica se i buffer e le immagini di un invio possono essere usati dai comandi di disegno inviati da ora in poi.
+     * @param submission Il numero restituito da submit.
+     * @return true se l'acquisizione dell'invio è già stata inviata alla coda grafica.
+     */
+    bool isReady(uint64_t submission) const;
+
+    /**
+     * @brief Aspetta che un invio sia completato dalla GPU, serve solo se la CPU deve leggere o distruggere le risorse caricate.
+     * @param submission Il numero restituito da submit, 0 non aspetta niente.
+     */
+    void wait(uint64_t submission);
+
+    /**
+     * @brief Restituisce quante volte il batch ha inviato comandi alla coda.
+     * @return Il numero di invii, compresi quelli fatti perché il buffer di staging era pieno.
+     */
+    uint32_t getSubmitCount() const;
+
+    /**
+     * @brief Indica se i buffer vengono scritti direttamente nella memoria device local.
+     * @return true se i caricamenti diretti sono attivi.
+     */
+    bool usesDirectUploads() const;
+
+private:
+    // acquisizione già registrata sulla coda grafica, che aspetta la fine delle copie per essere inviata
+    struct PendingAcquire
+    {
+        uint64_t submission; // l'invio delle copie
+        VkCommandBuffer commandBuffer;
+        VkSemaphore semaphore; // segnalato dalla fine delle copie
+    };
+
+    // restituisce il command buffer corrente, creandolo se non c'è
+    VkCommandBuffer commandBuffer();
+
+    // prende una porzione del buffer di staging, inviando prima i comandi registrati se lo spazio è tutto occupato da loro
+    StagingAllocation stage(const void *data, VkDeviceSize size);
+
+    // invia alla coda grafica le acquisizioni fino a submission, o solo quelle con le copie già finite se force è false
+    void submitAcquires(uint64_t submission, bool force);
+
+    // true se le copie vanno su una coda diversa da quella grafica
+    bool separateQueues() const;
+
+    // porta tutti i livelli dell'immagine copiata in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, o prepara il passaggio alla coda grafica
+    void finishImageUpload(VkCommandBuffer cmd, VkImage image, uint32_t mipLevels);
+
+    VkDevice device;
+    VkPhysicalDevice physicalDevice;
+    bool directUploads;
+    VkCommandPool transferCommandPool;
+    VkQueue transferQueue;
+    uint32_t transferFamily;
+    VkCommandPool graphicsCommandPool;
+    VkQueue graphicsQueue;
+    uint32_t graphicsFamily;
+    StagingRing *stagingRing;
+
+    VkCommandBuffer currentCommandBuffer = VK_NULL_HANDLE;
+    bool pendingBufferCopies = false; // true se nel command buffer ci sono copie in buffer che hanno bisogno della barriera finale
+    uint32_t submitCount = 0;
+
+    // barriere per passare buffer e immagini dalla famiglia di trasferimento a quella grafica, le stesse servono per rilascio e acquisizione
+    std::vector<VkBufferMemoryBarrier> bufferTransfers;
+    std::vector<VkImageMemoryBarrier> imageTransfers;
+    std::deque<PendingAcquire> pendingAcquires;
+    uint64_t lastAcquired = 0;                                  // l'ultimo invio di copie già passato alla coda grafica
+    std::deque<std::pair<uint64_t, VkSemaphore>> usedSemaphores; // semafori aspettati dall'acquisizione con quel numero di invio
+    std::vector<VkSemaphore> freeSemaphores;
+};
@@ -0,0 +1,151 @@
+#include "vertexFormat.h"
+#include <glm/gtc/packing.hpp>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+VkVertexInputBindingDescription PackedVertex::getBindingDescription()
+{
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(PackedVertex);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return bindingDescription;
+}
+
+// i formati *_UNORM e *_SNORM vengono convertiti dalla GPU in float tra 0 e 1 (o tra -1 e 1) prima di arrivare alla shader,
+// quindi la shader riceve già dei float e deve solo riportarli nell'intervallo originale
+std::array<VkVertexInputAttributeDescription, 3> PackedVertex::getAttributeDescriptions(VertexLayout layout)
+{
+    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+    attributeDescriptions[0].offset = offsetof(PackedVertex, pos);
+
+    // la shader legge la normale come vec3: le componenti mancanti vengono riempite con 0
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+    attributeDescriptions[1].offset = offsetof(PackedVertex, normal);
+
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = layout == VertexLayout::Packed16UnormUV ? VK_FORMAT_R16G16_UNORM : VK_FORMAT_R16G16_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(PackedVertex, texCoord);
+
+    return attributeDescriptions;
+}
+
+size_t vertexStride(VertexLayout layout)
+{
+    return layout == VertexLayout::Full ? sizeof(Vertex) : sizeof(PackedVertex);
+}
+
+VkVertexInputBindingDescription getVertexBindingDescription(VertexLayout layout)
+{
+    return layout == VertexLayout::Full ? Vertex::getBindingDescription() : PackedVertex::getBindingDescription();
+}
+
+std::array<VkVertexInputAttributeDescription, 3> getVertexAttributeDescriptions(VertexLayout layout)
+{
+    return layout == VertexLayout::Full ? Vertex::getAttributeDescriptions() : PackedVertex::getAttributeDescriptions(layout);
+}
+
+VertexQuantization computeVertexQuantization(const std::vector<Vertex> &vertices, glm::vec3 boundsMin, glm::vec3 boundsMax, VertexLayout layout)
+{
+    VertexQuantization quantization;
+    if (layout == VertexLayout::Full)
+    {
+        return quantization;
+    }
+    // le posizioni sono relative al bounding box: 0 corrisponde a boundsMin e 1 a boundsMax
+    quantization.positionOffset = glm::vec4(boundsMin, 0.0f);
+    quantization.positionScale = glm::vec4(boundsMax - boundsMin, 0.0f);
+
+    if (layout == VertexLayout::Packed16UnormUV && !vertices.empty())
+    {
+        // le coordinate texture possono uscire da [0, 1] (texture ripetute), quindi usiamo il loro intervallo reale
+        float minU = vertices[0].texCoord.x, maxU = minU;
+        float minV = vertices[0].texCoord.y, maxV = minV;
+        for (const Vertex &vertex : vertices)
+        {
+            minU = std::min(minU, vertex.texCoord.x);
+            maxU = std::max(maxU, vertex.texCoord.x);
+            minV = std::min(minV, vertex.texCoord.y);
+            maxV = std::max(maxV, vertex.texCoord.y);
+        }
+        quantization.texCoordScaleOffset = glm::vec4(maxU - minU, maxV - minV, minU, minV);
+    }
+    return quantization;
+}
+
+// riporta un valore nell'intervallo [0, 1] rispetto a offset e scala, un intervallo vuoto diventa 0
+static float normalizeToRange(float value, float offset, float scale)
+{
+    return scale > 0.0f ? std::clamp((value - offset) / scale, 0.0f, 1.0f) : 0.0f;
+}
+
+// codifica ottaedrica: la sfera delle direzioni viene proiettata su un ottaedro e poi aperta su un quadrato [-1, 1]^2,
+// così una normale occupa solo 2 valori con un errore quasi uniforme in tutte le direzioni
+static void octEncode(glm::vec3 normal, float &x, float &y)
+{
+    float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    if (length == 0.0f)
+    {
+        x = 0.0f;
+        y = 0.0f;
+        return;
+    }
+    x = normal.x / length;
+    y = normal.y / length;
+    if (normal.z < 0.0f)
+    {
+        // la metà inferiore dell'ottaedro viene ripiegata sugli angoli del quadrato
+        float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+}
+
+std::vector<uint8_t> packVertices(const std::vector<Vertex> &vertices, VertexLayout layout, const VertexQuantization &quantization)
+{
+    std::vector<uint8_t> bytes(vertices.size() * vertexStride(layout));
+    if (layout == VertexLayout::Full)
+    {
+        if (!vertices.empty())
+        {
+            memcpy(bytes.data(), vertices.data(), bytes.size());
+        }
+        return bytes;
+    }
+
+    PackedVertex *packed = reinterpret_cast<PackedVertex *>(bytes.data());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex &vertex = vertices[i];
+        packed[i].pos[0] = glm::packUnorm1x16(normalizeToRange(vertex.pos.x, quantization.positionOffset.x, quantization.positionScale.x));
+        packed[i].pos[1] = glm::packUnorm1x16(normalizeToRange(vertex.pos.y, quantization.positionOffset.y, quantization.positionScale.y));
+        packed[i].pos[2] = glm::packUnorm1x16(normalizeToRange(vertex.pos.z, quantization.positionOffset.z, quantization.positionScale.z));
+        packed[i].pos[3] = 0;
+
+        float octX, octY;
+        octEncode(vertex.normal, octX, octY);
+        packed[i].normal[0] = static_cast<int16_t>(glm::packSnorm1x16(octX));
+        packed[i].normal[1] = static_cast<int16_t>(glm::packSnorm1x16(octY));
+
+        if (layout == VertexLayout::Packed16UnormUV)
+        {
+            packed[i].texCoord[0] = glm::packUnorm1x16(normalizeToRange(vertex.texCoord.x, quantization.texCoordScaleOffset.z, quantization.texCoordScaleOffset.x));
+            packed[i].texCoord[1] = glm::packUnorm1x16(normalizeToRange(vertex.texCoord.y, quantization.texCoordScaleOffset.w, quantization.texCoordScaleOffset.y));
+        }
+        else
+        {
+            packed[i].texCoord[0] = glm::packHalf1x16(vertex.texCoord.x);
+            packed[i].texCoord[1] = glm::packHalf1x16(vertex.texCoord.y);
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "bufferUtils.h"
+
+/**
+ * @brief Formato dei vertici nel vertex buffer della GPU.
+ *
+ * Sulla CPU i modelli restano sempre in Vertex (32 byte, tutti float): il formato viene scelto solo al momento del caricamento sulla GPU.
+ */
+enum class VertexLayout
+{
+    Full,           // Vertex così com'è: posizione vec3, normale vec3, coordinate texture vec2 (32 byte)
+    Packed16,       // posizione 4x unorm16 relativa al bounding box, normale ottaedrica 2x snorm16, coordinate texture 2x half (16 byte)
+    Packed16UnormUV // come Packed16, ma le coordinate texture sono 2x unorm16 relative al loro intervallo (più precise di half lontano da 0)
+};
+
+/**
+ * @brief Vertice compresso usato dai formati Packed16 e Packed16UnormUV.
+ *
+ * La posizione ha 4 componenti invece di 3 perché i formati a 3 componenti da 16 bit non sono supportati come vertex buffer da molte GPU,
+ * la quarta componente non viene usata dalla shader.
+ */
+struct PackedVertex
+{
+    uint16_t pos[4];
+    int16_t normal[2];
+    uint16_t texCoord[2];
+
+    static VkVertexInputBindingDescription getBindingDescription();
+    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions(VertexLayout layout);
+};
+
+/**
+ * @brief Dati per ricostruire nella vertex shader i valori dei vertici compressi.
+ *
+ * Vengono passati come push constant alla vertex shader, subito dopo l'indice della texture della fragment shader.
+ * Per il formato Full sono l'identità (scala 1, offset 0).
+ */
+struct VertexQuantization
+{
+    glm::vec4 positionScale = glm::vec4(1.0f);        // posizione = positionOffset + valore * positionScale
+    glm::vec4 positionOffset = glm::vec4(0.0f);
+    glm::vec4 texCoordScaleOffset = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f); // coordinate texture = valore * xy + zw
+};
+
+// offset delle push constant della vertex shader: i primi 16 byte sono per l'indice della texture della fragment shader
+const uint32_t VERTEX_PUSH_CONSTANT_OFFSET = 16;
+
+/**
+ * @brief Restituisce la dimensione di un vertice nel formato indicato.
+ * @param layout Il formato dei vertici.
+ * @return La dimensione in byte.
+ */
+size_t vertexStride(VertexLayout layout);
+
+/**
+ * @brief Restituisce la descrizione del binding dei vertici per il formato indicato.
+ * @param layout Il formato dei vertici.
+ * @return La descrizione del binding.
+ */
+VkVertexInputBindingDescription getVertexBindingDescription(VertexLayout layout);
+
+/**
+ * @brief Restituisce la descrizione degli attributi dei vertici per il formato indicato.
+ * @param layout Il formato dei vertici.
+ * @return Le descrizioni di posizione, normale e coordinate texture.
+ */
+std::array<VkVertexInputAttributeDescription, 3> getVertexAttributeDescriptions(VertexLayout layout);
+
+/**
+ * @brief Calcola i dati di quantizzazione di un modello.
+ *
+ * @param vertices I vertici del modello.
+ * @param boundsMin L'angolo minimo del bounding box del modello.
+ * @param boundsMax L'angolo massimo del bounding box del modello.
+ * @param layout Il formato dei vertici.
+ * @return I dati da passare alla vertex shader.
+ */
+VertexQuantization computeVertexQuantization(const std::vector<Vertex> &vertices, glm::vec3 boundsMin, glm::vec3 boundsMax, VertexLayout layout);
+
+/**
+ * @brief Converte i vertici nel formato indicato, pronti per essere copiati nel vertex buffer.
+ *
+ * @param vertices I vertici del modello.
+ * @param layout Il formato dei vertici.
+ * @param quantization I dati di quantizzazione calcolati con computeVertexQuantization.
+ * @return I byte del vertex buffer.
+ */
+std::vector<uint8_t> packVertices(const std::vector<Vertex> &vertices, VertexLayout layout, const VertexQuantization &quantization);